@@ -8,7 +8,13 @@
 
 #include "accelerometer.h"
 #include "I2C/i2c_master_int.h"
-#include "util/SysTick.h"
+#include "Interrupts/interrupts.h"
+#include "gpio.h"
+#include "board.h"
+#include "util/scheduler.h"
+#include "events.h"
+#include "util/defer.h"
+#include "util/ring_buffer.h"
 
 #define ACCEL_ADDRESS	0x1D
 #define ACCEL_DATA_PACK_LEN	13
@@ -20,138 +26,356 @@
 
 // ACCEL internal register addresses
 #define ACCEL_STATUS 0x00
+#define ACCEL_F_STATUS 0x00			//replaces STATUS while the FIFO is on
+#define ACCEL_OUT_X_MSB 0x01
+#define ACCEL_F_SETUP 0x09
 #define ACCEL_WHOAMI 0x0D
 #define ACCEL_XYZ_DATA_CFG 0x0E
 #define ACCEL_CTRL_REG1 0x2A
+#define ACCEL_CTRL_REG4 0x2D
+#define ACCEL_CTRL_REG5 0x2E
+#define ACCEL_M_OUT_X_MSB 0x33
 #define ACCEL_M_CTRL_REG1 0x5B
 #define ACCEL_M_CTRL_REG2 0x5C
 #define ACCEL_WHOAMI_VAL 0xC7
 
+// F_SETUP and F_STATUS fields
+#define ACCEL_F_MODE_CIRCULAR 0x40	//oldest sample is overwritten when full
+#define ACCEL_F_OVF_MASK 0x80
+#define ACCEL_F_CNT_MASK 0x3F
+
+// CTRL_REG4 (interrupt enable) and CTRL_REG5 (routing, 0: INT2) fields
+#define ACCEL_INT_EN_FIFO 0x40
+#define ACCEL_INT_EN_DRDY 0x01
+
 // number of bytes to be read from the ACCEL
 #define ACCEL_READ_LEN 13 // status plus 6 channels =13 bytes
-typedef enum { I2C_ERROR, I2C_OK} accel_errors_t;
+#define ACCEL_SAMPLE_LEN 6	// x, y, z msb first
+#define ACCEL_MAX_BURST 32	//the whole FIFO, read straight into reading_buffer
+#define ACCEL_SAMPLE_PERIOD_US CLOCK_HZ_TO_US(ACCEL_ODR_HZ)
+
+#define ACCEL_SAMPLES_LENGTH 64
+
+// wait before asking for the WHOAMI again, doubled on each try
+#define ACCEL_RETRY_FIRST_MS 10
+#define ACCEL_RETRY_MAX_MS 1000
+
+// CTRL_REG1 fields. The rate picked by DR depends on the mode: hybrid mode alternates accelerometer and
+// magnetometer, so each DR value gives half the accelerometer only rate
+#define ACCEL_CTRL1_ACTIVE 0x01
+#define ACCEL_CTRL1_LNOISE 0x04
+#define ACCEL_CTRL1_DR(x) ((x) << 3)
+
+// M_CTRL_REG1: hybrid mode with the highest oversampling, or accelerometer only
+#define ACCEL_M_HYBRID 0x1F
+#define ACCEL_M_OFF 0x00
+
+#if ACCEL_ODR_HZ == 800
+#define ACCEL_USE_MAG 0
+#define ACCEL_DR 0
+#elif ACCEL_ODR_HZ == 400
+#define ACCEL_USE_MAG 1
+#define ACCEL_DR 0
+#elif ACCEL_ODR_HZ == 200
+#define ACCEL_USE_MAG 1
+#define ACCEL_DR 1
+#elif ACCEL_ODR_HZ == 100
+#define ACCEL_USE_MAG 1
+#define ACCEL_DR 2
+#elif ACCEL_ODR_HZ == 50
+#define ACCEL_USE_MAG 1
+#define ACCEL_DR 3
+#elif ACCEL_ODR_HZ == 25
+#define ACCEL_USE_MAG 1
+#define ACCEL_DR 4
+#else
+#error "ACCEL_ODR_HZ must be 25, 50, 100, 200, 400 or 800"
+#endif
+
+//a 13 byte read takes ~2.2 ms on the bus, not much less than a sample at 400 Hz
+#if !ACCEL_USE_FIFO && ACCEL_ODR_HZ > 400
+#error "one read per sample can not keep up with ACCEL_ODR_HZ, use the FIFO"
+#endif
+
+#if ACCEL_USE_FIFO && (ACCEL_FIFO_WATERMARK < 1 || ACCEL_FIFO_WATERMARK > 31 || ACCEL_FIFO_WATERMARK > ACCEL_MAX_BURST)
+#error "ACCEL_FIFO_WATERMARK must be 1 to 31"
+#endif
+
+//what the i2c read in progress is for
+typedef enum { READ_IDLE, READ_STATUS, READ_FIFO, READ_MAG, READ_ALL } accel_read_t;
 /*
  * From the Freedom MK64F user manual:
  * An NXP FXOS8700CQ low-power, six-axis Xtrinsic sensor is interfaced through an I2C bus and two GPIO signals,
  * as shown in Table 5. By default, the I2C address is 0x1D.
 */
 
-static unsigned char reading_buffer[ACCEL_DATA_PACK_LEN];
+static unsigned char reading_buffer[ACCEL_MAX_BURST * ACCEL_SAMPLE_LEN];
 static accel_raw_data_t last_read_data_mag;
 static accel_raw_data_t last_read_data_acc;
-
-static void handling_reading_calls();
-static void write_reg(unsigned char reg, unsigned char data);
-
-static void handling_read();
-static accel_errors_t start();
+static volatile uint32_t sample_count;
+static uint8_t parse_work = DEFER_NO_WORK;
+static volatile accel_read_t read_state = READ_IDLE;
+static clock_us_t read_time;			//when the interrupt came, newest sample time
+static unsigned int fifo_count;			//samples in the FIFO burst in progress
+static uint32_t transactions;
+static uint32_t overflows;
+static volatile accel_status_t status = ACCEL_STARTING;
+static uint8_t whoami_work = DEFER_NO_WORK;
+static uint8_t retry_task = SCHED_NO_TASK;
+static unsigned int whoami_tries;
+
+//register writes that configure the sensor, FROM THE FXOS8700CQ REFERENCE MANUAL, SECTION 13.4
+static const unsigned char config[][2] = {
+	{ACCEL_CTRL_REG1, 0x00},		//standby: the other registers can only be written while the sensor is not active
+	{ACCEL_M_CTRL_REG1, 0x00},
+	{ACCEL_M_CTRL_REG1, ACCEL_USE_MAG ? ACCEL_M_HYBRID : ACCEL_M_OFF},
+#if ACCEL_USE_FIFO
+	//no hybrid auto increment: FIFO bursts wrap from OUT_Z_LSB back to OUT_X_MSB, the magnetometer is read apart
+	{ACCEL_M_CTRL_REG2, 0x00},
+	{ACCEL_F_SETUP, ACCEL_F_MODE_CIRCULAR | ACCEL_FIFO_WATERMARK},
+	{ACCEL_CTRL_REG4, ACCEL_INT_EN_FIFO},
+#else
+	{ACCEL_M_CTRL_REG2, 0x20},
+	{ACCEL_CTRL_REG4, ACCEL_INT_EN_DRDY},
+#endif
+	{ACCEL_CTRL_REG5, 0x00},		//every interrupt to INT2, push-pull active low (CTRL_REG3 reset value)
+	{ACCEL_XYZ_DATA_CFG, 0x01},
+	{ACCEL_CTRL_REG1, ACCEL_CTRL1_DR(ACCEL_DR) | ACCEL_CTRL1_LNOISE | ACCEL_CTRL1_ACTIVE},
+};
+#define ACCEL_CONFIG_LEN (sizeof(config) / sizeof(config[0]))
+
+//the whole configuration is queued at once, with room left for a read
+typedef char accel_config_must_fit_in_i2c_queue[ACCEL_CONFIG_LEN < I2C_INT_QUEUE_LENGTH ? 1 : -1];
+
+static const unsigned char whoami_reg = ACCEL_WHOAMI;
+static unsigned char whoami_val;
+static unsigned char read_reg;
+static i2c_transaction_t whoami_transaction = {
+	.address = ACCEL_SLAVE_ADDR, .write_data = &whoami_reg, .write_len = 1, .read_data = &whoami_val, .read_len = 1
+};
+static i2c_transaction_t config_transactions[ACCEL_CONFIG_LEN];
+static i2c_transaction_t read_transaction = {
+	.address = ACCEL_SLAVE_ADDR, .write_data = &read_reg, .write_len = 1, .read_data = reading_buffer,
+	.use_dma = ACCEL_USE_DMA	//short reads fall back to interrupts by themselves
+};
+RING_BUFFER_DEFINE(samples, accel_sample_t, ACCEL_SAMPLES_LENGTH);	//producer: parse_read, consumer: accel_pop_sample
+
+static void data_ready();
+static void start_first_read();
+static void start_read(unsigned char reg, int len, accel_read_t what);
+static accel_raw_data_t parse_acc(const unsigned char * data);
+static accel_raw_data_t parse_mag(const unsigned char * data);
+static void push_sample(accel_raw_data_t acc, clock_us_t time);
+
+static void read_done(i2c_transaction_t * transaction);
+static void whoami_done(i2c_transaction_t * transaction);
+static void whoami_check();
+static void parse_read();
+static void start();
 
 void accel_init(){
-	bool initialized = false;
+	static bool initialized = false;
 	if(initialized) return;
 
 	i2c_master_int_init(I2C0_INT_MOD);
 
-	systick_init();
+	rb_clear(&samples);
+	rb_register(&samples, "accel");
+
+	parse_work = defer_add(parse_read, 1);
+	whoami_work = defer_add(whoami_check, 1);
+	retry_task = sched_add_task("accel", start, 0, 2, 0);	//only runs when woken up to retry
+	read_transaction.callback = read_done;
 
-	while(start() == I2C_ERROR);
-	systick_add_callback(handling_read, SYSTICK_HZ_TO_RELOAD(40), PERIODIC);			//more than 800 Hz!!!
-	systick_add_callback(handling_reading_calls, SYSTICK_HZ_TO_RELOAD(15), PERIODIC);		//800 Hz!!!
+	//reads start when the sensor says there is data: FIFO watermark or data ready, on INT2
+	interrupts_init();
+	gpioMode(ACCEL_INT2_PIN, INPUT);
+	start();		//INT2 is enabled once the sensor answers
 
 	initialized = true;
 
 }
 
-// FROM  THE FXOS8700CQ REFERENCE MANUAL, SECTION 13.4
-// function configures FXOS8700CQ combination accelerometer and magnetometer sensor
-static accel_errors_t start(){
-
-	unsigned char question = ACCEL_WHOAMI;
-
-	i2c_master_int_set_slave_addr(I2C0_INT_MOD, ACCEL_SLAVE_ADDR);
-	i2c_master_int_read_data(I2C0_INT_MOD, &question, 1 , 1);
-
-	unsigned char data[2] = {0, 0};
+//checks the sensor is there before configuring it
+static void start(){
+	whoami_tries++;
+	whoami_transaction.callback = whoami_done;
+	i2c_master_int_submit(I2C0_INT_MOD, &whoami_transaction);
+}
 
-	while(!i2c_master_int_has_new_data(I2C0_INT_MOD));
+//the answer is checked from the main loop
+static void whoami_done(i2c_transaction_t * transaction){
+	(void)transaction;
+	defer_post(whoami_work);
+}
 
-	if (i2c_master_int_get_new_data_length(I2C0_INT_MOD) != 1)
-		return (I2C_ERROR); // read and check the FXOS8700CQ WHOAMI register
-	else {
-		i2c_master_int_get_new_data(I2C0_INT_MOD, data, 1);
-		if(data[0] != ACCEL_WHOAMI_VAL)
-			return (I2C_ERROR);
+//not there yet: asked again later, waiting longer each time, until ACCEL_WHOAMI_TRIES.
+//There: the configuration is queued at once, and reads started by INT2 go after it
+static void whoami_check(){
+	if(whoami_transaction.status != I2C_TR_DONE || whoami_val != ACCEL_WHOAMI_VAL) {
+		if(whoami_tries >= ACCEL_WHOAMI_TRIES) {
+			status = ACCEL_NOT_FOUND;
+			return;
+		}
+		uint32_t wait_ms = ACCEL_RETRY_FIRST_MS;
+		for(unsigned int i = 1; i < whoami_tries && wait_ms < ACCEL_RETRY_MAX_MS; i++)
+			wait_ms *= 2;
+		if(wait_ms > ACCEL_RETRY_MAX_MS)
+			wait_ms = ACCEL_RETRY_MAX_MS;
+		sched_wake_at(retry_task, clock_get_us() + CLOCK_MS_TO_US(wait_ms));
+		return;
 	}
 
-	while(i2c_master_int_bus_busy(I2C0_INT_MOD));
-	write_reg(ACCEL_M_CTRL_REG1, 0x00);
-
-	while(i2c_master_int_bus_busy(I2C0_INT_MOD));
-	write_reg(ACCEL_M_CTRL_REG1, 0x1F);
-
-	while(i2c_master_int_bus_busy(I2C0_INT_MOD));
-	write_reg(ACCEL_M_CTRL_REG2, 0x20);
-
-	while(i2c_master_int_bus_busy(I2C0_INT_MOD));
-	write_reg(ACCEL_XYZ_DATA_CFG, 0x01);
+	status = ACCEL_RUNNING;
+	for(unsigned int i = 0; i < ACCEL_CONFIG_LEN; i++){
+		config_transactions[i].address = ACCEL_SLAVE_ADDR;
+		config_transactions[i].write_data = config[i];
+		config_transactions[i].write_len = 2;
+		i2c_master_int_submit(I2C0_INT_MOD, &config_transactions[i]);
+	}
+	gpioIRQ(ACCEL_INT2_PIN, GPIO_IRQ_MODE_LOGIC_0, data_ready);
+}
 
-	while(i2c_master_int_bus_busy(I2C0_INT_MOD));
-	write_reg(ACCEL_CTRL_REG1, 0x0D);
 
-	while(i2c_master_int_bus_busy(I2C0_INT_MOD));
 
-	return I2C_OK;
+//INT2 is low while the sensor has data: FIFO watermark reached, or a new sample when the FIFO is off
+static void data_ready(){
+	gpioIRQ(ACCEL_INT2_PIN, GPIO_IRQ_MODE_DISABLE, NULL);		//level interrupt, enabled again when the reads are done
+	read_time = clock_get_us();
+	start_first_read();			//queued if the bus is busy
 }
 
+//parsing the data is left to the main loop
+static void read_done(i2c_transaction_t * transaction){
+	(void)transaction;
+	defer_post(parse_work);
+}
 
+static void parse_read(){
+	accel_read_t next = READ_IDLE;
+
+	switch(read_state){
+	case READ_STATUS:		//F_STATUS: how many samples to read
+		if(reading_buffer[0] & ACCEL_F_OVF_MASK)
+			overflows++;
+		fifo_count = reading_buffer[0] & ACCEL_F_CNT_MASK;
+		if(fifo_count > ACCEL_MAX_BURST)
+			fifo_count = ACCEL_MAX_BURST;	//the rest are read next time
+		next = fifo_count ? READ_FIFO : (ACCEL_USE_MAG ? READ_MAG : READ_IDLE);
+		break;
+	case READ_FIFO:			//fifo_count samples, oldest first, the newest one came with the interrupt
+		for(unsigned int i = 0; i < fifo_count; i++)
+			push_sample(parse_acc(&reading_buffer[i * ACCEL_SAMPLE_LEN]), read_time - (fifo_count - 1 - i) * ACCEL_SAMPLE_PERIOD_US);
+#if ACCEL_USE_MAG
+		next = READ_MAG;
+#else
+		sched_signal(EV_ACCEL_SAMPLE);
+#endif
+		break;
+	case READ_MAG:			//the magnetometer has no FIFO, only its last sample is kept
+		last_read_data_mag = parse_mag(reading_buffer);
+		if(fifo_count)
+			sched_signal(EV_ACCEL_SAMPLE);
+		break;
+	case READ_ALL:			//status, accelerometer and magnetometer
+		//the first byte of the reading operation is the status, ignore it
+		last_read_data_mag = parse_mag(&reading_buffer[7]);
+		push_sample(parse_acc(&reading_buffer[1]), read_time);
+		sched_signal(EV_ACCEL_SAMPLE);
+		break;
+	default:
+		break;
+	}
 
-static void handling_read(){
-//	systick_disable_callback(handling_reading_calls);		//cant try to read now because that will empty the buffer!!!
-
-	//reads the last ACC_DATA_PACK_LEN (exactly!!) amount of bytes from the i2c master buffer.
-	while(i2c_master_int_has_new_data(I2C0_INT_MOD) && (i2c_master_int_get_new_data_length(I2C0_INT_MOD) >= ACCEL_DATA_PACK_LEN)){
-		i2c_master_int_get_new_data(I2C0_INT_MOD, reading_buffer, ACCEL_DATA_PACK_LEN);
+	if(next == READ_FIFO)
+		start_read(ACCEL_OUT_X_MSB, fifo_count * ACCEL_SAMPLE_LEN, READ_FIFO);
+	else if(next == READ_MAG)
+		start_read(ACCEL_M_OUT_X_MSB, ACCEL_SAMPLE_LEN, READ_MAG);
+	else {
+		read_state = READ_IDLE;
+		gpioIRQ(ACCEL_INT2_PIN, GPIO_IRQ_MODE_LOGIC_0, data_ready);	//fires at once if there is data already
+	}
+}
 
-		//the first byte of the reading operation should be ignored!!
-		//accelerometer data : serial... 14 bits
-		last_read_data_acc.x = (int16_t)((reading_buffer[1] << 8) | reading_buffer[2])>> 2;
-		last_read_data_acc.y = (int16_t)((reading_buffer[3] << 8) | reading_buffer[4])>> 2;
-		last_read_data_acc.z = (int16_t)((reading_buffer[5] << 8) | reading_buffer[6])>> 2;
+static void start_first_read(){
+#if ACCEL_USE_FIFO
+	start_read(ACCEL_F_STATUS, 1, READ_STATUS);
+#else
+	start_read(ACCEL_STATUS, ACCEL_DATA_PACK_LEN, READ_ALL);
+#endif
+}
 
-		//magnetometer data : serial... 16 bits
-		last_read_data_mag.x = (reading_buffer[7] << 8) | reading_buffer[8];
-		last_read_data_mag.y = (reading_buffer[9] << 8) | reading_buffer[10];
-		last_read_data_mag.z = (reading_buffer[11] << 8) | reading_buffer[12];
-	}
-//	systick_enable_callback(handling_reading_calls);		//can now try to read
+//only one read at a time: the next one is started when this one is parsed
+static void start_read(unsigned char reg, int len, accel_read_t what){
+	read_state = what;
+	read_reg = reg;
+	read_transaction.read_len = len;
+	transactions++;
+	i2c_master_int_submit(I2C0_INT_MOD, &read_transaction);
 }
 
-static void handling_reading_calls(){
+//accelerometer data : serial... 14 bits
+static accel_raw_data_t parse_acc(const unsigned char * data){
+	accel_raw_data_t acc;
+	acc.x = (int16_t)((data[0] << 8) | data[1]) >> 2;
+	acc.y = (int16_t)((data[2] << 8) | data[3]) >> 2;
+	acc.z = (int16_t)((data[4] << 8) | data[5]) >> 2;
+	return acc;
+}
 
-	unsigned char read_addr = ACCEL_STATUS;
-	if(!i2c_master_int_bus_busy(I2C0_INT_MOD)){
-		systick_disable_callback(handling_read);		//cant update data while reading it!
-		i2c_master_int_read_data(I2C0_INT_MOD, &read_addr, 1, ACCEL_DATA_PACK_LEN);
-		systick_enable_callback(handling_read);		//can now update data if necessary
-	}
+//magnetometer data : serial... 16 bits
+static accel_raw_data_t parse_mag(const unsigned char * data){
+	accel_raw_data_t mag;
+	mag.x = (data[0] << 8) | data[1];
+	mag.y = (data[2] << 8) | data[3];
+	mag.z = (data[4] << 8) | data[5];
+	return mag;
 }
 
-static void write_reg(unsigned char reg, unsigned char data){
-	unsigned char reg_data[2] = {reg, data};
-	i2c_master_int_write_data(I2C0_INT_MOD, reg_data, 2);
+static void push_sample(accel_raw_data_t acc, clock_us_t time){
+	last_read_data_acc = acc;
+	sample_count++;
+	accel_sample_t * slot = rb_reserve(&samples);	//if full, the oldest samples are kept
+	if(slot != NULL){
+		slot->acc = acc;
+		slot->time_us = time;
+		rb_commit(&samples);
+	}
 }
 
 accel_raw_data_t accel_get_last_data(accel_data_options_t data_option){
 	accel_raw_data_t returnable;
 
-//	systick_disable_callback (handling_read);		//cant update data while reading it!
-
 	if(data_option == ACCEL_ACCEL_DATA)
 		returnable = last_read_data_acc;
 	else if(data_option == ACCEL_MAGNET_DATA)
 		returnable = last_read_data_mag;
 
-//	systick_enable_callback(handling_read);		//can now update data if necessary
-
 	return returnable;
 }
+
+bool accel_pop_sample(accel_sample_t * sample){
+	const accel_sample_t * oldest = rb_peek(&samples);
+	if(oldest == NULL)
+		return false;
+	sample->acc = oldest->acc;
+	sample->time_us = oldest->time_us;
+	rb_release(&samples);
+	return true;
+}
+
+uint32_t accel_get_sample_count(){
+	return sample_count;
+}
+
+uint32_t accel_get_transaction_count(){
+	return transactions;
+}
+
+uint32_t accel_get_overflow_count(){
+	return overflows;
+}
+
+accel_status_t accel_get_status(){
+	return status;
+}
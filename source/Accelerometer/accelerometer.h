@@ -11,12 +11,59 @@
 #ifndef ACCELEROMETER_ACCELEROMETER_H_
 #define ACCELEROMETER_ACCELEROMETER_H_
 #include "general.h"
+#include "util/clock.h"
+
+/**
+ * @define ACCEL_USE_FIFO
+ * @brief 1: the accelerometer queues its samples in its FIFO and they are read in bursts of ACCEL_FIFO_WATERMARK.
+ * 0: each sample is read alone, as soon as it is ready.
+ * Either way reads are started by the sensor's interrupt (INT2), so no sample is read twice or missed.
+ * One read per sample only keeps up with the I2C bus up to 400 Hz.
+ */
+#ifndef ACCEL_USE_FIFO
+#define ACCEL_USE_FIFO	1
+#endif
+/**
+ * @define ACCEL_USE_DMA
+ * @brief 1: the data bytes of each read are moved by DMA, the I2C interrupt only runs for the address phase
+ * and the last two bytes. 0: one I2C interrupt per byte.
+ */
+#define ACCEL_USE_DMA	1
+/**
+ * @define ACCEL_ODR_HZ
+ * @brief accelerometer (and magnetometer) output data rate: 25, 50, 100, 200 or 400 Hz in hybrid mode.
+ * 800 Hz is only available with the magnetometer off: accel_get_last_data(ACCEL_MAGNET_DATA) stays at 0,
+ * which the orientation needs. tools/accel_check.c checks each rate against a model of the sensor.
+ */
+#ifndef ACCEL_ODR_HZ
+#define ACCEL_ODR_HZ	200
+#endif
+/**
+ * @define ACCEL_FIFO_WATERMARK
+ * @brief samples per FIFO burst read, 1 to 31
+ */
+#ifndef ACCEL_FIFO_WATERMARK
+#define ACCEL_FIFO_WATERMARK	16
+#endif
+/**
+ * @define ACCEL_WHOAMI_TRIES
+ * @brief times the sensor is asked for its WHOAMI before giving up (see accel_get_status()).
+ * The wait between tries doubles from 10 ms up to 1 s
+ */
+#ifndef ACCEL_WHOAMI_TRIES
+#define ACCEL_WHOAMI_TRIES	10
+#endif
 
 /**
  * @typedef enum accel_data_options_t
  * @brief Data Types: Accelerometer or Magnetometer
  */
 typedef enum {ACCEL_ACCEL_DATA, ACCEL_MAGNET_DATA} accel_data_options_t;
+/**
+ * @typedef enum accel_status_t
+ * @brief Looking for the sensor, configured and reading, or not found after ACCEL_WHOAMI_TRIES tries
+ */
+typedef enum {ACCEL_STARTING, ACCEL_RUNNING, ACCEL_NOT_FOUND} accel_status_t;
 /**
  * @typedef enum accel_data_options_t
  * @brief Data Types: Accelerometer or Magnetometer
@@ -27,6 +74,15 @@ typedef struct {
 	int16_t z;
 } accel_raw_data_t;
 
+/**
+ * @typedef struct accel_sample_t
+ * @brief One accelerometer sample, timestamped with the us timebase (see clock.h)
+ */
+typedef struct {
+	accel_raw_data_t acc;
+	clock_us_t time_us;
+} accel_sample_t;
+
 /**
  * @brief Accelerometer and Magnetometer init.
  * @details Initialize the accelerometer and magnetometer interface
@@ -39,6 +95,29 @@ void accel_init();
  * Has no effect when called twice with the same module (safe init).
  */
 accel_raw_data_t accel_get_last_data(accel_data_options_t data_option);
+/**
+ * @brief Amount of samples read from the sensors since init.
+ * @details Wraps around. Compare against a previous value to know whether accel_get_last_data has new data.
+ */
+uint32_t accel_get_sample_count();
+/**
+ * @brief Takes the oldest accelerometer sample not taken yet.
+ * @details Every sample is kept until taken (up to a ring of 64), while accel_get_last_data only has the newest.
+ * @return false if there are no new samples
+ */
+bool accel_pop_sample(accel_sample_t * sample);
+/**
+ * @brief Amount of I2C transactions started to read the sensors since init, for statistics.
+ */
+uint32_t accel_get_transaction_count();
+/**
+ * @brief Amount of times the accelerometer FIFO overflowed (samples were lost) since init.
+ */
+uint32_t accel_get_overflow_count();
+/**
+ * @brief Whether the sensor answered and was configured. ACCEL_NOT_FOUND: no samples will come.
+ */
+accel_status_t accel_get_status();
 
 
 
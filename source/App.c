@@ -15,6 +15,7 @@
 
 #include "Accelerometer/accelerometer.h"
 #include "pc_interface/UART/uart.h"
+#include "util/scheduler.h"
 /*******************************************************************************
  * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
  ******************************************************************************/
@@ -47,7 +48,8 @@ void App_Init (void)
 bool init = true;
 void App_Run (void)
 {
-	ba_periodic();
+	if (!sched_run_once())	// every module adds its tasks on init
+		sched_idle();		// nothing to do until the next interrupt
 //	if(init){
 //		accel_init();
 //		init = !init;
@@ -7,6 +7,9 @@
 
 #include <CAN/CAN.h>
 #include <CAN/MCP25625/MCP25625_driver.h>
+#include "util/ring_buffer.h"
+#include "util/scheduler.h"
+#include "events.h"
 
 // Target bitrate: 125kbit/seg == 8us/bit
 // TBIT = [SYNC_T + PSEG_T + PHSEG1_T + PHSEG2_T ] = N x TQ
@@ -56,15 +59,11 @@ static mcp25625_id_t _CAN_generate_filter_mask_id(uint32_t id_filter_mask, uint1
 //Buffers priorities
 static mcp25625_priority_t txb0_prior,txb1_prior,txb2_prior;
 
-//BUFFERS
-#define CAN_RX_BUFFER_LENGTH 3
-#define CAN_TX_BUFFER_LENGTH 3
-static mcp25625_id_data_t tx_buffer[CAN_TX_BUFFER_LENGTH];
-static mcp25625_id_data_t rx_buffer[CAN_RX_BUFFER_LENGTH];
-static int tx_index_in = 0;
-static int rx_index_in = 0;
-static int tx_index_out = 0;
-static int rx_index_out = 0;
+//BUFFERS (lengths must be powers of two)
+#define CAN_RX_BUFFER_LENGTH 4
+#define CAN_TX_BUFFER_LENGTH 4
+RING_BUFFER_DEFINE(tx_buffer, mcp25625_id_data_t, CAN_TX_BUFFER_LENGTH);	//producer: CAN_send, consumer: controller isr
+RING_BUFFER_DEFINE(rx_buffer, mcp25625_id_data_t, CAN_RX_BUFFER_LENGTH);	//producer: controller isr, consumer: CAN_get
 static bool tx0_free = true;
 static bool tx1_free = true;
 static bool tx2_free = true;
@@ -75,10 +74,10 @@ void CAN_init()
 	if(initialized)
 		return;
 	initialized = true;
-	tx_index_in = 0;
-	rx_index_in = 0;
-	tx_index_out = 0;
-	rx_index_out = 0;
+	rb_clear(&tx_buffer);
+	rb_clear(&rx_buffer);
+	rb_register(&tx_buffer, "can_tx");
+	rb_register(&rx_buffer, "can_rx");
 	got_error = false;
 	tx0_free = true;
 	tx1_free = true;
@@ -123,10 +122,8 @@ void CAN_start()
 		//Clear all interrupt flags (free all buffers and clear errors)
 		mcp25625_write_register(CANINTF_ADDR, 0);
 		//Clear internal buffers
-		tx_index_in = 0;
-		rx_index_in = 0;
-		tx_index_out = 0;
-		rx_index_out = 0;
+		rb_clear(&tx_buffer);
+		rb_clear(&rx_buffer);
 		tx0_free = true;
 		tx1_free = true;
 		tx2_free = true;
@@ -170,26 +167,24 @@ void CAN_set_filter_config(can_filter_t filter)
 
 bool CAN_message_available()
 {
-	return rx_index_in != rx_index_out;
+	return rb_length(&rx_buffer) != 0;
 }
 
+//No masking needed in CAN_send and CAN_get: the controller callback runs from the main loop too (deferred by the driver)
 bool CAN_send(const can_message_t *p_message)
 {
-	mcp25625_driver_enable_interrupt_handling(false);
-	int next_element = tx_index_in + 1;
-	next_element = next_element == CAN_TX_BUFFER_LENGTH? 0 : next_element;
-	bool buffer_not_full = next_element != tx_index_out;
+	mcp25625_id_data_t *p_raw = rb_reserve(&tx_buffer);
+	bool buffer_not_full = p_raw != NULL;
 	if(buffer_not_full)
 	{
-		_CAN_convert_can_message_to_raw(p_message, &tx_buffer[tx_index_in]);
-		tx_index_in = next_element;
+		_CAN_convert_can_message_to_raw(p_message, p_raw);
+		rb_commit(&tx_buffer);
 		//If all buffers are free, call irq so that message is sent.
 		//This will start domino effect. Next time tx free interrupt will take care.
 		//(unless all buffers become free again)
 		if(tx0_free && tx1_free && tx2_free )
 			_CAN_controller_isr();
 	}
-	mcp25625_driver_enable_interrupt_handling(true);
 	return buffer_not_full;
 }
 
@@ -197,15 +192,13 @@ bool CAN_send(const can_message_t *p_message)
 bool CAN_get(can_message_t *p_message)
 {
 	bool got_message = false;
-	mcp25625_driver_enable_interrupt_handling(false);
-	got_message = rx_index_in != rx_index_out;
+	const mcp25625_id_data_t *p_raw = rb_peek(&rx_buffer);
+	got_message = p_raw != NULL;
 	if(got_message)
 	{
-		_CAN_convert_raw_to_can_message(&rx_buffer[rx_index_out], p_message);
-		rx_index_out++;
-		rx_index_out = rx_index_out == CAN_RX_BUFFER_LENGTH ? 0 : rx_index_out;
+		_CAN_convert_raw_to_can_message(p_raw, p_message);
+		rb_release(&rx_buffer);
 	}
-	mcp25625_driver_enable_interrupt_handling(true);
 	return got_message;
 }
 
@@ -334,10 +327,8 @@ static void _CAN_controller_isr(void)
 			tx1_free |= canintf.tx1if;
 			tx2_free |= canintf.tx2if;
 			//Anything to receive? Got space in buffer
-			int next = rx_index_in+1;
-			next = next == CAN_RX_BUFFER_LENGTH? 0 : next;
-			bool rx_buff_full = (next == rx_index_in);
-			while((canintf.rx0if || canintf.rx1if) && !rx_buff_full)
+			mcp25625_id_data_t *p_rx_slot;
+			while((canintf.rx0if || canintf.rx1if) && (p_rx_slot = rb_reserve(&rx_buffer)) != NULL)
 			{
 				mcp25625_rxb_id_t rxb_to_read = RXB0;
 				if(canintf.rx0if && canintf.rx1if)
@@ -375,15 +366,12 @@ static void _CAN_controller_isr(void)
 					canintf.rx1if = false;
 				}
 				//This will clear corresponding flag...
-				mcp25625_read_rx_buffer_id_data(rxb_to_read,&rx_buffer[rx_index_in]);
-				rx_index_in = next;
-				//Prepare for next iteration
-				next = rx_index_in+1;
-				next = next == CAN_RX_BUFFER_LENGTH? 0 : next;
-				rx_buff_full = (next == rx_index_in);
+				mcp25625_read_rx_buffer_id_data(rxb_to_read,p_rx_slot);
+				rb_commit(&rx_buffer);
+				sched_signal(EV_CAN_RX);
 			}
 			//Anything to transfer? got free transmit buffer?
-			if(tx_index_out != tx_index_in && (tx0_free || tx1_free || tx2_free))
+			if(rb_length(&tx_buffer) != 0 && (tx0_free || tx1_free || tx2_free))
 			{
 				//Set free buffers priorities to low
 				if(tx0_free && txb0_prior != LOWEST_PRIOIRTY)
@@ -446,7 +434,7 @@ static void _CAN_controller_isr(void)
 				}
 				//Great! Priorities are ok now!
 				//Transmit data while we can...
-				while((tx0_free || tx1_free ||tx2_free) && (tx_index_out != tx_index_in))
+				while((tx0_free || tx1_free ||tx2_free) && (rb_length(&tx_buffer) != 0))
 				{
 					mcp25625_txb_id_t tx2use;
 					tx2use = tx0_free?TXB0:tx1_free?TXB1:TXB2;
@@ -456,9 +444,8 @@ static void _CAN_controller_isr(void)
 						case TXB1: tx1_free = false; rts_flags |= TXB1_RTS; break;
 						case TXB2: tx2_free = false; rts_flags |= TXB2_RTS; break;
 					}
-					mcp25625_load_tx_buffer_id_data(tx2use, &tx_buffer[tx_index_out]);
-					tx_index_out++;
-					tx_index_out = tx_index_out == CAN_TX_BUFFER_LENGTH? 0 : tx_index_out;
+					mcp25625_load_tx_buffer_id_data(tx2use, rb_peek(&tx_buffer));
+					rb_release(&tx_buffer);
 				}
 			}
 			if(canintf.errif)
@@ -1395,6 +1395,7 @@ mcp25625_rx_status_t mcp25625_read_rx_status(void);
 /**
  * @brief Set mcp25625 set driver interrupt callback.
  * @details callback to be executed when mcp25625 interrupt pin changes state.
+ * It runs from the main loop (deferred work, see util/defer.h), not from the pin interrupt.
  * Reset value: *NULL*
  * @param callback callback to execute. Can be *NULL*.
  */
@@ -10,13 +10,21 @@
 #include <gpio.h>
 #include <hardware.h>
 #include <Interrupts/interrupts.h>
+#include "util/defer.h"
+#include "util/critical.h"
+#include "irq_priorities.h"
 
 //Array used for spi transactions.
 //Size: Memory size + 1 read / write instruction + address worst case.
+//SPI transactions are only made from the main loop (the interrupt callback is deferred, see mcp25625_internal_ISR),
+//so they need no masking.
 #define TEMP_ARRAY_BUFFER_LENGTH 128+2
 static uint8_t temp_array[TEMP_ARRAY_BUFFER_LENGTH];
 //Global flag to indicate if mcp25625 interrupt handling is enabled.
 static bool interrupts_enabled = false;
+//Set by the pin ISR, the pin stays disabled until the callback ran in the main loop (IRQ is level triggered).
+static volatile bool isr_deferred = false;
+static uint8_t isr_work = DEFER_NO_WORK;
 
 /**
  * @enum mcp25625_instruction_t
@@ -80,6 +88,7 @@ typedef enum
 }mcp25625_tx_load_locations_t;
 
 static void mcp25625_internal_ISR(void);
+static void mcp25625_deferred_ISR(void);
 mcp25625_driver_callback_t callback_isr;
 
 static bool initialized = false;
@@ -92,6 +101,7 @@ void mcp25625_driver_init()
 	mcp25625_driver_set_callback(NULL);
 	//Initialize interrupts
 	interrupts_init();
+	isr_work = defer_add(mcp25625_deferred_ISR, 0);
 	//Configure interrupt pin
 	gpioMode(MCP25625_INTREQ_PIN, INPUT);
 	mcp25625_driver_enable_interrupt_handling(true);
@@ -110,12 +120,7 @@ void mcp25625_reset(void)
 	if(!initialized)
 		return;
 	uint8_t instruction = MCP_RESET;
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	spi_master_transfer_blocking((uint8_t*)&instruction, NULL, 1);
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_write(mcp25625_addr_t addr, size_t length, const uint8_t *p_data)
@@ -124,15 +129,10 @@ void mcp25625_write(mcp25625_addr_t addr, size_t length, const uint8_t *p_data)
 			return;
 	if(length <= TEMP_ARRAY_BUFFER_LENGTH-1)
 	{
-		bool int_bkp = interrupts_enabled;
-		if(interrupts_enabled)
-			mcp25625_driver_enable_interrupt_handling(false);
 		temp_array[0] = MCP_WRITE;
 		temp_array[1] = addr;
 		memcpy(&temp_array[2], p_data, length);
 		spi_master_transfer_blocking((uint8_t*)&temp_array,NULL,2+length);
-		if(int_bkp)
-			mcp25625_driver_enable_interrupt_handling(int_bkp);
 	}
 }
 
@@ -142,15 +142,10 @@ void mcp25625_read(mcp25625_addr_t addr, size_t length, uint8_t *p_data)
 			return;
 	if(length <= TEMP_ARRAY_BUFFER_LENGTH-1)
 	{
-		bool int_bkp = interrupts_enabled;
-		if(interrupts_enabled)
-			mcp25625_driver_enable_interrupt_handling(false);
 		temp_array[0] = MCP_READ;
 		temp_array[1] = addr;
 		spi_master_transfer_blocking((uint8_t*)&temp_array,(uint8_t*)&temp_array,2+length);
 		memcpy(p_data,&temp_array[2],length);
-		if(int_bkp)
-			mcp25625_driver_enable_interrupt_handling(int_bkp);
 	}
 }
 
@@ -174,16 +169,11 @@ void mcp25625_bit_modify(mcp25625_addr_t addr, uint8_t mask, uint8_t data)
 {
 	if(!initialized)
 			return;
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_BIT_MODIFY;
 	temp_array[1] = addr;
 	temp_array[2] = mask;
 	temp_array[3] = data;
 	spi_master_transfer_blocking((uint8_t*)&temp_array,NULL,4);
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_read_rx_buffer_id(mcp25625_rxb_id_t buffer_id, mcp25625_id_t *p_id)
@@ -200,14 +190,9 @@ void mcp25625_read_rx_buffer_id(mcp25625_rxb_id_t buffer_id, mcp25625_id_t *p_id
 			location = RXB1_ID;
 			break;
 	}
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_READ_RX_BUFFER + location;
 	spi_master_transfer_blocking((uint8_t*)&temp_array,(uint8_t*)&temp_array,1+sizeof(*p_id));
 	memcpy(p_id, &temp_array[1], sizeof(*p_id));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_load_tx_buffer_id(mcp25625_txb_id_t buffer_id, const mcp25625_id_t *p_id)
@@ -227,14 +212,9 @@ void mcp25625_load_tx_buffer_id(mcp25625_txb_id_t buffer_id, const mcp25625_id_t
 			location = TXB2_ID;
 			break;
 	}
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_LOAD_TX_BUFFER + location;
 	memcpy(&temp_array[1], p_id, sizeof(*p_id));
 	spi_master_transfer_blocking((uint8_t*)&temp_array,NULL,1+sizeof(*p_id));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_read_rx_buffer_data(mcp25625_rxb_id_t buffer_id, mcp25625_data_t *p_data)
@@ -251,14 +231,9 @@ void mcp25625_read_rx_buffer_data(mcp25625_rxb_id_t buffer_id, mcp25625_data_t *
 			location = RXB1_DATA;;
 			break;
 	}
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_READ_RX_BUFFER + location;
 	spi_master_transfer_blocking((uint8_t*)&temp_array,(uint8_t*)&temp_array,1+sizeof(*p_data));
 	memcpy(p_data, &temp_array[1], sizeof(*p_data));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_load_tx_buffer_data(mcp25625_txb_id_t buffer_id, const mcp25625_data_t *p_data)
@@ -278,14 +253,9 @@ void mcp25625_load_tx_buffer_data(mcp25625_txb_id_t buffer_id, const mcp25625_da
 			location = TXB2_DATA;
 			break;
 	}
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_LOAD_TX_BUFFER + location;
 	memcpy(&temp_array[1], p_data, sizeof(*p_data));
 	spi_master_transfer_blocking((uint8_t*)&temp_array,NULL,1+sizeof(*p_data));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_read_rx_buffer_id_data(mcp25625_rxb_id_t buffer_id, mcp25625_id_data_t *p_id_data)
@@ -302,15 +272,10 @@ void mcp25625_read_rx_buffer_id_data(mcp25625_rxb_id_t buffer_id, mcp25625_id_da
 			location = RXB1_ID;
 			break;
 	}
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_READ_RX_BUFFER + location;
 	//we can't know beforehand how many bytes we need. grab them all.
 	spi_master_transfer_blocking((uint8_t*)&temp_array,(uint8_t*)&temp_array,1+sizeof(*p_id_data));
 	memcpy(p_id_data, &temp_array[1], sizeof(*p_id_data));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_load_tx_buffer_id_data(mcp25625_txb_id_t buffer_id, const mcp25625_id_data_t *p_id_data)
@@ -335,14 +300,9 @@ void mcp25625_load_tx_buffer_id_data(mcp25625_txb_id_t buffer_id, const mcp25625
 	size_t bytes_to_transfer = p_id_data->dlc.rtr? 0 : p_id_data->dlc.dlc;
 	bytes_to_transfer = bytes_to_transfer >= 8? 8 : bytes_to_transfer;
 	bytes_to_transfer += sizeof(mcp25625_id_t) + 1;
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_LOAD_TX_BUFFER + location;
 	memcpy(&temp_array[1], p_id_data, bytes_to_transfer);
 	spi_master_transfer_blocking((uint8_t*)&temp_array,NULL,1+bytes_to_transfer);
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 void mcp25625_tx_request_to_send(mcp25625_txb_rts_flag_t tx_rts_flags)
@@ -350,12 +310,7 @@ void mcp25625_tx_request_to_send(mcp25625_txb_rts_flag_t tx_rts_flags)
 	if(!initialized)
 			return;
 	uint8_t instruction = MCP_RTS + tx_rts_flags;
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	spi_master_transfer_blocking(&instruction, NULL, 1);
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 }
 
 mcp25625_status_t mcp25625_read_status(void)
@@ -373,14 +328,9 @@ mcp25625_status_t mcp25625_read_status(void)
 		status.txreq2 = 0;
 		return status;
 	}
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_READ_STATUS;
 	spi_master_transfer_blocking((uint8_t*)&temp_array,(uint8_t*)&temp_array,1+sizeof(status));
 	memcpy(&status, &temp_array[1], sizeof(status));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 	return status;
 }
 
@@ -394,14 +344,9 @@ mcp25625_rx_status_t mcp25625_read_rx_status(void)
 		rx_status.msg_type = 0;
 		return rx_status;
 	};
-	bool int_bkp = interrupts_enabled;
-	if(interrupts_enabled)
-		mcp25625_driver_enable_interrupt_handling(false);
 	temp_array[0] = MCP_RX_STATUS;
 	spi_master_transfer_blocking((uint8_t*)&temp_array,(uint8_t*)&temp_array,1+sizeof(rx_status));
 	memcpy(&rx_status, &temp_array[1], sizeof(rx_status));
-	if(int_bkp)
-		mcp25625_driver_enable_interrupt_handling(int_bkp);
 	return rx_status;
 }
 
@@ -409,11 +354,14 @@ void mcp25625_driver_enable_interrupt_handling(bool enabled)
 {
 	if(!initialized)
 		return;
-	if(enabled)
+	//only the pin ISR has to be kept out while checking isr_deferred
+	crit_state_t crit = crit_enter_prio(IRQ_PRIO_PORT);
+	if(enabled && !isr_deferred)	//if deferred, the pin is enabled again after the callback
 		gpioIRQ(MCP25625_INTREQ_PIN, GPIO_IRQ_MODE_LOGIC_0, &mcp25625_internal_ISR);
 	else
 		gpioIRQ(MCP25625_INTREQ_PIN, GPIO_IRQ_MODE_DISABLE, NULL);
 	interrupts_enabled = enabled;
+	crit_exit(crit);
 }
 
 void mcp25625_driver_set_callback(mcp25625_driver_callback_t callback)
@@ -431,12 +379,20 @@ bool mcp25625_get_IRQ_flag(void)
 
 void mcp25625_internal_ISR()
 {
-	//IRQ may go low and high during ISR. Prevent multiple ISR calls
-	//Now, enable interrupts (callback may be time-demanding...)
-	__enable_irq();
-	//Interrupt flag cleared by gpio.
+	//Callback is time-demanding (blocking SPI transactions), run it from the main loop.
+	//IRQ stays low until the callback clears the flags, so disable the pin until then.
+	isr_deferred = true;
+	gpioIRQ(MCP25625_INTREQ_PIN, GPIO_IRQ_MODE_DISABLE, NULL);
+	defer_post(isr_work);
+}
+
+static void mcp25625_deferred_ISR(void)
+{
 	if(callback_isr != NULL)
 		//Execute callback if callback given
 		callback_isr();
+	isr_deferred = false;
 	//Re-enable interrupts
+	if(interrupts_enabled)
+		gpioIRQ(MCP25625_INTREQ_PIN, GPIO_IRQ_MODE_LOGIC_0, &mcp25625_internal_ISR);
 }
@@ -0,0 +1,125 @@
+/**
+ * @file dma.c
+ * @author Grupo 1 Labo de Micros
+ * @brief eDMA driver, peripheral to memory transfers
+ */
+
+#include "dma.h"
+#include "MK64F12.h"
+#include "util/profiler.h"
+#include "irq_priorities.h"
+#include <stddef.h>
+
+//#define ROCHI_DEBUG
+
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#else
+// host builds, see tools/i2c_check.c: the registers are plain structs owned by the test, which reads the TCDs
+// and moves the bytes itself, and the NVIC is left alone. SERQ, CERQ and CINT are taken by the test as commands
+extern DMA_Type dma_host_regs;
+extern DMAMUX_Type dmamux_host_regs;
+extern SIM_Type sim_host_regs;
+#undef DMA0
+#undef DMAMUX
+#undef SIM
+#undef NVIC_SetPriority
+#undef NVIC_EnableIRQ
+#define DMA0						(&dma_host_regs)
+#define DMAMUX						(&dmamux_host_regs)
+#define SIM							(&sim_host_regs)
+#define NVIC_SetPriority(irq, prio)	((void)(irq), (void)(prio))
+#define NVIC_EnableIRQ(irq)			((void)(irq))
+#define __ISR__						void
+#endif
+
+static dma_callback_t callbacks[DMA_N_CHANNELS];
+static const IRQn_Type dma_irqs[DMA_N_CHANNELS] = {DMA0_IRQn, DMA1_IRQn, DMA2_IRQn, DMA3_IRQn};
+
+static void dma_irq_handler(dma_channel_t ch);
+
+void dma_init()
+{
+	static bool initialized = false;
+	if(initialized) return;
+
+	SIM->SCGC6 |= SIM_SCGC6_DMAMUX_MASK;	// clock gating
+	SIM->SCGC7 |= SIM_SCGC7_DMA_MASK;
+	DMA0->CR = DMA_CR_EDBG_MASK;			// stop after the current transfer while debugging
+	for(int i = 0; i < DMA_N_CHANNELS; i++) {
+		DMA0->CERQ = i;
+		DMAMUX->CHCFG[i] = 0;
+		DMA0->CINT = i;
+		callbacks[i] = NULL;
+		NVIC_SetPriority(dma_irqs[i], IRQ_PRIO_DMA);
+		NVIC_EnableIRQ(dma_irqs[i]);
+	}
+
+	initialized = true;
+}
+
+bool dma_periph_to_mem(dma_channel_t ch, uint8_t source, const volatile uint8_t * reg, uint8_t * dst,
+						uint16_t n, dma_callback_t done)
+{
+	if(ch >= DMA_N_CHANNELS || reg == NULL || dst == NULL || n == 0 || n > DMA_MAX_COUNT)
+		return false;
+
+	DMA0->CERQ = ch;
+	DMAMUX->CHCFG[ch] = 0;					// source can only be changed while disabled
+	callbacks[ch] = done;
+
+	DMA0->TCD[ch].SADDR = (uint32_t)(uintptr_t)reg;
+	DMA0->TCD[ch].SOFF = 0;					// always the same register
+	DMA0->TCD[ch].ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);		// 8 bit both sides
+	DMA0->TCD[ch].NBYTES_MLNO = 1;			// one byte per request
+	DMA0->TCD[ch].SLAST = 0;
+	DMA0->TCD[ch].DADDR = (uint32_t)(uintptr_t)dst;
+	DMA0->TCD[ch].DOFF = 1;
+	DMA0->TCD[ch].DLAST_SGA = 0;
+	DMA0->TCD[ch].CITER_ELINKNO = n;
+	DMA0->TCD[ch].BITER_ELINKNO = n;
+	DMA0->TCD[ch].CSR = DMA_CSR_INTMAJOR_MASK | DMA_CSR_DREQ_MASK;	// interrupt and stop after the last byte
+
+	DMAMUX->CHCFG[ch] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(source);
+	DMA0->SERQ = ch;
+	return true;
+}
+
+void dma_stop(dma_channel_t ch)
+{
+	if(ch < DMA_N_CHANNELS) {
+		DMA0->CERQ = ch;
+		DMAMUX->CHCFG[ch] = 0;
+		DMA0->CINT = ch;
+		callbacks[ch] = NULL;
+	}
+}
+
+static void dma_irq_handler(dma_channel_t ch)
+{
+	PROF_START();
+	DMA0->CINT = ch;
+	if(callbacks[ch] != NULL)
+		callbacks[ch](ch);
+	PROF_END(PROF_DMA0_IRQ + ch);
+}
+
+__ISR__ DMA0_IRQHandler(void)
+{
+	dma_irq_handler(DMA_CH0);
+}
+
+__ISR__ DMA1_IRQHandler(void)
+{
+	dma_irq_handler(DMA_CH1);
+}
+
+__ISR__ DMA2_IRQHandler(void)
+{
+	dma_irq_handler(DMA_CH2);
+}
+
+__ISR__ DMA3_IRQHandler(void)
+{
+	dma_irq_handler(DMA_CH3);
+}
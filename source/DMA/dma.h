@@ -0,0 +1,57 @@
+/**
+ * @file dma.h
+ * @author Grupo 1 Labo de Micros
+ * @brief eDMA driver, peripheral to memory transfers
+ * @details
+ * A channel moves one byte from a peripheral data register to memory every time the peripheral asks for it
+ * (through the DMAMUX), and calls back from its interrupt once all of them have been moved.
+ * Only channels 0 to 3 are handled, the same way the PIT driver handles its four channels.
+ */
+
+#ifndef DMA_DMA_H_
+#define DMA_DMA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DMA_MAX_COUNT	0x7FFFU		// major loop count limit (CITER without channel linking)
+
+/**
+ * @typedef enum dma_channel_t
+ * @brief DMA channels handled by this driver.
+ */
+typedef enum {DMA_CH0, DMA_CH1, DMA_CH2, DMA_CH3, DMA_N_CHANNELS} dma_channel_t;
+
+/**
+ * @typedef dma_callback_t
+ * @brief function called from the channel interrupt when the last byte has been moved.
+ */
+typedef void (*dma_callback_t)(dma_channel_t ch);
+
+/**
+ * @brief Initialize DMA driver.
+ * The function has no effect when called twice (safe init).
+ */
+void dma_init();
+
+/**
+ * @brief Move n bytes from a peripheral register to memory, one per request of the peripheral.
+ * The request is disabled again by hardware after the last byte.
+ * @param ch : channel to use, must not have a transfer in progress.
+ * @param source : DMAMUX request source of the peripheral (MK64 reference manual, table 3-20).
+ * @param reg : peripheral data register, read once per request.
+ * @param dst : where the bytes are stored, consecutively.
+ * @param n : amount of bytes, 1 to DMA_MAX_COUNT.
+ * @param done : function called once all the bytes are in dst, can be NULL.
+ * @return false when the arguments are not valid (nothing is started).
+ */
+bool dma_periph_to_mem(dma_channel_t ch, uint8_t source, const volatile uint8_t * reg, uint8_t * dst,
+						uint16_t n, dma_callback_t done);
+
+/**
+ * @brief Abort the transfer of a channel, if any. Its callback is not called.
+ * @param ch : channel to stop.
+ */
+void dma_stop(dma_channel_t ch);
+
+#endif /* DMA_DMA_H_ */
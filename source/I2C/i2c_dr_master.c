@@ -10,9 +10,14 @@
 #include "stdlib.h"
 #include "general.h"
 #include "board.h"
+#include "util/profiler.h"
+#include "irq_priorities.h"
 
 #define I2C_CLK_FREQ	50000000
 
+#define I2C0_DMA_SOURCE			18	//DMAMUX request sources (MK64 reference manual, table 3-20)
+#define I2C1_I2C2_DMA_SOURCE	19
+
 i2c_service_callback_t interruption_callback[AMOUNT_I2C_DR_MOD] = {NULL, NULL, NULL};
 static I2C_Type* const i2c_dr_modules [AMOUNT_I2C_DR_MOD]= { I2C0, I2C1, I2C2 };
 static void clock_gating_mod(i2c_modules_dr_t mod);
@@ -43,6 +48,7 @@ void i2c_dr_master_init(i2c_modules_dr_t mod, i2c_service_callback_t callback){
 
 	i2c_pos->FLT |= I2C_FLT_SSIE_MASK;
 	uint32_t irq_interrupts[] = I2C_IRQS;//get the module interrupt
+	NVIC_SetPriority(irq_interrupts[mod], IRQ_PRIO_I2C);
 	NVIC_EnableIRQ(irq_interrupts[mod]);	//enable the module interrupt.
 
 	i2c_dr_clear_startf(mod);
@@ -62,13 +68,19 @@ static void clock_gating_mod(i2c_modules_dr_t mod){
 
 }
 void I2C0_IRQHandler(){
+	PROF_START();
 	interruption_callback[I2C0_DR_MOD](I2C0_DR_MOD);
+	PROF_END(PROF_I2C0_IRQ);
 }
 void I2C1_IRQHandler(){
+	PROF_START();
 	interruption_callback[I2C1_DR_MOD](I2C1_DR_MOD);
+	PROF_END(PROF_I2C1_IRQ);
 }
 void I2C2_IRQHandler(){
+	PROF_START();
 	interruption_callback[I2C2_DR_MOD](I2C2_DR_MOD);
+	PROF_END(PROF_I2C2_IRQ);
 }
 /**************************************
 ****************I2Cx_C1 field***********
@@ -115,6 +127,16 @@ void i2c_dr_send_ack(i2c_modules_dr_t mod, bool ack_value){
 }
 
 
+void i2c_dr_set_interrupt(i2c_modules_dr_t mod, bool enabled){
+	unsigned char word = i2c_dr_modules[mod]->C1;
+	(i2c_dr_modules[mod]->C1) ^= (-(unsigned char)enabled ^ word) & (1U << 6);
+}
+void i2c_dr_set_dma(i2c_modules_dr_t mod, bool enabled){
+	unsigned char word = i2c_dr_modules[mod]->C1;
+	(i2c_dr_modules[mod]->C1) ^= (-(unsigned char)enabled ^ word) & (1U << 0);
+}
+
+
 /**************************************
 ****************I2Cx_S field***********
 ***************************************
@@ -169,6 +191,10 @@ bool i2c_dr_get_rxak(i2c_modules_dr_t mod){
 	return (i2c_dr_modules[mod]->S) & 1U;
 }
 
+bool i2c_dr_get_arbitration_lost(i2c_modules_dr_t mod){
+	return ((i2c_dr_modules[mod]->S) >> 4) & 1U;
+}
+
 /**************************************
 ************I2Cx_D field***************
 ***************************************
@@ -186,6 +212,12 @@ unsigned char i2c_dr_read_data(i2c_modules_dr_t mod){
 	data = i2c_dr_modules[mod]->D;
 	return data;
 }
+volatile uint8_t * i2c_dr_get_data_register(i2c_modules_dr_t mod){
+	return &(i2c_dr_modules[mod]->D);
+}
+uint8_t i2c_dr_get_dma_source(i2c_modules_dr_t mod){
+	return mod == I2C0_DR_MOD ? I2C0_DMA_SOURCE : I2C1_I2C2_DMA_SOURCE;
+}
 
 /**************************************
 ************I2Cx_FLT field*************
@@ -12,6 +12,7 @@
 #ifndef I2C_I2C_DR_MASTER_H_
 #define I2C_I2C_DR_MASTER_H_
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @typedef enum i2c_modules_dr_t
@@ -103,6 +104,13 @@ void i2c_dr_clear_iicif(i2c_modules_dr_t mod);
  * @return *false* if the ACK showed no problem, *true* otherwise.
  */
 bool i2c_dr_get_rxak(i2c_modules_dr_t mod);
+/**
+ * @brief I2C Get the arbitration lost flag (ARBL).
+ * @details Set by the hardware when another master took the bus. Cleared by writing 1 to it.
+ * @param mod : I2C module to get the flag from.
+ * @return *true* if arbitration was lost.
+ */
+bool i2c_dr_get_arbitration_lost(i2c_modules_dr_t mod);
 
 /**
  * @brief I2C Write data to the bus.
@@ -116,6 +124,36 @@ void i2c_dr_write_data(i2c_modules_dr_t mod, unsigned char data);
  * @return the byte that was read.
  */
 unsigned char i2c_dr_read_data(i2c_modules_dr_t mod);
+/**
+ * @brief I2C Enable or Disable the module interrupt
+ * @details Disables or enables every interrupt of the module (IICIE), start and stop detection included.
+ * Flags keep being set while disabled, clear IICIF before enabling it again if they are not wanted.
+ * @param mod : I2C module.
+ * @param enabled : true when the interrupt should be enabled. False otherwise.
+ */
+void i2c_dr_set_interrupt(i2c_modules_dr_t mod, bool enabled);
+/**
+ * @brief I2C Enable or Disable DMA requests
+ * @details While enabled (DMAEN), every completed byte transfer requests a DMA transfer instead of
+ * only setting IICIF. The DMA has to read (RX) or write (TX) the data register, see i2c_dr_get_data_register().
+ * @param mod : I2C module.
+ * @param enabled : true when DMA requests should be enabled. False otherwise.
+ */
+void i2c_dr_set_dma(i2c_modules_dr_t mod, bool enabled);
+/**
+ * @brief I2C Get the data register
+ * @details Address of the data register of the module, for a DMA channel to read from or write to.
+ * @param mod : I2C module.
+ * @return pointer to the I2Cx_D register.
+ */
+volatile uint8_t * i2c_dr_get_data_register(i2c_modules_dr_t mod);
+/**
+ * @brief I2C Get the DMA request source
+ * @details DMAMUX source number of the module requests. I2C1 and I2C2 share the same one.
+ * @param mod : I2C module.
+ * @return DMAMUX source.
+ */
+uint8_t i2c_dr_get_dma_source(i2c_modules_dr_t mod);
 /**
  * @brief I2C Enable or Disable Start and Stop Interrupts
  * @details Disables or enables the start or stop detection interrupts.
@@ -9,9 +9,11 @@
  */
 #include <I2C/i2c_dr_master.h>
 #include <I2C/i2c_master_int.h>
-#include "util/queue.h"
+#include "util/ring_buffer.h"
+#include "DMA/dma.h"
+#include "util/critical.h"
+#include "irq_priorities.h"
 #include <stdlib.h>
-#include "MK64F12.h"
 
 /*-------------------------------------------
  ----------------DEFINES---------------------
@@ -30,28 +32,39 @@ typedef struct{
 
 	//tx mode
 	bool last_byte_transmitted;
-	unsigned char to_be_written[MAX_WRITE_CHARS];
-	unsigned char slave_address;		//bytes that will be written in the current write request
+	unsigned char slave_address;
 
-	int to_be_written_length;			//amount of bytes to be written in the current write request
+	int to_be_written_length;			//amount of bytes to be written in the current write request, address bytes included
 	int written_bytes;
 
 	bool rs_sent;
 
 	//rx mode
 	bool last_byte_read;
-	queue_t buffer;
-
-	bool new_data;
+	bool dummy_read;					//the next read is the dummy one, its byte is not stored
+	int read_bytes;						//bytes stored in the read span of the current transaction
 
 	int to_be_read_length;
-	bool bus_busy;
+	bool use_dma;						//data bytes of the current read are moved by DMA
+	int dma_length;						//amount of bytes given to the DMA channel
+
+	bool nack;							//the slave did not acknowledge a written byte
+	i2c_transaction_t * current;		//transaction on the bus, NULL when idle
+	ring_t pending;						//transactions waiting for the bus, in order
 
 } i2c_module_int_t;
 
 /*-------------------------------------------
  ----------------GLOBAL_VARIABLES------------
  -------------------------------------------*/
+#if I2C_INT_QUEUE_LENGTH & (I2C_INT_QUEUE_LENGTH - 1)
+#error "I2C_INT_QUEUE_LENGTH must be a power of two"
+#endif
+
+static i2c_transaction_t * pending_storage[AMOUNT_I2C_INT_MOD][I2C_INT_QUEUE_LENGTH];
+
+static const dma_channel_t dma_channels[AMOUNT_I2C_INT_MOD] = {DMA_CH0, DMA_CH1, DMA_CH2};
+
 i2c_modules_dr_t i2c_dr_modules[AMOUNT_I2C_INT_MOD] = {I2C1_DR_MOD, I2C1_DR_MOD, I2C2_DR_MOD};
 i2c_module_int_t i2cm_mods[AMOUNT_I2C_INT_MOD];
 
@@ -63,9 +76,15 @@ static void i2c_master_int_reset(i2c_modules_dr_t mod_id);
 static void handle_master_mode(i2c_modules_dr_t mod_id);
 static void handle_tx_mode(i2c_module_id_int_t mod_id);
 static void handle_rx_mode(i2c_module_id_int_t mod_id);
+static void start_rx_dma(i2c_module_id_int_t mod_id);
+static void dma_done(dma_channel_t ch);
+static void start_transaction(i2c_module_id_int_t mod_id, i2c_transaction_t * transaction);
+static void start_next(i2c_module_id_int_t mod_id);
+static void transaction_done(i2c_module_id_int_t mod_id);
 
 static void read_byte(i2c_module_id_int_t mod_id);
 static void write_byte(i2c_module_id_int_t mod_id);
+static unsigned char next_byte_to_write(i2c_module_int_t* mod);
 static void send_start_stop(i2c_module_id_int_t mod_id, bool start_stop);
 /*-------------------------------------------
  ----------FUNCTION_IMPLEMENTATION-----------
@@ -75,10 +94,13 @@ void i2c_master_int_init(i2c_module_id_int_t mod_id){
 	if(initialized[mod_id]) return;
 
 	i2c_dr_master_init(mod_id, hardware_interrupt_routine);
+	dma_init();
 
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
 
 	mod->id = mod_id;
+	rb_init(&(mod->pending), pending_storage[mod_id], sizeof(i2c_transaction_t *), I2C_INT_QUEUE_LENGTH);
+	mod->current = NULL;
 
 	i2c_master_int_reset(mod_id);
 
@@ -88,16 +110,18 @@ void i2c_master_int_init(i2c_module_id_int_t mod_id){
 static void i2c_master_int_reset(i2c_modules_dr_t mod_id){
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
 
-	mod->new_data = false;
 	mod->starf_log_count = 0;
 	mod->last_byte_transmitted = false;
 	mod->last_byte_read = false;
 	mod->to_be_written_length = 0;
 	mod->written_bytes = 0;
 	mod->to_be_read_length = 0;
+	mod->use_dma = false;
+	mod->dma_length = 0;
 	mod->rs_sent = false;
-	q_init(&(mod->buffer));
-	mod->bus_busy = false;
+	mod->nack = false;
+	mod->dummy_read = true;
+	mod->read_bytes = 0;
 }
 
 static void hardware_interrupt_routine(i2c_modules_dr_t mod_id){
@@ -108,6 +132,7 @@ static void hardware_interrupt_routine(i2c_modules_dr_t mod_id){
 		i2c_dr_clear_stopf(mod_id);
 		i2c_dr_clear_iicif(mod_id);
 		mod->starf_log_count = 0;
+		transaction_done(mod_id);			//the bus is free: hand the results over and start the next one
 	}
 	else if(i2c_dr_get_startf(mod_id)){		//bus detected start
 		i2c_dr_clear_startf(mod_id);
@@ -133,13 +158,22 @@ static void handle_master_mode(i2c_modules_dr_t mod_id){
 static void handle_tx_mode(i2c_module_id_int_t mod_id){
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
 
-	if( ((I2C0->S) >> 4) & 1U){					//FOR DEBUGGING ONLY!!!
+	if(i2c_dr_get_arbitration_lost(mod_id)){		//FOR DEBUGGING ONLY!!!
 		send_start_stop(mod_id, false);
 	}
 
-	//last byte transmitted or a NACK received when only sending information (no reading action will be performed before sending stop)
-	if(( mod->last_byte_transmitted || i2c_dr_get_rxak(mod_id) ) && (mod->to_be_read_length == 0))
+	//a NACK to any byte written (address, register or ADDR | R) ends the transaction, reads included: nothing is read
+	//and the callback gets I2C_TR_NACK. Before the first byte RXAK is stale, it may be the NACK of the last read.
+	if(mod->written_bytes > 0 && i2c_dr_get_rxak(mod_id)){
+		mod->nack = true;
+		mod->to_be_read_length = 0;
 		send_start_stop(mod_id, false);
+	}
+
+	//last byte transmitted when only sending information (no reading action will be performed before sending stop)
+	else if(mod->last_byte_transmitted && (mod->to_be_read_length == 0)){
+		send_start_stop(mod_id, false);
+	}
 
 	/*last byte to be transmitted when a reading action will be performed is the address of the slave followed by a R bit.
 	  Before this address, a repeated start should be sent!		*/
@@ -152,6 +186,8 @@ static void handle_tx_mode(i2c_module_id_int_t mod_id){
 	else if(mod->last_byte_transmitted){				//the ADDR | R byte has already been sent, so should change to RX mode.
 		i2c_dr_set_tx_rx_mode(mod->id, false);
 		read_byte(mod->id);								//dummy read : triggers the necessary clock cycles for the slave to transfer the first data byte.
+		if(mod->use_dma && mod->to_be_read_length >= 2)
+			start_rx_dma(mod->id);						//the DMA reads all but the last two bytes, NACK and STOP are done here.
 	}
 	else
 		write_byte(mod->id);							//general case for TX mode : sending a byte of data.
@@ -164,59 +200,99 @@ static void handle_rx_mode(i2c_module_id_int_t mod_id){
 		/*if we want to read N bytes from the slave, N+1 reading calls should be performed to get those bytes,
 		 * the first reading call is a dummy read an is made when changing to RX mode from TX mode.
 		 * the last reading call is performed AFTER the stop signal has been sent so as not to trigger any more clock cycles in the bus*/
-		read_byte(mod_id);
-		i2cm_mods[mod_id].new_data = true;
+		read_byte(mod_id);			//the transaction is finished when the stop is detected, see transaction_done()
 	}
 	else
 		read_byte(mod_id);	//general case, reading a byte of data.
 
 }
 
-bool i2c_master_int_has_new_data(i2c_module_id_int_t mod_id){
-	return i2cm_mods[mod_id].new_data;
+/*The first data byte is already being received. The DMA reads every byte but the last two, each read starting the
+ * next byte just like read_byte() does, while the module interrupt is off. The last one it reads starts the byte
+ * that has to be NACKed, so dma_done() gives the read back to the interrupt path for the last two.*/
+static void start_rx_dma(i2c_module_id_int_t mod_id){
+	i2c_module_int_t* mod = &i2cm_mods[mod_id];
+
+	uint32_t n = (uint32_t)(mod->to_be_read_length - 1);		//at least 1, only called with 2 or more bytes left
+	if(n > DMA_MAX_COUNT)
+		return;											//too long for one major loop, keep reading by interrupts
+
+	if(dma_periph_to_mem(dma_channels[mod_id], i2c_dr_get_dma_source(mod_id), i2c_dr_get_data_register(mod_id),
+							&(mod->current->read_data[mod->read_bytes]), n, dma_done)){
+		mod->dma_length = n;
+		i2c_dr_set_interrupt(mod_id, false);
+		i2c_dr_set_dma(mod_id, true);
+	}
 }
 
-void i2c_master_int_read_data(i2c_module_id_int_t mod_id, unsigned char* question, int len_question, int amount_of_bytes){
+static void dma_done(dma_channel_t ch){
+	i2c_module_id_int_t mod_id = I2C0_INT_MOD;
+	while(dma_channels[mod_id] != ch)
+		mod_id++;
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
 
-	//is there information to be sent before the reading action?
-	if( len_question > 0 ){
-		i2c_master_int_write_data(mod->id, question, len_question);			//send that information
-		// add the ADDR | R byte to the end of the buffer
-		mod->to_be_written[mod->to_be_written_length] = (mod->slave_address << 1) | 1u;
-		(mod->to_be_written_length)++;
-	}
-	else{
-		i2c_master_int_write_data(mod->id, NULL, 0);		//only sent the ADDR | R byte
-		mod->to_be_written[0] = (mod->slave_address << 1) | 1u;
-	}
+	i2c_dr_set_dma(mod_id, false);
+	mod->read_bytes += mod->dma_length;
+	mod->to_be_read_length -= mod->dma_length;			//only the byte to be NACKed and the last one are left
+	mod->dma_length = 0;
 
-	mod->to_be_read_length = amount_of_bytes;
-	mod->last_byte_read = false;
+	i2c_dr_clear_iicif(mod_id);							//set by every byte the DMA read
+	if(i2c_dr_get_transfer_complete(mod_id)){			//the next byte already arrived, maybe right before the clear
+		handle_master_mode(mod_id);						//reads it and starts the last one
+		i2c_dr_clear_iicif(mod_id);
+	}
+	i2c_dr_set_interrupt(mod_id, true);					//the last byte interrupts as usual
 }
 
-int i2c_master_int_get_new_data_length(i2c_module_id_int_t mod_id){
-	return q_length(&(i2cm_mods[mod_id].buffer))-1;		//the first element of the buffer is the dummy read and should be ignored!!
+bool i2c_master_int_submit(i2c_module_id_int_t mod_id, i2c_transaction_t * transaction){
+	i2c_module_int_t* mod = &i2cm_mods[mod_id];
+
+	if(transaction == NULL || transaction->write_len < 0 || transaction->read_len < 0
+		|| (transaction->write_len > 0 && transaction->write_data == NULL)
+		|| (transaction->read_len > 0 && transaction->read_data == NULL))
+		return false;
+
+	crit_state_t crit = crit_enter_prio(IRQ_PRIO_I2C);	//from the main loop and from callbacks of other interrupts
+	i2c_transaction_t ** slot = rb_reserve(&(mod->pending));
+	if(slot != NULL){
+		transaction->status = I2C_TR_QUEUED;			//only once it is sure to run: a rejected one keeps its old status
+		*slot = transaction;
+		rb_commit(&(mod->pending));
+		start_next(mod_id);								//at once if the bus is idle
+	}
+	crit_exit(crit);
+
+	return slot != NULL;
 }
 
-void i2c_master_int_get_new_data(i2c_module_id_int_t mod_id, unsigned char* read_data, int amount_of_bytes){
+static void start_next(i2c_module_id_int_t mod_id){
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
-	read_data[0] = q_popfront(&(mod->buffer));		//filtering dummy read.
-	for (int i =0; i < amount_of_bytes; i++)
-		read_data[i] = q_popfront(&(mod->buffer));
+
+	crit_state_t crit = crit_enter_prio(IRQ_PRIO_I2C);
+	i2c_transaction_t ** next = rb_peek(&(mod->pending));
+	if(mod->current == NULL && next != NULL){
+		i2c_transaction_t * transaction = *next;
+		rb_release(&(mod->pending));
+		start_transaction(mod_id, transaction);
+	}
+	crit_exit(crit);
 }
 
-void i2c_master_int_write_data(i2c_module_id_int_t mod_id, unsigned char* write_data, int amount_of_bytes){
+static void start_transaction(i2c_module_id_int_t mod_id, i2c_transaction_t * transaction){
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
 
 	i2c_master_int_reset(mod->id);
-	mod->to_be_written[0] = (mod->slave_address << 1) | 0u;
-	for(int i = 0; i < amount_of_bytes; i++)
-		mod->to_be_written[i+1] = write_data[i];
-
-	mod->to_be_written_length =  amount_of_bytes + 1;
-	mod->last_byte_transmitted = false;
-	mod->written_bytes = 0;
+	mod->current = transaction;
+	mod->slave_address = transaction->address;
+
+	//ADDR | W and the write span. For reads ADDR | R after them, or alone if there is nothing to write
+	mod->to_be_written_length = transaction->write_len + 1;
+	if(transaction->read_len > 0){
+		if(transaction->write_len > 0)
+			(mod->to_be_written_length)++;
+		mod->to_be_read_length = transaction->read_len;
+		mod->use_dma = transaction->use_dma;
+	}
 
 	i2c_dr_set_tx_rx_mode(mod->id, true);
 	i2c_dr_set_start_stop_interrupt(mod->id, true);
@@ -224,9 +300,18 @@ void i2c_master_int_write_data(i2c_module_id_int_t mod_id, unsigned char* write_
 	send_start_stop(mod->id, true);
 }
 
+static void transaction_done(i2c_module_id_int_t mod_id){
+	i2c_module_int_t* mod = &i2cm_mods[mod_id];
+	i2c_transaction_t * transaction = mod->current;
+	if(transaction == NULL)
+		return;
+
+	mod->current = NULL;
+	transaction->status = mod->nack ? I2C_TR_NACK : I2C_TR_DONE;
+	if(transaction->callback != NULL)
+		transaction->callback(transaction);		//may submit the next transaction itself
 
-void i2c_master_int_set_slave_addr(i2c_module_id_int_t mod_id, unsigned char slave_add){
-	i2cm_mods[mod_id].slave_address = slave_add;
+	start_next(mod_id);
 }
 
 static void read_byte(i2c_module_id_int_t mod_id){
@@ -238,7 +323,10 @@ static void read_byte(i2c_module_id_int_t mod_id){
 	else
 		i2c_dr_send_ack(mod_id, false);
 	unsigned char data = i2c_dr_read_data(mod->id);		//performs the reading action, dummy or not.
-	q_pushback(&(mod->buffer), data);					//inserts the new data into buffer, dummy or not.
+	if(mod->dummy_read)
+		mod->dummy_read = false;						//filtering dummy read.
+	else
+		mod->current->read_data[(mod->read_bytes)++] = data;	//straight into the user's read span
 
 	mod->last_byte_read = !(--(mod->to_be_read_length));
 }
@@ -246,17 +334,28 @@ static void read_byte(i2c_module_id_int_t mod_id){
 static void write_byte(i2c_module_id_int_t mod_id){
 	i2c_module_int_t* mod = &i2cm_mods[mod_id];
 
-	i2c_dr_write_data(mod->id, mod->to_be_written[mod->written_bytes]);		//sends the byte of data to the bus
+	i2c_dr_write_data(mod->id, next_byte_to_write(mod));		//sends the byte of data to the bus
 	//updates both amount of written bytes and the last byte transmitted status
 	mod->last_byte_transmitted = ( (++mod->written_bytes) >= mod->to_be_written_length );
 }
 
+//the bytes of the write phase are taken from the transaction as they are sent, nothing is copied
+static unsigned char next_byte_to_write(i2c_module_int_t* mod){
+	i2c_transaction_t * transaction = mod->current;
+	int i = mod->written_bytes;
+
+	if(i == 0)
+		return (mod->slave_address << 1) | (transaction->write_len == 0 && transaction->read_len > 0);
+	else if(i <= transaction->write_len)
+		return transaction->write_data[i - 1];
+	else
+		return (mod->slave_address << 1) | 1u;		//ADDR | R after the repeated start
+}
+
 bool i2c_master_int_bus_busy(i2c_module_id_int_t mod_id){
-	//both software and hardware should be free for the bus to be free!
-	return i2cm_mods[mod_id].bus_busy || i2c_dr_bus_busy(mod_id);
+	i2c_module_int_t* mod = &i2cm_mods[mod_id];
+	return mod->current != NULL || rb_length(&(mod->pending)) > 0;
 }
 static void send_start_stop(i2c_module_id_int_t mod_id, bool start_stop){
-	i2cm_mods[mod_id].bus_busy = start_stop;				//informs the bus is busy (software)
-
 	i2c_dr_send_start_stop(mod_id, start_stop);
 }
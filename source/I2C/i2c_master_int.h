@@ -12,13 +12,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include "util/queue.h"
 
-/**
- * @define MAX_WRITE_CHARS
- * @brief maximum amount of bytes that can be written in a single write message.
- */
-#define MAX_WRITE_CHARS	8
 /**
  * @typedef enum i2c_modules_int_t
  * @brief I2C interface modules
@@ -26,77 +20,74 @@
 typedef enum {I2C0_INT_MOD, I2C1_INT_MOD, I2C2_INT_MOD, AMOUNT_I2C_INT_MOD} i2c_module_id_int_t;
 
 /**
- * @brief I2C MASTER INIT
- * @details Initialize I2C master interface.
- * Has no effect when called twice with the same module (safe init)
- * @param mod_id : module to be initialized.
+ * @define I2C_INT_QUEUE_LENGTH
+ * @brief amount of transactions that can wait for the bus in each module. Must be a power of two.
  */
-void i2c_master_int_init(i2c_module_id_int_t mod_id);
+#define I2C_INT_QUEUE_LENGTH	16
 
 /**
- * @brief I2C Master Read Data
- * @details sends a read data package from a specific I2C module.
- * If specified, the read package will be preceded by a write package with information (for the slave)
- * about the type of reading that will be performed. If this package is not needed, then it will not be sent.
- * @param mod_id : I2C module from which data will be read.
- * @param question : reading information transferred (with a write frame) to the slave before the reading sequence
- * (Repeated Start + Address + Read) is sent.
- * @param len_question : amount of bytes question has. If 0, then no write package will be sent.
- * @param amount_of_bytes : amount of bytes to be received when the reading is performed.
+ * @typedef enum i2c_transaction_status_t
+ * @brief state of a transaction, updated by the interface.
  */
-void i2c_master_int_read_data(i2c_module_id_int_t mod_id, unsigned char* question, int len_question, int amount_of_bytes);
+typedef enum {I2C_TR_QUEUED, I2C_TR_DONE, I2C_TR_NACK} i2c_transaction_status_t;
 
-/**
- * @brief I2C Master has new data
- * @details ask if a specific module has new data in the buffer that has not been read yet.
- * @param mod : I2C module to be asked if new data has been received.
- * @return *true* if new data has arrived to the buffer. *false* otherwise
- */
-bool i2c_master_int_has_new_data(i2c_module_id_int_t mod_id);
+typedef struct i2c_transaction_s i2c_transaction_t;
 
 /**
- * @brief I2C Master get new data length
- * @details ask for the length of the new data a specific module has in the buffer and that  has not been read yet.
- * The user has to know that new data has arrived. See also i2c_master_int_has_new_data() .
- * @param mod_id : I2C module to be asked the new data's length.
- * @return amount of bytes the new data has.
+ * @typedef i2c_transaction_callback_t
+ * @brief function called from the I2C interrupt when a transaction finishes, with the bus already free.
+ * Keep it short, see irq_priorities.h. It may submit more transactions.
  */
-int i2c_master_int_get_new_data_length(i2c_module_id_int_t mod_id);
+typedef void (*i2c_transaction_callback_t)(i2c_transaction_t * transaction);
 
 /**
- * @brief I2C Master get new data
- * @details gets new data from the I2C buffer, following FIFO convention.
- * Data obtained by the use of this function is deleted from the buffer.
- * @param mod_id : I2C module to be asked for the new data.
- * @param read_data : user's buffer into which new data should be loaded.
- * @param amount_of_bytes : amount of bytes to read from the I2C specific module's buffer.
+ * @typedef struct i2c_transaction_t
+ * @brief one I2C transfer: an optional write (e.g. the register address) followed, after a repeated start,
+ * by an optional read. Filled by the user, who keeps it alive and untouched until it finishes.
  */
-void i2c_master_int_get_new_data(i2c_module_id_int_t mod_id, unsigned char* read_data, int amount_of_bytes);
+struct i2c_transaction_s {
+	unsigned char address;					//7 bit slave address
+	const unsigned char * write_data;		//bytes sent first
+	int write_len;							//0 for a read only transaction
+	unsigned char * read_data;				//where the read bytes are stored, straight from the bus
+	int read_len;							//0 for a write only transaction
+	bool use_dma;							//read bytes moved by DMA, see i2c_master_int_submit()
+	i2c_transaction_callback_t callback;	//called when it finishes, can be NULL
+	void * context;							//for the user, not used by the interface
+	volatile i2c_transaction_status_t status;
+};
 
 /**
- * @brief I2C Master write data
- * @details Send a Write frame with a specific module.
- * The slave address the write frames will refer to should be set before calling this function.
- * For this, see also i2c_master_int_set_slave_addr() .
- * @param mod_id : I2C module that will write the data to the slave.
- * @param write_data : data that will be sent to the slave.
- * @param amount_of_bytes : amount of bytes that will be sent to the slave (length of write_data parameter).
+ * @brief I2C MASTER INIT
+ * @details Initialize I2C master interface.
+ * Has no effect when called twice with the same module (safe init).
+ * @param mod_id : module to be initialized.
  */
-void i2c_master_int_write_data(i2c_module_id_int_t mod_id, unsigned char* write_data, int amount_of_bytes);
+void i2c_master_int_init(i2c_module_id_int_t mod_id);
 
 /**
- * @brief I2C Master set slave address
- * @details set the slave adress a specific I2C module will refer its frames to.
- * @param mod_id : I2C module for which the slave's address will be set.
+ * @brief I2C Master submit transaction
+ * @details Queues a transaction for a specific module and returns at once. Transactions are done in order,
+ * back to back: the interrupt that sees the STOP of one starts the next one, so there is no need to wait for the bus.
+ * When it finishes its status is I2C_TR_DONE, its read bytes are in read_data and its callback is called.
+ * If the slave does not acknowledge a byte written to it (address, register or ADDR | R), a STOP is sent at once,
+ * nothing is read and the status is I2C_TR_NACK.
+ * Nothing is copied: bytes are sent from write_data and stored in read_data as they go through the bus,
+ * so both spans can be of any length but must not be touched until the transaction finishes.
+ * With use_dma, the read bytes are moved by a DMA channel instead of one interrupt each: only the address phase
+ * and the last two bytes (NACK and STOP) are handled by the I2C interrupt. Worth it for long reads, reads of less
+ * than 3 bytes are done by interrupts anyway. The DMA channel used has the same number as the module.
+ * Can be called from the main loop and from interrupts not more urgent than IRQ_PRIO_I2C (transaction callbacks included).
+ * @param mod_id : I2C module that will do the transaction.
+ * @param transaction : transaction to be done, its status is set to I2C_TR_QUEUED if it is queued.
+ * @return *false* if the queue is full or a span is missing (nothing is queued).
  */
-void i2c_master_int_set_slave_addr(i2c_module_id_int_t mod_id, unsigned char slave_add);
-
+bool i2c_master_int_submit(i2c_module_id_int_t mod_id, i2c_transaction_t * transaction);
 
 /**
  * @brief I2C Master BUS is busy
- * @details Get the current status of the I2C BUS for a specific I2C module ( Busy or not)
- * The Bus is busy when every START signal sent to the bus has encountered its corresponding STOP signal in the bus
- * (both sent by this master module).
+ * @details Get the current status of a specific I2C module: busy while a transaction is in progress or queued.
+ * Not needed to submit transactions, only to know if there are any left.
  * @param mod_id : I2C module for which the bus status will be checked.
  * @return *true* is the bus is currently busy. *false* otherwise.
  */
@@ -7,6 +7,8 @@
 //#include "gpio.h"
 #include <Interrupts/interrupts.h>
 #include "MK64F12.h"
+#include "util/profiler.h"
+#include "irq_priorities.h"
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -21,6 +23,11 @@ void interrupts_init(){
 	if (is_init)
 		return;
 	is_init = true;
+	NVIC_SetPriority(PORTA_IRQn, IRQ_PRIO_PORT);
+	NVIC_SetPriority(PORTB_IRQn, IRQ_PRIO_PORT);
+	NVIC_SetPriority(PORTC_IRQn, IRQ_PRIO_PORT);
+	NVIC_SetPriority(PORTD_IRQn, IRQ_PRIO_PORT);
+	NVIC_SetPriority(PORTE_IRQn, IRQ_PRIO_PORT);
 	NVIC_EnableIRQ(PORTA_IRQn);
 	NVIC_EnableIRQ(PORTB_IRQn);
 	NVIC_EnableIRQ(PORTC_IRQn);
@@ -97,6 +104,7 @@ void PORT_IRQHandler(uint8_t port_id)
 {
 	if(port_id >= NUM_PORTS)
 		return;
+	PROF_START();
 	PORT_Type * addr_arrays[] = PORT_BASE_PTRS;
 	PORT_Type * port = addr_arrays[port_id];
 	uint32_t port_flags = port->ISFR;
@@ -113,4 +121,5 @@ void PORT_IRQHandler(uint8_t port_id)
 			port->ISFR |= i;
 		}
 	}
+	PROF_END(PROF_PORTA_IRQ + port_id);
 }
@@ -0,0 +1,156 @@
+/**
+ * @file pit.c
+ * @author Grupo 1 Labo de Micros
+ * @date 20 Oct 2019
+ * @brief Periodic Interrupt Timer driver
+ */
+
+#include "pit.h"
+#include "MK64F12.h"
+#include "util/profiler.h"
+#include "irq_priorities.h"
+#include <stddef.h>
+
+//#define ROCHI_DEBUG
+
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#else
+// host builds, see tools/pit_check.c: the registers are plain structs owned by the test, the NVIC is left alone
+// and every TCTRL write is reported, so the test can model when the hardware reloads LDVAL
+extern PIT_Type pit_host_regs;
+extern SIM_Type sim_host_regs;
+void pit_host_tctrl_written(pit_channel_t ch, uint32_t tctrl);
+#undef PIT
+#undef SIM
+#undef NVIC_SetPriority
+#undef NVIC_EnableIRQ
+#define PIT							(&pit_host_regs)
+#define SIM							(&sim_host_regs)
+#define NVIC_SetPriority(irq, prio)	((void)(irq), (void)(prio))
+#define NVIC_EnableIRQ(irq)			((void)(irq))
+#define __ISR__						void
+#endif
+
+#define US_TO_LDVAL(us)	((us) * (PIT_CLOCK_HZ / 1000000U) - 1)
+
+#if PIT_CLOCK_HZ % 1000000U != 0
+#error "PIT clock must be a whole amount of MHz"
+#endif
+
+typedef struct {
+	pit_callback_t callback;
+	callback_conf_t conf;
+} pit_channel_data_t;
+
+static pit_channel_data_t channels[PIT_N_CHANNELS];
+static const IRQn_Type pit_irqs[PIT_N_CHANNELS] = {PIT0_IRQn, PIT1_IRQn, PIT2_IRQn, PIT3_IRQn};
+
+static void set_tctrl(pit_channel_t ch, uint32_t tctrl);
+static void pit_irq_handler(pit_channel_t ch);
+
+void pit_init()
+{
+	static bool initialized = false;
+	if(initialized) return;
+
+	SIM->SCGC6 |= SIM_SCGC6_PIT_MASK;	// clock gating
+	PIT->MCR = PIT_MCR_FRZ_MASK;		// enable module, stop timers while debugging
+	for(int i = 0; i < PIT_N_CHANNELS; i++) {
+		set_tctrl((pit_channel_t)i, 0);
+		PIT->CHANNEL[i].TFLG = PIT_TFLG_TIF_MASK;
+		channels[i].callback = NULL;
+		NVIC_SetPriority(pit_irqs[i], IRQ_PRIO_PIT);
+		NVIC_EnableIRQ(pit_irqs[i]);
+	}
+
+	initialized = true;
+}
+
+pit_channel_t pit_add_callback(pit_callback_t callback, uint32_t period_us, callback_conf_t conf)
+{
+	pit_channel_t ch = PIT_N_CHANNELS;
+	if(callback != NULL && period_us != 0) {
+		for(int i = 0; i < PIT_N_CHANNELS; i++) {
+			if(channels[i].callback == NULL) {
+				ch = (pit_channel_t)i;
+				channels[ch].callback = callback;
+				channels[ch].conf = conf;
+				PIT->CHANNEL[ch].LDVAL = US_TO_LDVAL(period_us);
+				pit_enable_callback(ch);
+				break;
+			}
+		}
+	}
+	return ch;
+}
+
+void pit_enable_callback(pit_channel_t ch)
+{
+	if(ch < PIT_N_CHANNELS && channels[ch].callback != NULL) {
+		set_tctrl(ch, 0);		// a disabled timer reloads LDVAL when enabled
+		PIT->CHANNEL[ch].TFLG = PIT_TFLG_TIF_MASK;
+		set_tctrl(ch, PIT_TCTRL_TIE_MASK | PIT_TCTRL_TEN_MASK);
+	}
+}
+
+void pit_disable_callback(pit_channel_t ch)
+{
+	if(ch < PIT_N_CHANNELS) {
+		set_tctrl(ch, 0);
+		PIT->CHANNEL[ch].TFLG = PIT_TFLG_TIF_MASK;
+	}
+}
+
+void pit_set_period(pit_channel_t ch, uint32_t period_us)
+{
+	if(ch < PIT_N_CHANNELS && period_us != 0)
+		PIT->CHANNEL[ch].LDVAL = US_TO_LDVAL(period_us);
+}
+
+void pit_delete_callback(pit_channel_t ch)
+{
+	if(ch < PIT_N_CHANNELS) {
+		pit_disable_callback(ch);
+		channels[ch].callback = NULL;
+	}
+}
+
+static void set_tctrl(pit_channel_t ch, uint32_t tctrl)
+{
+	PIT->CHANNEL[ch].TCTRL = tctrl;
+#ifdef ROCHI_DEBUG
+	pit_host_tctrl_written(ch, tctrl);
+#endif
+}
+
+static void pit_irq_handler(pit_channel_t ch)
+{
+	PROF_START();
+	PIT->CHANNEL[ch].TFLG = PIT_TFLG_TIF_MASK;	// w1c
+	if(channels[ch].conf == SINGLE_SHOT)
+		set_tctrl(ch, 0);
+	if(channels[ch].callback != NULL)
+		channels[ch].callback();
+	PROF_END(PROF_PIT0_IRQ + ch);
+}
+
+__ISR__ PIT0_IRQHandler(void)
+{
+	pit_irq_handler(PIT_CH0);
+}
+
+__ISR__ PIT1_IRQHandler(void)
+{
+	pit_irq_handler(PIT_CH1);
+}
+
+__ISR__ PIT2_IRQHandler(void)
+{
+	pit_irq_handler(PIT_CH2);
+}
+
+__ISR__ PIT3_IRQHandler(void)
+{
+	pit_irq_handler(PIT_CH3);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file pit.h
+ * @author Grupo 1 Labo de Micros
+ * @date 20 Oct 2019
+ * @brief Periodic Interrupt Timer driver
+ * @details
+ * Each of the four PIT channels is a hardware down counter with its own interrupt, so a callback
+ * added here is called with the exact period, no matter what the rest of the system is doing.
+ * There are only four channels: use them for the few tasks that need a precise period and
+ * leave everything else to the main loop (scheduler and timers).
+ */
+
+#ifndef PIT_PIT_H_
+#define PIT_PIT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PIT_CLOCK_HZ	50000000U	// bus clock
+
+#define PIT_HZ_TO_US(x)	(1000000U / (x))
+
+/**
+ * @typedef enum pit_channel_t
+ * @brief PIT channels. PIT_N_CHANNELS is returned when there is no channel available.
+ */
+typedef enum {PIT_CH0, PIT_CH1, PIT_CH2, PIT_CH3, PIT_N_CHANNELS} pit_channel_t;
+
+typedef void (*pit_callback_t)(void);
+typedef enum{SINGLE_SHOT, PERIODIC} callback_conf_t;
+
+/**
+ * @brief Initialize PIT driver.
+ * The function has no effect when called twice (safe init).
+ */
+void pit_init();
+
+/**
+ * @brief Add function to be called from the interrupt of a free PIT channel. Enabled by default.
+ * @param callback : function to be called every period_us.
+ * @param period_us : time between calls, in microseconds. Must be at least 1.
+ * @param conf : SINGLE_SHOT to be called only once, PERIODIC to keep being called.
+ * @return channel assigned to the callback, PIT_N_CHANNELS if they are all taken.
+ */
+pit_channel_t pit_add_callback(pit_callback_t callback, uint32_t period_us, callback_conf_t conf);
+
+/**
+ * @brief Start counting a whole period from now.
+ * @param ch : channel returned by pit_add_callback()
+ */
+void pit_enable_callback(pit_channel_t ch);
+/**
+ * @brief Stop counting. The callback will not be called until enabled again.
+ * @param ch : channel returned by pit_add_callback()
+ */
+void pit_disable_callback(pit_channel_t ch);
+/**
+ * @brief Change the period. Takes effect after the current period ends.
+ * @param ch : channel returned by pit_add_callback()
+ * @param period_us : time between calls, in microseconds. Must be at least 1.
+ */
+void pit_set_period(pit_channel_t ch, uint32_t period_us);
+/**
+ * @brief Stop the channel and free it for another callback.
+ * @param ch : channel returned by pit_add_callback()
+ */
+void pit_delete_callback(pit_channel_t ch);
+
+#endif /* PIT_PIT_H_ */
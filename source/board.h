@@ -25,6 +25,7 @@
 // Accelerometer pins
 #define ACCEL_SCL_PIN	PORTNUM2PIN(PE, 24u)
 #define ACCEL_SDA_PIN	PORTNUM2PIN(PE, 25u)
+#define ACCEL_INT2_PIN	PORTNUM2PIN(PC, 13u)	// FXOS8700 INT2 (INT1 shares PTC6 with SW2)
 
 #define MCP25625_INTREQ_PIN	PORTNUM2PIN(PD, 0)
 
@@ -6,7 +6,23 @@
 #include "board_manager/board_database.h"
 #include "board_manager/board_observers.h"
 #include "board_manager/board_ev_sources.h"
+#include "pc_interface/pc_interface.h"
+#include "util/scheduler.h"
+#include "util/clock.h"
+#include "util/profiler.h"
+#include "util/Timer/timers.h"
+#include "Accelerometer/accelerometer.h"
+#include "events.h"
 
+#define BA_CHECK_MS     100 // timeouts are checked at least this often
+
+static uint8_t sched_report(unsigned int index, uint8_t * line);
+static uint8_t idle_report(uint8_t * line);
+static uint8_t accel_report(uint8_t * line);
+static uint8_t event_report(unsigned int nth, uint8_t * line);
+#if PROFILER_ENABLED
+static uint8_t prof_report(unsigned int index, uint8_t * line);
+#endif
 
 void ba_init()
 {
@@ -23,6 +39,14 @@ void ba_init()
     }
 
     bo_init();
+    timers_init();  // expired timers are run by the scheduler, from the main loop
+
+    sched_add_task("app", ba_periodic, CLOCK_MS_TO_US(BA_CHECK_MS), 2, EV_DB_UPDATE);
+    pc_register_report('S', sched_report);
+#if PROFILER_ENABLED
+    prof_init();
+    pc_register_report('P', prof_report);
+#endif
 
     // initialize board network and pc network
     // tell board network which function to call when it has new data, which should update the data base
@@ -38,8 +62,6 @@ void ba_init()
 
 void ba_periodic()
 {
-    be_periodic();  // register new events
-
     // check if there is any new information and if so, notify observers
     unsigned int i;
     for (i = 0; i < N_MAX_BOARDS; i++) {
@@ -62,6 +84,117 @@ void ba_periodic()
             }
         }
     }
+}
+
+// then "S idle 812345/1000000 us\r\n", "S accel n 2000 tr 126 ovf 0 run\r\n" (samples, I2C transactions and FIFO
+// overflows since init, then "start", "run" or "none" if the sensor was not found) and one line per event that
+// was signaled, e.g. "S ev 0 n 40 lat 350\r\n" (event bit, times signaled, worst latency in us)
+static uint8_t idle_report(uint8_t * line)
+{
+    uint8_t len = pc_write_str(line, "S idle ");
+    len += pc_write_uint(line + len, (uint32_t)sched_get_idle_us());
+    line[len++] = '/';
+    len += pc_write_uint(line + len, (uint32_t)clock_get_us());
+    len += pc_write_str(line + len, " us\r\n");
+    return len;
+}
+
+static uint8_t accel_report(uint8_t * line)
+{
+    static const char * const status[] = {"start", "run", "none"}; // accel_status_t
+    uint8_t len = pc_write_str(line, "S accel n ");
+    len += pc_write_uint(line + len, accel_get_sample_count());
+    len += pc_write_str(line + len, " tr ");
+    len += pc_write_uint(line + len, accel_get_transaction_count());
+    len += pc_write_str(line + len, " ovf ");
+    len += pc_write_uint(line + len, accel_get_overflow_count());
+    len += pc_write_str(line + len, " ");
+    len += pc_write_str(line + len, status[accel_get_status()]);
+    len += pc_write_str(line + len, "\r\n");
+    return len;
+}
+
+static uint8_t event_report(unsigned int nth, uint8_t * line)
+{
+    uint32_t count = 0, latency = 0;
+    unsigned int event;
+    for (event = 0; event < SCHED_MAX_EVENTS; event++) { // nth event that was signaled at least once
+        latency = sched_get_event_latency(event, &count);
+        if (count && nth-- == 0)
+            break;
+    }
+    if (event >= SCHED_MAX_EVENTS)
+        return 0;
+
+    uint8_t len = pc_write_str(line, "S ev ");
+    len += pc_write_uint(line + len, event);
+    len += pc_write_str(line + len, " n ");
+    len += pc_write_uint(line + len, count);
+    len += pc_write_str(line + len, " lat ");
+    len += pc_write_uint(line + len, latency);
+    len += pc_write_str(line + len, "\r\n");
+    return len;
+}
+
+// one line per task, e.g. "S can p0 runs 1200 ovr 0 avg 35 max 80 lat 120\r\n" (times in us)
+static uint8_t sched_report(unsigned int index, uint8_t * line)
+{
+    sched_task_stats_t stats;
+    unsigned int tasks = sched_task_count();
+    if (index == tasks)
+        return idle_report(line);
+    if (index == tasks + 1)
+        return accel_report(line);
+    if (index > tasks + 1)
+        return event_report(index - tasks - 2, line);
+    if (!sched_get_stats(index, &stats))
+        return 0;
+
+    uint8_t len = pc_write_str(line, "S ");
+    len += pc_write_str(line + len, stats.name);
+    len += pc_write_str(line + len, " p");
+    len += pc_write_uint(line + len, stats.priority);
+    len += pc_write_str(line + len, " runs ");
+    len += pc_write_uint(line + len, stats.runs);
+    len += pc_write_str(line + len, " ovr ");
+    len += pc_write_uint(line + len, stats.overruns);
+    len += pc_write_str(line + len, " avg ");
+    len += pc_write_uint(line + len, stats.runs ? (uint32_t)(stats.total_run_us / stats.runs) : 0);
+    len += pc_write_str(line + len, " max ");
+    len += pc_write_uint(line + len, stats.max_run_us);
+    len += pc_write_str(line + len, " lat ");
+    len += pc_write_uint(line + len, stats.max_latency_us);
+    len += pc_write_str(line + len, "\r\n");
+    return len;
+}
+
+#if PROFILER_ENABLED
+// one line per profiled handler that ran, e.g. "P PIT0 n 1500 min 210 avg 240 max 900 ovr 0\r\n"
+// (times in cycles, ovr: runs over the handler's budget)
+static uint8_t prof_report(unsigned int index, uint8_t * line)
+{
+    prof_stats_t stats;
+    unsigned int entry;
+    for (entry = 0; entry < PROF_N_ENTRIES; entry++) { // index-th entry that was recorded at least once
+        if (prof_get((prof_entry_t)entry, &stats) && index-- == 0)
+            break;
+    }
+    if (entry >= PROF_N_ENTRIES)
+        return 0;
 
-    bo_periodic();
+    uint8_t len = pc_write_str(line, "P ");
+    len += pc_write_str(line + len, prof_name((prof_entry_t)entry));
+    len += pc_write_str(line + len, " n ");
+    len += pc_write_uint(line + len, stats.count);
+    len += pc_write_str(line + len, " min ");
+    len += pc_write_uint(line + len, stats.min);
+    len += pc_write_str(line + len, " avg ");
+    len += pc_write_uint(line + len, (uint32_t)(stats.total / stats.count));
+    len += pc_write_str(line + len, " max ");
+    len += pc_write_uint(line + len, stats.max);
+    len += pc_write_str(line + len, " ovr ");
+    len += pc_write_uint(line + len, stats.over_budget);
+    len += pc_write_str(line + len, "\r\n");
+    return len;
 }
+#endif
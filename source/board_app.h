@@ -16,7 +16,7 @@
 void ba_init();
 
 /**************************************************************************//**
- * @brief Call periodically to update app status
+ * @brief Notifies observers of new data. ba_init() adds it to the scheduler
  *****************************************************************************/
 void ba_periodic();
 
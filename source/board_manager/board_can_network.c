@@ -14,13 +14,20 @@
 
 #include "../util/clock.h"
 #include "../util/msg_queue.h"
+#include "../util/scheduler.h"
+#include "events.h"
 #include <string.h>
 
 
-#define CAN_MIN_MS  (1000.0/CAN_MAX_FREQ)
+#define CAN_MIN_US  CLOCK_HZ_TO_US(CAN_MAX_FREQ)
+#define CAN_QUEUE_LENGTH 32 // messages waiting to be sent. Must be a power of two
 
-static msg_queue_t can_q;
-static clock_t last;
+#if MQ_MSG_LEN < MAX_LEN_CAN_MSG + 1
+#error "queue msg size is too small for can msg len plus id"
+#endif
+
+MQ_DEFINE(can_q, CAN_QUEUE_LENGTH);
+static deadline_t next_send; // messages are not sent before this
 
 static bn_callback_t callback;
 
@@ -44,9 +51,11 @@ void bn_init() {
 #endif
 
     mq_init(&can_q);
+    rb_register(&can_q, "can_q");
+    sched_add_task("can", bn_periodic, CAN_MIN_US, 0, EV_CAN_RX | EV_CAN_TX);
 
     clock_init();
-    last = get_clock();
+    deadline_start(&next_send, 0);
 }
 
 void bn_register_callback(bn_callback_t cb)
@@ -57,27 +66,29 @@ void bn_register_callback(bn_callback_t cb)
 void bn_periodic()
 {
     // send
-    if (can_q.len) {
-        float ms_elapsed = 1000.0*(get_clock()-last)/CLOCKS_PER_SECOND;
-        if (ms_elapsed >= CAN_MIN_MS) {
-            uint8_t data[MAX_LEN_CAN_MSG + 2]; // one byte for terminator, one for id
-            mq_popfront(&can_q, data);
+    if (mq_length(&can_q)) {
+        if (deadline_expired(&next_send)) {
+            uint8_t len;
+            const uint8_t * data = mq_peek(&can_q, &len); // id followed by data
 
 #ifndef ROCHI_DEBUG
             can_message_t msg;
             msg.header.message_id = data[0] - '0' + 0x100; // need actual ID number and not char
             msg.header.frame_type = CAN_STANDARD_FRAME;
             msg.header.rtr = false;
-            msg.header.dlc = strlen(data)-1; // id will not be sent
+            msg.header.dlc = len-1; // id will not be sent
 
-            strcpy(msg.data, &data[1]);
-            // this will copy the terminator too, but because there is extra space this is not an issue
+            memcpy(msg.data, &data[1], len-1);
 
-            CAN_send(&msg);
+            bool sent = CAN_send(&msg);
 #else
-            printf("CAN: %s \n", data);
+            printf("CAN: %.*s \n", len, data);
+            bool sent = true;
 #endif
-            last = get_clock();
+            if (sent) { // otherwise the message stays queued and is sent again on the next run
+                mq_release(&can_q);
+                deadline_start(&next_send, CAN_MIN_US);
+            }
         }
     }
 
@@ -98,12 +109,26 @@ void bn_periodic()
     }
 }
 
-void bn_send(uint8_t msg_id, uint8_t * data)
+uint8_t * bn_reserve()
+{
+    return mq_reserve(&can_q);
+}
+
+void bn_commit(uint8_t len)
 {
-    uint8_t buffer[MAX_LEN_CAN_MSG + 2];
-    buffer[0] = msg_id;
-    strcpy(&buffer[1], data);
-    mq_pushback(&can_q, buffer);
-    bn_periodic(); // see if i can send it right now
+    len = len <= MAX_LEN_CAN_MSG ? len : MAX_LEN_CAN_MSG;
+    mq_commit(&can_q, len + 1); // id is stored along with the data
+    sched_signal(EV_CAN_TX); // see if i can send it right now
+}
+
+void bn_send(uint8_t msg_id, const uint8_t * data, uint8_t len)
+{
+    uint8_t * buffer = bn_reserve();
+    if (buffer != NULL) {
+        len = len <= MAX_LEN_CAN_MSG ? len : MAX_LEN_CAN_MSG;
+        buffer[0] = msg_id;
+        memcpy(&buffer[1], data, len);
+        bn_commit(len);
+    }
 }
 
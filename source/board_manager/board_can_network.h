@@ -17,7 +17,7 @@
 /*******************************************************************************
  * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
  ******************************************************************************/
-#define MAX_LEN_CAN_MSG 5 // in bytes, not counting terminator
+#define MAX_LEN_CAN_MSG 5 // in bytes
 
 #ifndef ROCHI_DEBUG
 #define CAN_MAX_FREQ    20	// max N msgs per second to send
@@ -45,12 +45,26 @@ void bn_register_callback(bn_callback_t cb);
 void bn_periodic();
 
 
+/**
+ * @brief Get a slot to build the next message in place, without copying it. See also bn_commit()
+ * @return buffer to be filled with the message id followed by up to MAX_LEN_CAN_MSG data bytes,
+ * NULL if there is no room for another message
+ */
+uint8_t * bn_reserve();
+
+/**
+ * @brief Queue the message built in the slot given by bn_reserve()
+ * @param len amount of data bytes in the message, not counting the id
+ */
+void bn_commit(uint8_t len);
+
 /**
  * @brief Send message via to CAN network
  * @param msg_id Priority of the message
- * @param data chars to send, 0 terminated
+ * @param data bytes to send
+ * @param len amount of bytes in data, with a max length of MAX_LEN_CAN_MSG
  */
-void bn_send(uint8_t msg_id, uint8_t * data);
+void bn_send(uint8_t msg_id, const uint8_t * data, uint8_t len);
 
 
 #endif //TP2_BOARD_CAN_NETWORK_H
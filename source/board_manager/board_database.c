@@ -11,6 +11,8 @@
  ******************************************************************************/
 
 #include "board_database.h"
+#include "../util/scheduler.h"
+#include "events.h"
 
 /*******************************************************************************
  * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
@@ -23,6 +25,11 @@
  */
 void check_timeouts(board_t * board);
 
+/**
+ * @brief time after an update at which the angle has to be checked again
+ */
+static uint32_t check_period_us(const board_t * board);
+
 
 /*******************************************************************************
  * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
@@ -65,12 +72,11 @@ void bd_add_board(uint8_t id, bool internal) {
         boards[id].orientationData = internal; // for external boards, we assume we wont get yaw til we get one measurement
 
         unsigned int i;
-        clock_t now = get_clock();
         for (i = 0; i < N_ANGLE_TYPES; i++){
             boards[id].newData[i] = true;
             boards[id].angles[i] = 0;
             boards[id].timed_out[i] = !internal; // these will all be true til data is updated
-            boards[id].last_update[i] = now;
+            deadline_start(&boards[id].next_check[i], check_period_us(&boards[id]));
         }
         boards[id].id = id;  // this will not be used, set for consistency
         boards[id].new_timeout = false; // default state
@@ -82,14 +88,14 @@ void bd_update(uint8_t id, angle_type_t angle_type, int32_t value) {
         return; // error
     }
 
-    clock_t now = get_clock();
     boards[id].angles[angle_type] = value;
     if (angle_type == ORIENTATION) {
         boards[id].orientationData = true;
     }
-    boards[id].last_update[angle_type] = now;
+    deadline_start(&boards[id].next_check[angle_type], check_period_us(&boards[id]));
     boards[id].timed_out[angle_type] = false;
     boards[id].newData[angle_type] = true;
+    sched_signal(EV_DB_UPDATE);
 }
 
 
@@ -115,29 +121,26 @@ bool bd_is_ok(uint8_t id)
 
 void check_timeouts(board_t * board)
 {
-    clock_t now = get_clock();
-
     unsigned int i, n = board->orientationData ? N_ANGLE_TYPES : N_ANGLE_TYPES - 1;
+    bool was_ok = true;
+    for (i = 0; i < n; i++) {
+        if (board->timed_out[i])
+            was_ok = false;
+    }
+
     for (i = 0; i < n; i++) {
         if (!board->timed_out[i]) { // no point in checking if it was already timed out
-            float ms_elapsed = ((float)(now - board->last_update[i])) * 1000.0 / (float)CLOCKS_PER_SECOND;
+            if (!deadline_expired(&board->next_check[i])) {
+                continue;
+            }
 
             if (board->internal) {
-                if (ms_elapsed >= BA_UPDATE_MS) {
-                    board->newData[i] = true; // must resend data so other boards dont think im dead
-                    board->last_update[i] = now;
-                }
-            } else if (ms_elapsed >= ANGLE_TIMEOUT_MS) {
+                board->newData[i] = true; // must resend data so other boards dont think im dead
+                deadline_start(&board->next_check[i], check_period_us(board));
+            } else {
                 board->timed_out[i] = true;
-
-                unsigned int j;
-                board->new_timeout = true;
-                for (j = 0; j < n; j++) {
-                    if (j != i && board->timed_out[j]) {
-                        board->new_timeout = false;
-                        break;
-                    }
-                }
+                if (was_ok) // reported once, when the board stops being ok, even if all its angles time out together
+                    board->new_timeout = true;
             }
         }
     }
@@ -167,6 +170,11 @@ ev_db_t bd_newdata(uint8_t id)
     return ev;
 }
 
+static uint32_t check_period_us(const board_t * board)
+{
+    return board->internal ? CLOCK_MS_TO_US(BA_UPDATE_MS) : CLOCK_MS_TO_US(ANGLE_TIMEOUT_MS);
+}
+
 /*******************************************************************************
  ******************************************************************************/
 
@@ -10,11 +10,20 @@
 #include "../Accelerometer/accelerometer.h"
 #include <math.h>
 #include "../util/vector_3d.h"
+#include "../util/fast_math.h"
+#include "../util/fusion.h"
+#include "../util/raw_math.h"
 #include "../util/clock.h"
+#include "../util/scheduler.h"
+#include "events.h"
 
 #define THRESHOLD	5
 
+#if V3D_SINGLE_PRECISION
+#define RAD2DEG(x)  ((x)*(180.0f/(float)M_PI))
+#else
 #define RAD2DEG(x)  ((x)*180.0/M_PI)
+#endif
 
 #define MAX2(a,b)   ((a)>(b) ? (a) : (b))
 #define MAX3(a,b,c) MAX2( (a), MAX2((b), (c)) )
@@ -22,16 +31,29 @@
 void can_callback(uint8_t msg_id, uint8_t * can_data);
 
 static int32_t curr_angles[N_ANGLE_TYPES];
-static clock_t last;
+static deadline_t next_angles; // angles are recalculated when this expires
 
 #define ACC_MAX_FREQ    20
-#define ACC_MIN_MS      (1000.0/ACC_MAX_FREQ)
+#define ACC_MIN_US      CLOCK_HZ_TO_US(ACC_MAX_FREQ)
+
+// 1: angles come from the quaternion filter fed with every sample, 0: from the last sample alone
+#define BE_USE_FUSION   1
+#define BE_BURST        ACCEL_FIFO_WATERMARK    // samples fed to the filter at once
+#define BE_DECIMATION   (ACCEL_ODR_HZ / FUSION_RATE_HZ) // accepted samples averaged into each filter sample
+
+// accelerometer samples are only trusted as gravity when their magnitude is close to 1g
+#define ACC_COUNTS_PER_G    2048 // +-4g range, 14 bits
+#define ACC_MIN_G2          ((uint32_t)(ACC_COUNTS_PER_G * 0.5) * (uint32_t)(ACC_COUNTS_PER_G * 0.5))
+#define ACC_MAX_G2          ((uint32_t)(ACC_COUNTS_PER_G * 1.5) * (uint32_t)(ACC_COUNTS_PER_G * 1.5))
 
 
 
 void get_angles(int32_t * angles);
+void get_fused_angles(int32_t * angles);
+void frame_to_angles(vector_t n, vector_t e, vector_t u, int32_t * angles);
 void must_update_angles(ivector_t ang_end, ivector_t ang_start, bool * ans);
 int round2(double x);
+int round2f(float x);
 
 
 void be_init()
@@ -48,7 +70,8 @@ void be_init()
     // initialize magnetometer & accelerometer
 
     clock_init();
-    last = get_clock();
+    deadline_start(&next_angles, ACC_MIN_US);
+    sched_add_task("sensors", be_periodic, ACC_MIN_US, 1, EV_ACCEL_SAMPLE);
 }
 
 void be_periodic()
@@ -59,12 +82,49 @@ void be_periodic()
 	}
 	acc_init = true;
 
-    bn_periodic();
+#if BE_USE_FUSION
+    // every sample goes to the filter, averaged down to FUSION_RATE_HZ. Angles are only read at ACC_MAX_FREQ.
+    // A FIFO burst is fed at once
+    static accel_raw_data_t group[BE_DECIMATION]; // accepted samples not averaged yet, may span two bursts
+    static uint32_t grouped = 0;
+    static float gx[BE_BURST], gy[BE_BURST], gz[BE_BURST];
+    static float bx[BE_BURST], by[BE_BURST], bz[BE_BURST];
+    vector_soa_t g = {gx, gy, gz};
+    vector_soa_t b = {bx, by, bz};
+    accel_sample_t sample;
+    accel_raw_data_t magn = accel_get_last_data(ACCEL_MAGNET_DATA);
+    uint32_t n = 0;
+    bool more = true;
+    while (more) {
+        more = accel_pop_sample(&sample);
+        if (more) {
+            uint32_t g2 = rm_norm2(sample.acc);
+            if (g2 >= ACC_MIN_G2 && g2 <= ACC_MAX_G2) // otherwise it is being shaken, not just tilted
+                group[grouped++] = sample.acc;
+        }
+        if (grouped == BE_DECIMATION) {
+            accel_raw_data_t accel = rm_average(group, grouped);
+            grouped = 0;
+            gx[n] = -(float)accel.x; gy[n] = -(float)accel.y; gz[n] = -(float)accel.z;
+            bx[n] = (float)magn.x; by[n] = (float)magn.y; bz[n] = (float)magn.z;
+            n++;
+        }
+        if (n == BE_BURST || (!more && n)) {
+            fusion_update_n(g, b, n);
+            n = 0;
+        }
+    }
+#endif
 
-    clock_t now = get_clock();
-    if (1000.0*(now - last)/(float)CLOCKS_PER_SECOND >= ACC_MIN_MS) {
+    if (deadline_periodic(&next_angles, ACC_MIN_US)) {
         int32_t new_angles[N_ANGLE_TYPES];
+#if BE_USE_FUSION
+        if (!fusion_has_estimate())
+            return;
+        get_fused_angles(new_angles);
+#else
         get_angles(new_angles);
+#endif
         bool updates[N_ANGLE_TYPES];
         ivector_t old = {curr_angles[0], curr_angles[1], curr_angles[2]};
         ivector_t new = {new_angles[0], new_angles[1], new_angles[2]};
@@ -123,7 +183,31 @@ void get_angles(int32_t * angles)
 
     vector_t e = v_cross_product(n, u);
 
+    frame_to_angles(n, e, u, angles);
+}
+
+void get_fused_angles(int32_t * angles)
+{
+    vector_t n, e, u;
+    fusion_get_frame(&n, &e, &u);
+    frame_to_angles(n, e, u, angles);
+}
+
+void frame_to_angles(vector_t n, vector_t e, vector_t u, int32_t * angles)
+{
+#if V3D_SINGLE_PRECISION
+    if (fabsf(u.y) >= 1) {
+        u.y = (u.y > 0 ? 1 : -1); // restrict to [-1, 1]
+        angles[ORIENTATION] = -round2f(RAD2DEG(fast_atan2f(n.x, e.x)));
+        angles[ROLL] = 0;
+    }
+    else {
+        angles[ORIENTATION] = -round2f(RAD2DEG(fast_atan2f(-e.y, n.y)));
+        angles[ROLL] = round2f(RAD2DEG(fast_atan2f(-u.x, u.z)));
+    }
 
+    angles[PITCH] = round2f(RAD2DEG(fast_asinf(u.y)));
+#else
     if (fabs((double)u.y) >= 1 ) {
         u.y = (u.y > 0 ? 1 : -1); // restrict to [-1, 1]
         angles[ORIENTATION] = -round2(RAD2DEG(atan2((double)n.x, (double)e.x)));
@@ -135,6 +219,7 @@ void get_angles(int32_t * angles)
     }
 
     angles[PITCH] = round2(RAD2DEG(asin((double)u.y)));
+#endif
 }
 
 
@@ -180,3 +265,11 @@ int round2(double x)
         return (int)(x + 0.5);
 }
 
+int round2f(float x)
+{
+    if (x < 0.0f)
+        return (int)(x - 0.5f);
+    else
+        return (int)(x + 0.5f);
+}
+
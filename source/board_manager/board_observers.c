@@ -41,42 +41,44 @@ void bo_notify_data(observer_t who, uint8_t board_id, angle_type_t angle_type, i
     if (who >= N_OBSERVERS || angle_type >= N_ANGLE_TYPES)
         return;
 
-    uint8_t msg[MAX_MSG_SIZE + 2]; // leave one byte for '\0' and one for package type
-    msg[0] = 'D';
-    msg[1] = board_id + '0'; // convert to char so 0 is not interpreted as terminator
+    uint8_t * msg = NULL; // message is built straight into the observer's queue
+    switch (who) {
+        case O_PC: msg = pc_reserve(); break;
+        case O_CAN: msg = bn_reserve(); break;
+        default: break; // this will not happen
+    }
+    if (msg == NULL)
+        return; // queue is full, message is dropped
+
+    if (who == O_PC) {
+        *msg++ = 'D'; // id is not part of msg in can, only one pckg type
+    }
+    msg[0] = board_id + '0'; // convert to char so 0 is not interpreted as terminator
 
     switch (angle_type) {
-        case PITCH: msg[2] = PITCH_CHAR; break;
-        case ROLL: msg[2] = ROLL_CHAR; break;
-        case ORIENTATION: msg[2] = OR_CHAR; break;
+        case PITCH: msg[1] = PITCH_CHAR; break;
+        case ROLL: msg[1] = ROLL_CHAR; break;
+        case ORIENTATION: msg[1] = OR_CHAR; break;
         default: ; // this will not happen, see first statement in function
     }
 
-    angle_to_string(angle_value, &msg[3]); //sign and three digit number
+    angle_to_string(angle_value, &msg[2]); //sign and three digit number
 
     switch (who) {
-        case O_PC: pc_send(msg); break;
-        case O_CAN: bn_send((uint8_t)msg[1], &msg[2]); break; // id is not part of msg in can, only one pckg type
+        case O_PC: pc_commit(); break;
+        case O_CAN: bn_commit(MAX_LEN_CAN_MSG); break; // angle type, sign and three digits
         default: break; // this will not happen
     }
 }
 
 void bo_notify_timeout(observer_t who, uint8_t board_id) {
     if (who == O_PC) {
-        uint8_t msg[PC_MSG_LEN+1] = {'T', board_id + '0'};
-        strcpy(&msg[2], "00000");
-        pc_send(msg);
+        uint8_t msg[PC_MSG_LEN] = {'T', board_id + '0', '0', '0', '0', '0', '0'};
+        pc_send(msg, PC_MSG_LEN);
     }
 }
 
 
-void bo_periodic() {
-    bn_periodic();
-    pc_periodic();
-}
-
-
-
 void angle_to_string(int angle, uint8_t * str)
 {
     angle = map_to_360(angle);
@@ -111,5 +113,4 @@ void print_angle(uint32_t angle, uint8_t * msg)
 	msg[0] = (uint8_t)cent + '0';
 	msg[1] = (uint8_t)dec + '0';
 	msg[2] = (uint8_t)units + '0';
-	msg[3] = '\0';
 }
@@ -43,11 +43,6 @@ void bo_notify_data(observer_t who, uint8_t board_id, angle_type_t angle_type, i
  */
 void bo_notify_timeout(observer_t who, uint8_t board_id);
 
-/**
- * @brief Call periodically so all pending messages can be sent
- */
-void bo_periodic();
-
 
 
 #endif //TP2_BOARD_OBSERVERS_H
@@ -53,7 +53,7 @@ typedef struct {
 
     uint8_t id;                     // board id
 
-    clock_t last_update[N_ANGLE_TYPES]; // time of last update for each angle
+    deadline_t next_check[N_ANGLE_TYPES]; // when each angle times out (external) or has to be resent (internal)
 } board_t;
 
 
@@ -0,0 +1,23 @@
+/***************************************************************************//**
+  @file     events.h
+  @brief    Events that wake up main loop tasks. See util/scheduler.h
+  @author   Grupo 1 - Labo de Micros 2019
+ ******************************************************************************/
+
+#ifndef _EVENTS_H_
+#define _EVENTS_H_
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+// one bit each, signaled with sched_signal() (interrupts included)
+#define EV_CAN_RX       (1U << 0)   // a CAN frame was received
+#define EV_CAN_TX       (1U << 1)   // a message was queued to be sent by CAN
+#define EV_UART_RX      (1U << 2)   // a byte was received by an uart
+#define EV_PC_TX        (1U << 3)   // a message was queued to be sent to the pc
+#define EV_ACCEL_SAMPLE (1U << 4)   // the accelerometer has new samples
+#define EV_DB_UPDATE    (1U << 5)   // the board database has new data
+#define EV_DEFERRED     (1U << 6)   // an interrupt posted deferred work, see util/defer.h
+
+#endif // _EVENTS_H_
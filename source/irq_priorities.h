@@ -0,0 +1,84 @@
+/***************************************************************************//**
+  @file     irq_priorities.h
+  @brief    NVIC priority of every interrupt used, applied by each driver's init
+  @author   Grupo 1 - Labo de Micros 2019
+ ******************************************************************************/
+
+#ifndef _IRQ_PRIORITIES_H_
+#define _IRQ_PRIORITIES_H_
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+// 0 is the most urgent, the K64 has 4 priority bits (0 to 15). Ordered by deadline: the interrupt that
+// can wait the least goes first. 0 is left free: BASEPRI can not mask it (see util/critical.h)
+
+// SysTick at 8 kHz keeps the us timebase. Missing two ticks in a row loses time, so it can wait < 1 tick
+#define IRQ_PRIO_SYSTICK    1
+// I2C0 handles one byte per interrupt, the bus stalls until it runs (~65 kHz SCL, 9 clocks per byte)
+#define IRQ_PRIO_I2C        2
+// DMA channels finish I2C reads and hand the last bytes back to I2C0: same level, so neither preempts the other
+#define IRQ_PRIO_DMA        2
+// PIT runs the uart flush at 100 Hz (uart.c), the only PIT callback. Late runs only delay the bytes going out
+#define IRQ_PRIO_PIT        3
+// UART RX, one byte per interrupt at 9600 bauds: it can wait a byte time before the next one overruns it
+#define IRQ_PRIO_UART       4
+// PORTA-E pins. The MCP25625 handler only defers its work and the chip keeps its frames until then
+#define IRQ_PRIO_PORT       5
+
+// longest time a handler (callbacks included) may run, us. It delays every less urgent interrupt by this much.
+// Checked at run time by the profiler (util/profiler.h) when it is enabled
+#define IRQ_BUDGET_US_SYSTICK   2       // it only counts the tick, there are no sysTick callbacks
+#define IRQ_BUDGET_US_I2C       10
+#define IRQ_BUDGET_US_DMA       10
+#define IRQ_BUDGET_US_PIT       30
+#define IRQ_BUDGET_US_UART      10
+#define IRQ_BUDGET_US_PORT      10
+
+// how long each interrupt may wait before something is lost, us
+#define IRQ_DEADLINE_US_SYSTICK 125     // one tick
+#define IRQ_DEADLINE_US_I2C     138     // one byte
+#define IRQ_DEADLINE_US_DMA     138     // the byte after the DMA ones
+#define IRQ_DEADLINE_US_PIT     100     // 1% of the fastest PIT callback period (100 Hz)
+#define IRQ_DEADLINE_US_UART    1041    // one byte
+#define IRQ_DEADLINE_US_PORT    1000    // ~one CAN frame, the chip has two receive buffers
+
+/*******************************************************************************
+ * PRIORITY BUDGET CHECK
+ ******************************************************************************/
+
+// worst response of each interrupt: its own budget, plus once every more urgent or same level one, plus sysTick again
+// every tick for the long deadlines (the others are one shot per byte or much slower than a tick)
+#define IRQ_SYSTICK_LOAD_US(deadline)   (((deadline) / IRQ_DEADLINE_US_SYSTICK + 1) * IRQ_BUDGET_US_SYSTICK)
+
+#define IRQ_RESPONSE_US_SYSTICK IRQ_BUDGET_US_SYSTICK
+#define IRQ_RESPONSE_US_I2C     (IRQ_BUDGET_US_I2C + IRQ_BUDGET_US_DMA + IRQ_SYSTICK_LOAD_US(IRQ_DEADLINE_US_I2C))
+#define IRQ_RESPONSE_US_DMA     (IRQ_BUDGET_US_DMA + IRQ_BUDGET_US_I2C + IRQ_SYSTICK_LOAD_US(IRQ_DEADLINE_US_DMA))
+#define IRQ_RESPONSE_US_PIT     (IRQ_BUDGET_US_PIT + IRQ_BUDGET_US_I2C + IRQ_BUDGET_US_DMA \
+                                    + IRQ_SYSTICK_LOAD_US(IRQ_DEADLINE_US_PIT))
+#define IRQ_RESPONSE_US_UART    (IRQ_BUDGET_US_UART + IRQ_BUDGET_US_PIT + IRQ_BUDGET_US_I2C + IRQ_BUDGET_US_DMA \
+                                    + IRQ_SYSTICK_LOAD_US(IRQ_DEADLINE_US_UART))
+#define IRQ_RESPONSE_US_PORT    (IRQ_BUDGET_US_PORT + IRQ_BUDGET_US_UART + IRQ_BUDGET_US_PIT + IRQ_BUDGET_US_I2C \
+                                    + IRQ_BUDGET_US_DMA + IRQ_SYSTICK_LOAD_US(IRQ_DEADLINE_US_PORT))
+
+#if IRQ_RESPONSE_US_SYSTICK > IRQ_DEADLINE_US_SYSTICK
+#error "SysTick may miss its deadline, check IRQ_BUDGET_US_*"
+#endif
+#if IRQ_RESPONSE_US_I2C > IRQ_DEADLINE_US_I2C
+#error "I2C may miss its deadline, check IRQ_BUDGET_US_*"
+#endif
+#if IRQ_RESPONSE_US_DMA > IRQ_DEADLINE_US_DMA
+#error "DMA may miss its deadline, check IRQ_BUDGET_US_*"
+#endif
+#if IRQ_RESPONSE_US_PIT > IRQ_DEADLINE_US_PIT
+#error "PIT may miss its deadline, check IRQ_BUDGET_US_*"
+#endif
+#if IRQ_RESPONSE_US_UART > IRQ_DEADLINE_US_UART
+#error "UART may miss its deadline, check IRQ_BUDGET_US_*"
+#endif
+#if IRQ_RESPONSE_US_PORT > IRQ_DEADLINE_US_PORT
+#error "PORT may miss its deadline, check IRQ_BUDGET_US_*"
+#endif
+
+#endif // _IRQ_PRIORITIES_H_
@@ -17,7 +17,11 @@
 #include "gpio.h"
 
 #include "util/queue.h"
-#include "util/SysTick.h"
+#include "PIT/pit.h"
+#include "util/scheduler.h"
+#include "events.h"
+#include "util/profiler.h"
+#include "irq_priorities.h"
 
 
 /*******************************************************************************
@@ -39,8 +43,62 @@ static pin_t pins [UART_N_IDS][2] = {	// default pins for each UART
 static uint32_t clock_gating_masks[UART_N_IDS] = { SIM_SCGC4_UART0_MASK, SIM_SCGC4_UART1_MASK,
 		SIM_SCGC4_UART2_MASK, SIM_SCGC4_UART3_MASK, SIM_SCGC1_UART4_MASK };
 
-static queue_t tx_q[UART_N_IDS];	// pending trasmissions
-static queue_t rx_q[UART_N_IDS];	// pending messages
+// queues are only allocated for the UARTs that are configured to be used
+#if UART0_TX_Q_LENGTH > 0 && UART0_RX_Q_LENGTH > 0
+QUEUE_DEFINE(uart0_tx_q, UART0_TX_Q_LENGTH);
+QUEUE_DEFINE(uart0_rx_q, UART0_RX_Q_LENGTH);
+#define UART0_QUEUES	&uart0_tx_q, &uart0_rx_q
+#else
+#define UART0_QUEUES	NULL, NULL
+#endif
+
+#if UART1_TX_Q_LENGTH > 0 && UART1_RX_Q_LENGTH > 0
+QUEUE_DEFINE(uart1_tx_q, UART1_TX_Q_LENGTH);
+QUEUE_DEFINE(uart1_rx_q, UART1_RX_Q_LENGTH);
+#define UART1_QUEUES	&uart1_tx_q, &uart1_rx_q
+#else
+#define UART1_QUEUES	NULL, NULL
+#endif
+
+#if UART2_TX_Q_LENGTH > 0 && UART2_RX_Q_LENGTH > 0
+QUEUE_DEFINE(uart2_tx_q, UART2_TX_Q_LENGTH);
+QUEUE_DEFINE(uart2_rx_q, UART2_RX_Q_LENGTH);
+#define UART2_QUEUES	&uart2_tx_q, &uart2_rx_q
+#else
+#define UART2_QUEUES	NULL, NULL
+#endif
+
+#if UART3_TX_Q_LENGTH > 0 && UART3_RX_Q_LENGTH > 0
+QUEUE_DEFINE(uart3_tx_q, UART3_TX_Q_LENGTH);
+QUEUE_DEFINE(uart3_rx_q, UART3_RX_Q_LENGTH);
+#define UART3_QUEUES	&uart3_tx_q, &uart3_rx_q
+#else
+#define UART3_QUEUES	NULL, NULL
+#endif
+
+#if UART4_TX_Q_LENGTH > 0 && UART4_RX_Q_LENGTH > 0
+QUEUE_DEFINE(uart4_tx_q, UART4_TX_Q_LENGTH);
+QUEUE_DEFINE(uart4_rx_q, UART4_RX_Q_LENGTH);
+#define UART4_QUEUES	&uart4_tx_q, &uart4_rx_q
+#else
+#define UART4_QUEUES	NULL, NULL
+#endif
+
+static queue_t * const uart_qs[UART_N_IDS][2] = {	// NULL for UARTs without queues
+				/* TX			RX 			*/
+/* UART_0 */	{ UART0_QUEUES },
+/* UART_1 */	{ UART1_QUEUES },
+/* UART_2 */	{ UART2_QUEUES },
+/* UART_3 */	{ UART3_QUEUES },
+/* UART_4 */	{ UART4_QUEUES }
+};
+
+static const char * const uart_q_names[UART_N_IDS][2] = {
+	{"uart0_tx", "uart0_rx"}, {"uart1_tx", "uart1_rx"}, {"uart2_tx", "uart2_rx"}, {"uart3_tx", "uart3_rx"}, {"uart4_tx", "uart4_rx"}
+};
+
+#define tx_q(id)	(uart_qs[(id)][0])	// pending trasmissions. producer: main loop, consumer: uart_periodic
+#define rx_q(id)	(uart_qs[(id)][1])	// pending messages. producer: uart_irq_handler, consumer: main loop
 
 
 /*******************************************************************************
@@ -49,7 +107,7 @@ static queue_t rx_q[UART_N_IDS];	// pending messages
 
 void uart_irq_handler(uint8_t id); // all interrupts call this handler to avoid copy-pasting code
 
-void uart_periodic(void);	// called by systick, received and transmits
+void uart_periodic(void);	// called by the pit, transmits
 
 
 
@@ -58,14 +116,16 @@ void uart_periodic(void);	// called by systick, received and transmits
  ******************************************************************************/
 
 void uartInit (uint8_t id, uart_cfg_t config){
-	if (id >= UART_N_IDS || uart_active[id] == true)
+	if (id >= UART_N_IDS || uart_active[id] == true || tx_q(id) == NULL)
 		return;
 
 	//////////////////////
 	// initialize buffers
 	//////////////////////
-	q_init(&tx_q[id]);
-	q_init(&rx_q[id]);
+	q_init(tx_q(id));
+	q_init(rx_q(id));
+	rb_register(tx_q(id), uart_q_names[id][0]);
+	rb_register(rx_q(id), uart_q_names[id][1]);
 
 	UART_Type * uart = uarts[id];
 	PORT_Type * addr_arrays[] = PORT_BASE_PTRS;
@@ -129,17 +189,16 @@ void uartInit (uint8_t id, uart_cfg_t config){
 	////////////////
 	uart->C2 = UART_C2_TE_MASK | UART_C2_RE_MASK | UART_C2_RIE_MASK;
 	//UART0->S2 &= ~(0x06); // MSBF = 0, BRK13 = 0
-	switch(id) { // enable interrupts!
-	case 0: NVIC_EnableIRQ(UART0_RX_TX_IRQn); break;
-	case 1: NVIC_EnableIRQ(UART1_RX_TX_IRQn); break;
-	case 2: NVIC_EnableIRQ(UART2_RX_TX_IRQn); break;
-	case 3: NVIC_EnableIRQ(UART3_RX_TX_IRQn); break;
-	case 4: NVIC_EnableIRQ(UART4_RX_TX_IRQn); break;
-	default: break;
+	IRQn_Type irqs[] = UART_RX_TX_IRQS;	// enable interrupts!
+	NVIC_SetPriority(irqs[id], IRQ_PRIO_UART);
+	NVIC_EnableIRQ(irqs[id]);
+
+	static bool flush_added = false;
+	if (!flush_added) { // one flush for all uarts
+		pit_init();
+		pit_add_callback(uart_periodic, PIT_HZ_TO_US(100), PERIODIC);
+		flush_added = true;
 	}
-
-	systick_init();
-	systick_add_callback(uart_periodic, SYSTICK_HZ_TO_RELOAD(100), PERIODIC);
 	uart_active[id] = true;
 }
 
@@ -152,45 +211,35 @@ bool uartIsRxMsg(uint8_t id)
 
 uint8_t uartGetRxMsgLength(uint8_t id)
 {
-	if (id >= UART_N_IDS)
+	if (id >= UART_N_IDS || !uart_active[id])
 		return 0;
 
-	return rx_q[id].len;
+	return q_length(rx_q(id));
 }
 
 
 uint8_t uartReadMsg(uint8_t id, uint8_t* msg, uint8_t cant)
 {
-	if (id >= UART_N_IDS)
+	if (id >= UART_N_IDS || !uart_active[id])
 		return 0;
 
-	uint8_t i = 0;
-	while (i < cant && rx_q[id].len) {
-		msg[i] = q_popfront(&rx_q[id]);
-		i++;
-	}
-	return i;
+	return q_pop_n(rx_q(id), msg, cant);
 }
 
 uint8_t uartWriteMsg(uint8_t id, const uint8_t * msg, uint8_t cant)
 {
-	if (id >= UART_N_IDS)
+	if (id >= UART_N_IDS || !uart_active[id])
 		return 0;
-	uint8_t i = 0;
-	while (i < cant && !q_isfull(&tx_q[id])) {
-		q_pushback(&tx_q[id], msg[i]);
-		i++;
-	}
-	return i;
+	return q_push_n(tx_q(id), msg, cant);
 }
 
 
 bool uartIsTxMsgComplete(uint8_t id)
 {
-	if (id >= UART_N_IDS)
+	if (id >= UART_N_IDS || !uart_active[id])
 		return false;
 
-	return (tx_q[id].len == 0) && (uarts[id]->S1 & UART_S1_TDRE_MASK);
+	return (q_length(tx_q(id)) == 0) && (uarts[id]->S1 & UART_S1_TDRE_MASK);
 }
 
 
@@ -199,14 +248,11 @@ void uart_periodic(void)
 	unsigned int i;
 	for (i = 0; i < UART_N_IDS; i++) {
 		if (uart_active[i]) {
-			// get data
-			while ((uarts[i]->S1 & UART_S1_RDRF_MASK) && !q_isfull(&rx_q[i])) {
-				q_pushback(&rx_q[i], uarts[i]->D);
-			}
+			// data is received by uart_irq_handler only, rx_q must have a single producer
 
 			// send data
-			while ((uarts[i]->S1 & UART_S1_TDRE_MASK) && tx_q[i].len) {
-				uarts[i]->D = q_popfront(&tx_q[i]);
+			while ((uarts[i]->S1 & UART_S1_TDRE_MASK) && q_length(tx_q(i))) {
+				uarts[i]->D = q_popfront(tx_q(i));
 			}
 		}
 	}
@@ -250,9 +296,14 @@ int uart_getchar_present (uint8_t id)
 
 void uart_irq_handler(uint8_t id)
 {
+	PROF_START();
 	uint8_t data =uarts[id]->S1; 	// Read Status (necessary to clear interrupt request)
 	data = uarts[id]->D;			// Read Data -> now flag is cleared
-	q_pushback(&rx_q[id], data);
+	if (rx_q(id) != NULL) {
+		q_pushback(rx_q(id), data);
+		sched_signal(EV_UART_RX);
+	}
+	PROF_END(PROF_UART0_IRQ + id);
 }
 
 
@@ -21,6 +21,19 @@
 
 #define UART_N_IDS   5
 
+// Queue lengths for each UART, in bytes. Must be powers of two.
+// Queues are only allocated for UARTs with a non zero length, uartInit ignores the rest.
+#define UART0_TX_Q_LENGTH	256
+#define UART0_RX_Q_LENGTH	64
+#define UART1_TX_Q_LENGTH	0
+#define UART1_RX_Q_LENGTH	0
+#define UART2_TX_Q_LENGTH	0
+#define UART2_RX_Q_LENGTH	0
+#define UART3_TX_Q_LENGTH	0
+#define UART3_RX_Q_LENGTH	0
+#define UART4_TX_Q_LENGTH	0
+#define UART4_RX_Q_LENGTH	0
+
 //#define UART_HAL_DEFAULT_BAUDRATE 4800
 
 
@@ -45,7 +58,7 @@ typedef struct {
  ******************************************************************************/
 
 /**
- * @brief Initialize UART driver
+ * @brief Initialize UART driver. Has no effect on UARTs without queues, see UARTn_TX_Q_LENGTH
  * @param id UART's number
  * @param config UART's configuration (baudrate, parity, word size)
 */
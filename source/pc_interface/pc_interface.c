@@ -11,18 +11,36 @@
 #endif
 
 #include "../util/msg_queue.h"
+#include "../util/ring_buffer.h"
 #include "../util/clock.h"
+#include "../util/scheduler.h"
+#include "events.h"
 
 #define PC_UART 0
+#define PC_QUEUE_LENGTH 64 // messages waiting to be sent. Must be a power of two
 
-#define PC_MIN_MS (1000.0/PC_MAX_FREQ) // it will round to a slightly faster frequency, but this is not an issue
+#define PC_MIN_US CLOCK_HZ_TO_US(PC_MAX_FREQ) // it will round to a slightly faster frequency, but this is not an issue
 
-#if Q_MSG_LEN != PC_MSG_LEN
-#error "queue msg size does not match pc msg len"
+#if MQ_MSG_LEN < PC_MSG_LEN
+#error "queue msg size is too small for pc msg len"
 #endif
 
-static msg_queue_t uart_q;
-static clock_t last;
+MQ_DEFINE(uart_q, PC_QUEUE_LENGTH);
+static deadline_t next_send; // messages are not sent before this
+
+typedef struct {
+    uint8_t command;
+    pc_report_t report;
+} pc_report_entry_t;
+
+static pc_report_entry_t reports[PC_MAX_REPORTS];
+static uint8_t reports_count;
+static pc_report_t active_report; // report being dumped, NULL if none
+static unsigned int report_line;   // next line of active_report to be sent
+
+static void check_commands();
+static bool send_report_line();
+static uint8_t queue_stats_report(unsigned int index, uint8_t * line);
 
 
 void pc_init()
@@ -43,28 +61,154 @@ void pc_init()
 #endif
 
     clock_init();
-    last = get_clock();
+    deadline_start(&next_send, 0);
+
+    rb_register(&uart_q, "pc_q");
+    sched_add_task("pc", pc_periodic, PC_MIN_US, 3, EV_PC_TX | EV_UART_RX);
+    pc_register_report('Q', queue_stats_report);
+}
+
+void pc_register_report(uint8_t command, pc_report_t report)
+{
+    if (reports_count < PC_MAX_REPORTS && report != NULL) {
+        reports[reports_count].command = command;
+        reports[reports_count].report = report;
+        reports_count++;
+    }
+}
+
+uint8_t * pc_reserve()
+{
+    return mq_reserve(&uart_q);
+}
+
+void pc_commit()
+{
+    mq_commit(&uart_q, PC_MSG_LEN);
+    sched_signal(EV_PC_TX); // see if i can send it right now
 }
 
-void pc_send(uint8_t * msg)
+void pc_send(const uint8_t * msg, uint8_t len)
 {
-    mq_pushback(&uart_q, msg);
-    pc_periodic(); // see if i can send it right now
+    mq_pushback(&uart_q, msg, len);
+    sched_signal(EV_PC_TX); // see if i can send it right now
 }
 
 void pc_periodic()
 {
-    if (uart_q.len) {
-        float time_diff = 1000 * (float)(get_clock() - last) / CLOCKS_PER_SECOND;
-        if (time_diff >= PC_MIN_MS) {
-            uint8_t msg[PC_MSG_LEN + 1]; // leave one byte for terminator
-            mq_popfront(&uart_q, msg);
+    check_commands();
+    if (active_report != NULL) {
+        if (send_report_line()) // reports have priority over messages, so they are not mixed up
+            return;
+    }
+    if (mq_length(&uart_q)) {
+        if (deadline_expired(&next_send)) {
+            uint8_t len;
+            const uint8_t * msg = mq_peek(&uart_q, &len); // sent straight from the queue slot
 #ifndef ROCHI_DEBUG
-            uartWriteMsg(PC_UART, msg, PC_MSG_LEN);
+            uartWriteMsg(PC_UART, msg, len);
 #else
-            printf("PC: %s \n", msg);
+            printf("PC: %.*s \n", len, msg);
 #endif
-            last = get_clock();
+            mq_release(&uart_q);
+            deadline_start(&next_send, PC_MIN_US);
+        }
+    }
+}
+
+static void check_commands()
+{
+#ifndef ROCHI_DEBUG
+    while (active_report == NULL && uartIsRxMsg(PC_UART)) {
+        uint8_t command;
+        uartReadMsg(PC_UART, &command, 1);
+        for (uint8_t i = 0; i < reports_count; i++) {
+            if (reports[i].command == command) {
+                active_report = reports[i].report;
+                report_line = 0;
+                break;
+            }
         }
     }
+#endif
+}
+
+/**
+ * @brief sends the next line of the active report, if the uart is free
+ * @return true if the report is still being sent
+ */
+static bool send_report_line()
+{
+    static uint8_t line[PC_REPORT_LINE_LEN];
+
+#ifndef ROCHI_DEBUG
+    if (!uartIsTxMsgComplete(PC_UART))
+        return true; // wait for the previous line to go out
+#endif
+
+    uint8_t len = active_report(report_line++, line);
+    if (len == 0) {
+        active_report = NULL;
+        return false;
+    }
+#ifndef ROCHI_DEBUG
+    uartWriteMsg(PC_UART, line, len);
+#else
+    printf("%.*s", len, line);
+#endif
+    return true;
+}
+
+static uint8_t queue_stats_report(unsigned int index, uint8_t * line)
+{
+    rb_snapshot_t snap;
+    if (!rb_snapshot(index, &snap))
+        return 0;
+
+    // e.g. "Q uart0_tx 3/256 hw 40 push 1234 drop 0 hist 1200 30 4 0 0 0 0 0\r\n"
+    uint8_t len = pc_write_str(line, "Q ");
+    len += pc_write_str(line + len, snap.name);
+    line[len++] = ' ';
+    len += pc_write_uint(line + len, snap.length);
+    line[len++] = '/';
+    len += pc_write_uint(line + len, snap.capacity);
+#if RB_STATS_ENABLED
+    len += pc_write_str(line + len, " hw ");
+    len += pc_write_uint(line + len, snap.stats.high_water);
+    len += pc_write_str(line + len, " push ");
+    len += pc_write_uint(line + len, snap.stats.pushes);
+    len += pc_write_str(line + len, " drop ");
+    len += pc_write_uint(line + len, snap.stats.drops);
+    len += pc_write_str(line + len, " hist");
+    for (unsigned int i = 0; i < RB_HISTOGRAM_BINS; i++) {
+        line[len++] = ' ';
+        len += pc_write_uint(line + len, snap.stats.histogram[i]);
+    }
+#endif
+    len += pc_write_str(line + len, "\r\n");
+    return len;
+}
+
+uint8_t pc_write_str(uint8_t * dest, const char * str)
+{
+    uint8_t len = 0;
+    while (str[len] != '\0') {
+        dest[len] = (uint8_t)str[len];
+        len++;
+    }
+    return len;
+}
+
+uint8_t pc_write_uint(uint8_t * dest, uint32_t n)
+{
+    char digits[10];
+    uint8_t count = 0;
+    do {
+        digits[count++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+
+    for (uint8_t i = 0; i < count; i++)
+        dest[i] = (uint8_t)digits[count - 1 - i];
+    return count;
 }
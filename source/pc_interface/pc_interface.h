@@ -27,6 +27,21 @@
 
 #define PC_MSG_LEN  7  // one byte for pckg type, one for id, one for angle type, one for sign, three for number
 
+#define PC_REPORT_LINE_LEN  192 // max length of a single line of a report
+#define PC_MAX_REPORTS      4   // amount of different reports that can be registered
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+/**
+ * @brief fills one line of a report that was requested from the pc
+ * @param index line to be written, starting from 0
+ * @param line buffer of PC_REPORT_LINE_LEN bytes where the line should be written
+ * @return amount of bytes written to line. 0 when there are no more lines in the report
+ */
+typedef uint8_t (*pc_report_t)(unsigned int index, uint8_t * line);
+
 
 /*******************************************************************************
  * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
@@ -37,14 +52,46 @@
  */
 void pc_init();
 
+/**
+ * @brief get a slot to build the next message to pc in place, without copying it. See also pc_commit()
+ * @return buffer of PC_MSG_LEN bytes to be filled, NULL if there is no room for another message
+ */
+uint8_t * pc_reserve();
+
+/**
+ * @brief queues the message built in the slot given by pc_reserve()
+ */
+void pc_commit();
+
 /**
  * @brief queues message to send to pc
- * @param data message to send, 0 terminated, with a max length of PC_MSG_LEN
+ * @param data message to send
+ * @param len amount of bytes in data, with a max length of PC_MSG_LEN
+ */
+void pc_send(const uint8_t * data, uint8_t len);
+
+/**
+ * @brief registers a report to be dumped, line by line, when the pc sends the given command byte
+ * @param command byte that the pc sends to request the report
+ * @param report callback that writes each line of the report
+ */
+void pc_register_report(uint8_t command, pc_report_t report);
+
+/**
+ * @brief writes a string without its terminator, for reports
+ * @return amount of bytes written
+ */
+uint8_t pc_write_str(uint8_t * dest, const char * str);
+
+/**
+ * @brief writes a number in decimal, for reports. Up to 10 bytes
+ * @return amount of bytes written
  */
-void pc_send(uint8_t * data);
+uint8_t pc_write_uint(uint8_t * dest, uint32_t n);
 
 /**
- * @brief call periodically so messages can be sent
+ * @brief call periodically so messages can be sent and commands can be received.
+ * pc_init() adds it to the scheduler
  */
 void pc_periodic(); // so it can send any messages it has on queue
 
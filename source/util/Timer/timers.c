@@ -1,44 +1,111 @@
 #include "timers.h"
 #include <stdlib.h>
-#include "../SysTick.h"
+#include <stdint.h>
+#include "../clock.h"
+#include "../scheduler.h"
 
-#define SYSTICKS_PER_MILLISECOND 6
+/* Hashed timer wheel: a running timer is kept in the list of slot (expiry tick % TIMER_WHEEL_SLOTS),
+ * so starting and stopping are O(1), and each ms only the timers in one slot are looked at.
+ * The task is not periodic: it asks the scheduler to wake it up on the next tick with a non empty slot,
+ * so with no timers running it never runs, and ticks with empty slots are skipped without looking at them. */
 
-static void timers_ISR();
+#define US_PER_TICK	1000U	// timers count ms
+#define NO_TIMER	0xFFFF	// end of list
+
+#if (TIMER_WHEEL_SLOTS & (TIMER_WHEEL_SLOTS - 1)) != 0
+#error "TIMER_WHEEL_SLOTS must be a power of two"
+#endif
+
+#if TIMER_TOTAL_TIMERS >= NO_TIMER
+#error "timer ids are stored in a uint16_t"
+#endif
+
+typedef enum {TIMER_IDLE, TIMER_RUNNING, TIMER_FIRING} timer_state_t;
 
 typedef struct
 {
-	unsigned int time_count_ms;
+	uint32_t expires;		// tick on which it is due
 	unsigned int period_ms;
 	timer_mode_t mode;
-	bool enabled;
+	timer_state_t state;	// RUNNING: in the wheel, FIRING: in the list of timers due this tick
 	timer_callback_t callback;
-}timer_t;
+	uint16_t next;
+	uint16_t prev;
+}timer_data_t;
+
+static timer_data_t timers_array[TIMER_TOTAL_TIMERS];
+static uint16_t wheel[TIMER_WHEEL_SLOTS];	// first timer of each slot
+static uint16_t due;						// timers whose callback is about to be called
+static uint32_t current_tick;				// last tick processed
+static clock_us_t current_tick_us;			// time of current_tick
+static uint32_t wake_tick;					// no timer is due before this tick, if wake_set
+static bool wake_set;						// false: no timer is running
+static bool processing;						// in process_tick(), current_tick must not move
+static uint8_t task = SCHED_NO_TASK;
+static bool initialized = false;
 
-static timer_t timers_array[TIMER_TOTAL_TIMERS];
+static void start(unsigned int t_id);
+static void stop(unsigned int t_id);
+static void link(uint16_t * head, uint16_t t_id);
+static void unlink(uint16_t * head, uint16_t t_id);
+static void process_tick();
+static void skip_empty_ticks(clock_us_t now);
+static void set_wake(uint32_t tick);
+static void schedule_wake();
 
 //Initialize Timers
 void timers_init()
 {
-	systick_init();
-	timer_t timer;
-	timer.time_count_ms = 0;
-	timer.period_ms = 0;
-	timer.mode = TIMER_REPEAT;
-	timer.enabled = false;
-	timer.callback = NULL;
+	if (initialized)
+		return;
+
+	clock_init();
 	//Initialize all timers
-	for(int i = 1 ; i < TIMER_TOTAL_TIMERS ; i++)
-		timers_array[i] = timer;
-	//Set ISR
-	systick_add_callback(timers_ISR, SYSTICKS_PER_MILLISECOND, PERIODIC);
+	for(int i = 0 ; i < TIMER_TOTAL_TIMERS ; i++)
+	{
+		timers_array[i].period_ms = 0;
+		timers_array[i].mode = TIMER_REPEAT;
+		timers_array[i].state = TIMER_IDLE;
+		timers_array[i].callback = NULL;
+	}
+	for(int i = 0 ; i < TIMER_WHEEL_SLOTS ; i++)
+		wheel[i] = NO_TIMER;
+	due = NO_TIMER;
+	current_tick = 0;
+	current_tick_us = clock_get_us();
+	wake_set = false;
+	initialized = true;
+	task = sched_add_task("timers", timers_periodic, 0, 1, 0);
+}
+
+void timers_periodic()
+{
+	if (!initialized)
+		return;
+
+	clock_us_t now = clock_get_us();
+	skip_empty_ticks(now);
+	//one tick at a time, so timers are not skipped if the main loop was late
+	processing = true;
+	while (now - current_tick_us >= US_PER_TICK)
+	{
+		current_tick_us += US_PER_TICK;
+		current_tick++;
+		process_tick();
+	}
+	processing = false;
+	schedule_wake();
 }
 
 //Set timer Period
 void timers_set_timer_period(unsigned int t_id, int t_ms)
 {
 	if(t_id < TIMER_TOTAL_TIMERS)
+	{
 		timers_array[t_id].period_ms = t_ms;
+		if (timers_array[t_id].state != TIMER_IDLE)
+			start(t_id);
+	}
 }
 
 //Set timer mode
@@ -53,16 +120,18 @@ void timers_set_timer_enabled(unsigned int t_id , bool enabled)
 {
 	if(t_id < TIMER_TOTAL_TIMERS)
 	{
-			timers_array[t_id].enabled = enabled;
-			timers_array[t_id].time_count_ms = 0;
+		if (enabled)
+			start(t_id);
+		else
+			stop(t_id);
 	}
 }
 
 //Reset timer
 void timers_reset_timer(unsigned int t_id)
 {
-	if(t_id < TIMER_TOTAL_TIMERS)
-		timers_array[t_id].time_count_ms = 0;
+	if(t_id < TIMER_TOTAL_TIMERS && timers_array[t_id].state != TIMER_IDLE)
+		start(t_id);
 }
 
 //Set timer callback
@@ -72,18 +141,133 @@ void timers_set_timer_callback(unsigned int t_id, timer_callback_t callback)
 		timers_array[t_id].callback = callback;
 }
 
-void timers_ISR()
+//(Re)start counting a whole period from now. Timers with period 0 stay enabled but never expire
+static void start(unsigned int t_id)
 {
-	for(int i = 0 ; i < TIMER_TOTAL_TIMERS ; i++)
-		if(timers_array[i].enabled && timers_array[i].period_ms != 0)
-			if(++timers_array[i].time_count_ms == timers_array[i].period_ms)
+	timer_data_t * timer = &timers_array[t_id];
+	uint32_t now_tick = current_tick;
+	stop(t_id);
+	//the task may have slept through many ticks, or be due and not have run yet: count from the tick of now
+	if (!processing)
+	{
+		clock_us_t now = clock_get_us();
+		skip_empty_ticks(now);
+		now_tick = current_tick + (uint32_t)((now - current_tick_us) / US_PER_TICK);
+	}
+	timer->expires = now_tick + timer->period_ms;
+	if (timer->period_ms != 0)
+	{
+		link(&wheel[timer->expires & (TIMER_WHEEL_SLOTS - 1)], t_id);
+		//timers_periodic() schedules the wake up itself after processing
+		if (!processing && (!wake_set || (int32_t)(timer->expires - wake_tick) < 0))
+			set_wake(timer->expires);
+	}
+	timer->state = TIMER_RUNNING;
+}
+
+static void stop(unsigned int t_id)
+{
+	timer_data_t * timer = &timers_array[t_id];
+	if (timer->state == TIMER_RUNNING && timer->period_ms != 0)
+		unlink(&wheel[timer->expires & (TIMER_WHEEL_SLOTS - 1)], t_id);
+	else if (timer->state == TIMER_FIRING)
+		unlink(&due, t_id);
+	timer->state = TIMER_IDLE;
+}
+
+static void process_tick()
+{
+	uint16_t * slot = &wheel[current_tick & (TIMER_WHEEL_SLOTS - 1)];
+
+	//first move the ones that are due out of the wheel, callbacks may start or stop any timer
+	uint16_t t_id = *slot;
+	while (t_id != NO_TIMER)
+	{
+		uint16_t next = timers_array[t_id].next;
+		if (timers_array[t_id].expires == current_tick)
+		{
+			unlink(slot, t_id);
+			link(&due, t_id);
+			timers_array[t_id].state = TIMER_FIRING;
+		}
+		t_id = next;
+	}
+
+	while (due != NO_TIMER)
+	{
+		t_id = due;
+		timer_data_t * timer = &timers_array[t_id];
+		unlink(&due, t_id);
+		timer->state = TIMER_IDLE;
+		//Keep it running if TIMER_REPEAT, before the callback so it can stop it
+		if (timer->mode == TIMER_REPEAT)
+			start(t_id);
+		//Execute callback.
+		if (timer->callback != NULL)
+			timer->callback(t_id);
+	}
+}
+
+//Moves current_tick up to now without looking at the slots, but not past the tick before wake_tick:
+//there is no timer due in between
+static void skip_empty_ticks(clock_us_t now)
+{
+	uint32_t ticks = (uint32_t)((now - current_tick_us) / US_PER_TICK);
+	if (wake_set && ticks > wake_tick - current_tick - 1)
+		ticks = wake_tick - current_tick - 1;
+	current_tick += ticks;
+	current_tick_us += (clock_us_t)ticks * US_PER_TICK;
+}
+
+static void set_wake(uint32_t tick)
+{
+	wake_tick = tick;
+	wake_set = true;
+	sched_wake_at(task, current_tick_us + (clock_us_t)(tick - current_tick) * US_PER_TICK);
+}
+
+//Every running timer is in the slot of its expiry tick modulo the wheel. Slots are looked at in the order of
+//the ticks ahead, so the first timer due on the tick of its slot is the next one to expire. Timers due more
+//than a turn ahead only count when none is due within a turn
+static void schedule_wake()
+{
+	uint32_t first_ahead = 0;
+	wake_set = false;
+	for (uint32_t ahead = 1; ahead <= TIMER_WHEEL_SLOTS; ahead++)
+	{
+		uint16_t t_id = wheel[(current_tick + ahead) & (TIMER_WHEEL_SLOTS - 1)];
+		for (; t_id != NO_TIMER; t_id = timers_array[t_id].next)
+		{
+			uint32_t expires_ahead = timers_array[t_id].expires - current_tick;
+			if (expires_ahead == ahead)
 			{
-				//Reset Time count
-				timers_array[i].time_count_ms = 0;
-				//Disable timer if TIMER_SINGLE
-				timers_array[i].enabled = timers_array[i].mode == TIMER_REPEAT ? true : false;
-				//Execute callback.
-				if(timers_array[i].callback != NULL)
-					timers_array[i].callback(i);
+				set_wake(current_tick + ahead);
+				return;
 			}
+			if (first_ahead == 0 || expires_ahead < first_ahead)
+				first_ahead = expires_ahead;
+		}
+	}
+	if (first_ahead != 0)
+		set_wake(current_tick + first_ahead);
+}
+
+static void link(uint16_t * head, uint16_t t_id)
+{
+	timers_array[t_id].prev = NO_TIMER;
+	timers_array[t_id].next = *head;
+	if (*head != NO_TIMER)
+		timers_array[*head].prev = t_id;
+	*head = t_id;
+}
+
+static void unlink(uint16_t * head, uint16_t t_id)
+{
+	timer_data_t * timer = &timers_array[t_id];
+	if (timer->prev != NO_TIMER)
+		timers_array[timer->prev].next = timer->next;
+	else
+		*head = timer->next;
+	if (timer->next != NO_TIMER)
+		timers_array[timer->next].prev = timer->prev;
 }
@@ -10,8 +10,14 @@
 
 #include <stdbool.h>
 
-//Total timers to implement
-#define TIMER_TOTAL_TIMERS 2
+//Total timers to implement, 24 bytes of RAM each. Set it at build time (-DTIMER_TOTAL_TIMERS=n)
+//to what the users need; tools/timers_check.c runs the wheel with 500 timers at once
+#ifndef TIMER_TOTAL_TIMERS
+#define TIMER_TOTAL_TIMERS 8
+#endif
+//Slots in the timer wheel, must be a power of two. Timers due in more than this amount of ms
+//share a slot with closer ones, which costs a compare per tick but is still correct
+#define TIMER_WHEEL_SLOTS 64
 
 //Timer Callback
 typedef void (*timer_callback_t)(unsigned int t_id);
@@ -24,7 +30,10 @@ typedef enum {TIMER_REPEAT,TIMER_SINGLE} timer_mode_t;
 
 //Initialize Timers
 void timers_init();
-//Set timer Period
+//Called from the main loop by the scheduler, only on the ticks a timer may expire on.
+//Callbacks of expired timers are called from here, never from an interrupt
+void timers_periodic();
+//Set timer Period. Restarts the timer if it is running
 void timers_set_timer_period(unsigned int t_id, int t_ms);
 //Set timer mode
 void timers_set_timer_mode(unsigned int t_id, timer_mode_t mode);
@@ -7,15 +7,15 @@
 
 
 #include "clock.h"
-#include "Systick.h"
-
-#if CLOCKS_PER_SECOND != SYSTICK_ISR_FREQUENCY_HZ
-#error "use same frequency as systick!"
-#endif
 
+//#define ROCHI_DEBUG
 
-static volatile clock_t clock;
-void callback(void);
+#ifndef ROCHI_DEBUG
+#include "SysTick.h"
+#else
+// host builds: the program gives the time, real (see tools/sched_check.c) or simulated
+clock_us_t clock_host_get_us(void);
+#endif
 
 
 void clock_init(void)
@@ -25,17 +25,38 @@ void clock_init(void)
 		return;
 
 	isinit = true;
-	clock = 0;
+#ifndef ROCHI_DEBUG
 	systick_init();
-	systick_add_callback(callback, 0, PERIODIC);
+#endif
+}
+
+clock_us_t clock_get_us(void)
+{
+#ifndef ROCHI_DEBUG
+	return systick_get_us();
+#else
+	return clock_host_get_us();
+#endif
+}
+
+void deadline_start(deadline_t * deadline, uint32_t period_us)
+{
+	deadline->expires = clock_get_us() + period_us;
 }
 
-void callback(void)
+bool deadline_expired(const deadline_t * deadline)
 {
-	clock++;
+	return clock_get_us() >= deadline->expires;
 }
 
-clock_t get_clock(void)
+bool deadline_periodic(deadline_t * deadline, uint32_t period_us)
 {
-	return clock;
+	clock_us_t now = clock_get_us();
+	if (now < deadline->expires)
+		return false;
+
+	deadline->expires += period_us;
+	if (deadline->expires <= now) // fell behind, do not fire several times in a row to catch up
+		deadline->expires = now + period_us;
+	return true;
 }
@@ -9,13 +9,27 @@
 #define UTIL_CLOCK_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
-typedef uint32_t clock_t;
+// microseconds since clock_init. 64 bits never wrap around, so times can be compared directly
+typedef uint64_t clock_us_t;
 
-#define CLOCKS_PER_SECOND	8000U
+#define CLOCK_MS_TO_US(ms)	((uint32_t)(ms) * 1000U)
+#define CLOCK_HZ_TO_US(hz)	(1000000U / (uint32_t)(hz))
+
+// a point in time to wait for
+typedef struct {
+	clock_us_t expires;
+} deadline_t;
 
 void clock_init(void);
-clock_t get_clock(void);
+clock_us_t clock_get_us(void);
+
+// deadline expires period_us from now
+void deadline_start(deadline_t * deadline, uint32_t period_us);
+bool deadline_expired(const deadline_t * deadline);
+// if expired, moves the deadline period_us forward (from now if it fell more than a period behind) and returns true
+bool deadline_periodic(deadline_t * deadline, uint32_t period_us);
 
 
 #endif /* UTIL_CLOCK_H_ */
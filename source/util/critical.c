@@ -0,0 +1,109 @@
+/***************************************************************************//**
+ * @file critical.c
+ * @brief Critical sections that nest and restore the interrupt state they found
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "critical.h"
+
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#else
+#include <pthread.h>
+#endif
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define CRIT_BASEPRI_FLAG   (1UL << 31) // state is an old BASEPRI, not an old PRIMASK
+
+/*******************************************************************************
+ * VARIABLES WITH LOCAL SCOPE
+ ******************************************************************************/
+
+#ifdef ROCHI_DEBUG
+static pthread_mutex_t crit_mutex;
+static pthread_once_t crit_once = PTHREAD_ONCE_INIT;
+#endif
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+#ifdef ROCHI_DEBUG
+static void crit_mutex_init(void);
+#endif
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+#ifndef ROCHI_DEBUG
+
+crit_state_t crit_enter(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+crit_state_t crit_enter_prio(uint8_t priority)
+{
+    if (priority == 0)
+        return crit_enter();
+    uint32_t basepri = __get_BASEPRI();
+    __set_BASEPRI_MAX((uint32_t)priority << (8U - __NVIC_PRIO_BITS)); // only raises the mask
+    return basepri | CRIT_BASEPRI_FLAG;
+}
+
+void crit_exit(crit_state_t state)
+{
+    if (state & CRIT_BASEPRI_FLAG)
+        __set_BASEPRI(state & ~CRIT_BASEPRI_FLAG);
+    else
+        __set_PRIMASK(state);
+}
+
+#else
+
+crit_state_t crit_enter(void)
+{
+    pthread_once(&crit_once, crit_mutex_init);
+    pthread_mutex_lock(&crit_mutex);
+    return 0;
+}
+
+crit_state_t crit_enter_prio(uint8_t priority)
+{
+    (void)priority;
+    return crit_enter();
+}
+
+void crit_exit(crit_state_t state)
+{
+    (void)state;
+    pthread_mutex_unlock(&crit_mutex);
+}
+
+#endif
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+#ifdef ROCHI_DEBUG
+// recursive, so critical sections nest like they do on target
+static void crit_mutex_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&crit_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+#endif
@@ -0,0 +1,53 @@
+/***************************************************************************//**
+ * @file critical.h
+ * @brief Critical sections that nest and restore the interrupt state they found
+ * @details crit_enter() masks every interrupt (PRIMASK), crit_enter_prio() only the ones that are not more
+ * urgent than a given NVIC priority (BASEPRI), so urgent interrupts keep running. Both return the previous
+ * state, which crit_exit() restores: entering from an interrupt, from code that already masked interrupts
+ * or from another critical section leaves the outer one in effect.
+ * On host debug builds (ROCHI_DEBUG) both take a recursive mutex, so the same code runs with threads
+ * standing in for interrupts.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef TP2_CRITICAL_H
+#define TP2_CRITICAL_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stdint.h>
+
+//#define ROCHI_DEBUG
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef uint32_t crit_state_t;  // only to be passed to crit_exit()
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief masks every interrupt (but faults and NMI)
+ * @return state to restore with crit_exit()
+ */
+crit_state_t crit_enter(void);
+
+/**
+ * @brief masks the interrupts with NVIC priority priority or less urgent (numerically greater or equal)
+ * @details never lowers the current mask. Priority 0 can not be masked by BASEPRI, so it is the same as crit_enter()
+ * @return state to restore with crit_exit()
+ */
+crit_state_t crit_enter_prio(uint8_t priority);
+
+/**
+ * @brief leaves a critical section, restoring the state before the matching crit_enter()/crit_enter_prio()
+ */
+void crit_exit(crit_state_t state);
+
+
+#endif //TP2_CRITICAL_H
@@ -0,0 +1,98 @@
+/***************************************************************************//**
+ * @file defer.c
+ * @brief Deferred work (bottom halves) for interrupt handlers
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "defer.h"
+#include "scheduler.h"
+#include "events.h"
+#include <stddef.h>
+
+#if DEFER_MAX_WORK > 32
+#error "pending work is a 32 bit mask"
+#endif
+
+/*******************************************************************************
+ * VARIABLES WITH LOCAL SCOPE
+ ******************************************************************************/
+
+static defer_work_t works[DEFER_MAX_WORK];
+static uint8_t priorities[DEFER_MAX_WORK];
+static uint8_t order[DEFER_MAX_WORK];   // ids, most urgent first
+static uint8_t works_count;
+
+static volatile uint32_t pending;       // bit id set while the work item id is waiting to run
+static volatile uint32_t coalesced[DEFER_MAX_WORK];
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static void defer_run(void);
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+uint8_t defer_add(defer_work_t work, uint8_t priority)
+{
+    static bool task_added = false;
+    if (works_count >= DEFER_MAX_WORK || work == NULL)
+        return DEFER_NO_WORK;
+    if (!task_added) {
+        sched_add_task("defer", defer_run, 0, 0, EV_DEFERRED);
+        task_added = true;
+    }
+
+    uint8_t id = works_count++;
+    works[id] = work;
+    priorities[id] = priority;
+
+    // insertion sort, ids are not posted yet
+    uint8_t pos = id;
+    while (pos > 0 && priorities[order[pos - 1]] > priority) {
+        order[pos] = order[pos - 1];
+        pos--;
+    }
+    order[pos] = id;
+    return id;
+}
+
+void defer_post(uint8_t id)
+{
+    if (id >= works_count)
+        return;
+    uint32_t bit = 1UL << id;
+    if (__atomic_fetch_or(&pending, bit, __ATOMIC_SEQ_CST) & bit)
+        coalesced[id]++;    // still pending, it will run once for both
+    else
+        sched_signal(EV_DEFERRED);
+}
+
+uint32_t defer_get_coalesced(uint8_t id)
+{
+    return id < DEFER_MAX_WORK ? coalesced[id] : 0;
+}
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+static void defer_run(void)
+{
+    // takes every item pending now, the ones posted while these run wake the task again
+    uint32_t run = __atomic_exchange_n(&pending, 0, __ATOMIC_SEQ_CST);
+    uint8_t i;
+    for (i = 0; i < works_count && run; i++) {
+        uint8_t id = order[i];
+        if (run & (1UL << id)) {
+            run &= ~(1UL << id);
+            works[id]();
+        }
+    }
+}
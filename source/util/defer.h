@@ -0,0 +1,56 @@
+/***************************************************************************//**
+ * @file defer.h
+ * @brief Deferred work (bottom halves) for interrupt handlers
+ * @details An interrupt handler posts a work item and returns at once; the work runs later in the main
+ * loop, most urgent first, as the scheduler task "defer" (priority 0, see scheduler.h). Posting is lock free:
+ * it only sets a bit, so a work item posted again before it ran runs only once.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef TP2_DEFER_H
+#define TP2_DEFER_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define DEFER_MAX_WORK  8
+#define DEFER_NO_WORK   DEFER_MAX_WORK
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef void (*defer_work_t)(void);
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief adds a work item. Call on init, not from interrupts
+ * @param work function run from the main loop each time the item was posted. Must return without blocking
+ * @param priority 0 is the most urgent. Items with the same priority run in the order they were added
+ * @return id to post the item with, DEFER_NO_WORK if there is no room (see DEFER_MAX_WORK)
+ */
+uint8_t defer_add(defer_work_t work, uint8_t priority);
+
+/**
+ * @brief marks a work item to be run by the main loop. Can be called from interrupts
+ */
+void defer_post(uint8_t id);
+
+/**
+ * @brief times a work item was posted while it was still pending, for statistics
+ */
+uint32_t defer_get_coalesced(uint8_t id);
+
+
+#endif //TP2_DEFER_H
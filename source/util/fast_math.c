@@ -0,0 +1,66 @@
+/***************************************************************************//**
+ * @file fast_math.c
+ * @brief Table interpolated trigonometric approximations
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "fast_math.h"
+
+//#define ROCHI_DEBUG
+
+#ifndef ROCHI_DEBUG
+#include "arm_math.h"
+#else
+#include <math.h>
+#define arm_sqrt_f32(in, out)   (*(out) = sqrtf(in))    // host builds, see tools/fast_math_check.c
+#endif
+
+#define FM_PI_2     1.57079632679489661923f
+#define FM_PI       3.14159265358979323846f
+
+extern const float fast_atan_table[FAST_ATAN_TABLE_SIZE + 1];
+
+/**
+ * @brief atan(t) for t in [0, 1], linear interpolation between table points
+ */
+static float atan_unit(float t)
+{
+    float pos = t * FAST_ATAN_TABLE_SIZE;
+    int i = (int)pos;
+    if (i >= FAST_ATAN_TABLE_SIZE)
+        i = FAST_ATAN_TABLE_SIZE - 1; // t == 1 interpolates at the end of the last segment
+    float frac = pos - (float)i;
+    return fast_atan_table[i] + frac * (fast_atan_table[i + 1] - fast_atan_table[i]);
+}
+
+float fast_atan2f(float y, float x)
+{
+    float ax = x < 0 ? -x : x;
+    float ay = y < 0 ? -y : y;
+    float a;
+
+    if (ax == 0 && ay == 0)
+        return 0;
+
+    // reduce to the first octant so the table argument is in [0, 1]
+    if (ay <= ax)
+        a = atan_unit(ay / ax);
+    else
+        a = FM_PI_2 - atan_unit(ax / ay);
+
+    if (x < 0)
+        a = FM_PI - a;
+    return y < 0 ? -a : a;
+}
+
+float fast_asinf(float x)
+{
+    if (x >= 1)
+        return FM_PI_2;
+    if (x <= -1)
+        return -FM_PI_2;
+
+    float c;
+    arm_sqrt_f32(1 - x * x, &c); // cos of the angle, always >= 0
+    return fast_atan2f(x, c);
+}
@@ -0,0 +1,40 @@
+/***************************************************************************//**
+ * @file fast_math.h
+ * @brief Table interpolated trigonometric approximations, good enough for whole degree angles
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef TP2_FAST_MATH_H
+#define TP2_FAST_MATH_H
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+// atan(t) is tabulated for t in [0, 1] with FAST_ATAN_TABLE_SIZE segments (FAST_ATAN_TABLE_SIZE + 1 points).
+// fast_math_table.c is generated by tools/fast_math_gen.c, regenerate it if this is changed.
+#define FAST_ATAN_TABLE_SIZE    32
+
+// Worst case absolute errors, in degrees, as reported by tools/fast_math_check.c for the checked in table
+#define FAST_ATAN2_MAX_ERR_DEG  0.0046f
+#define FAST_ASIN_MAX_ERR_DEG   0.0046f
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief approximates atan2f(y, x), worst case error FAST_ATAN2_MAX_ERR_DEG
+ * @return angle in radians, in [-pi, pi]. 0 if both x and y are 0
+ */
+float fast_atan2f(float y, float x);
+
+/**
+ * @brief approximates asinf(x), worst case error FAST_ASIN_MAX_ERR_DEG
+ * @param x sine, values out of [-1, 1] are clamped
+ * @return angle in radians, in [-pi/2, pi/2]
+ */
+float fast_asinf(float x);
+
+
+#endif //TP2_FAST_MATH_H
@@ -0,0 +1,19 @@
+/***************************************************************************//**
+ * @file fast_math_table.c
+ * @brief atan(t) for t = i/32, i = 0..32. Generated by tools/fast_math_gen.c, do not edit
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "fast_math.h"
+
+const float fast_atan_table[FAST_ATAN_TABLE_SIZE + 1] = {
+    0.000000000e+00f, 3.123983368e-02f, 6.241881102e-02f, 9.347677976e-02f,
+    1.243549958e-01f, 1.549967378e-01f, 1.853479445e-01f, 2.153577060e-01f,
+    2.449786663e-01f, 2.741674483e-01f, 3.028848767e-01f, 3.310960829e-01f,
+    3.587706685e-01f, 3.858826756e-01f, 4.124104381e-01f, 4.383365512e-01f,
+    4.636476040e-01f, 4.883339405e-01f, 5.123894811e-01f, 5.358112454e-01f,
+    5.585992932e-01f, 5.807563663e-01f, 6.022873521e-01f, 6.231993437e-01f,
+    6.435011029e-01f, 6.632030010e-01f, 6.823165417e-01f, 7.008544207e-01f,
+    7.188299894e-01f, 7.362574339e-01f, 7.531512976e-01f, 7.695264816e-01f,
+    7.853981853e-01f,
+};
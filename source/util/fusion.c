@@ -0,0 +1,212 @@
+/***************************************************************************//**
+ * @file fusion.c
+ * @brief Quaternion complementary filter for accelerometer + magnetometer orientation
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "fusion.h"
+
+//#define ROCHI_DEBUG
+
+#ifndef ROCHI_DEBUG
+#include "arm_math.h"
+#else
+#include <math.h>
+#define arm_sqrt_f32(in, out)   (*(out) = sqrtf(in))    // host builds, see tools/vector_3d_check.c
+#endif
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define FUSION_BLOCK    16  // samples turned into orientations at once, scratch is kept on the stack
+
+/*******************************************************************************
+ * VARIABLES WITH LOCAL SCOPE
+ ******************************************************************************/
+
+static quaternion_t estimate = {1, 0, 0, 0};
+static bool has_estimate = false;
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static quaternion_t q_from_rows(vector_t r0, vector_t r1, vector_t r2);
+static void blend(quaternion_t m);
+static quaternion_t q_normalize(quaternion_t q);
+static float fsqrt(float x);
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+void fusion_reset()
+{
+    has_estimate = false;
+}
+
+bool fusion_update(vector_t gravity, vector_t magnetic)
+{
+    vector_soa_t g = {&gravity.x, &gravity.y, &gravity.z};
+    vector_soa_t b = {&magnetic.x, &magnetic.y, &magnetic.z};
+    return fusion_update_n(g, b, 1) == 1;
+}
+
+uint32_t fusion_update_n(vector_soa_t gravity, vector_soa_t magnetic, uint32_t n)
+{
+    float ux[FUSION_BLOCK], uy[FUSION_BLOCK], uz[FUSION_BLOCK];
+    float wx[FUSION_BLOCK], wy[FUSION_BLOCK], wz[FUSION_BLOCK];
+    float nx[FUSION_BLOCK], ny[FUSION_BLOCK], nz[FUSION_BLOCK];
+    float w_norm[FUSION_BLOCK];
+    vector_soa_t u = {ux, uy, uz};
+    vector_soa_t w = {wx, wy, wz};
+    vector_soa_t north = {nx, ny, nz};
+    uint32_t accepted = 0;
+
+    while (n) {
+        uint32_t len = n < FUSION_BLOCK ? n : FUSION_BLOCK;
+        uint32_t i;
+
+        // up = -gravity / |gravity|
+        vb_normalize(gravity, u, len);
+        vb_scale(-1.0f, u, u, len);
+        // |up x magnetic| is the horizontal part of the magnetic field, 0 without gravity or with both parallel
+        vb_cross(u, magnetic, w, len);
+        vb_norm(w, w_norm, len);
+        // (n, u x n, u) is a proper rotation: u x n is up x magnetic normalized, and n = (u x n) x u
+        vb_normalize(w, w, len);
+        vb_cross(w, u, north, len);
+
+        for (i = 0; i < len; i++) {
+            if (!(w_norm[i] > 0))   // also false for the NaN left by a null gravity
+                continue;
+            vector_t r0 = {nx[i], ny[i], nz[i]};
+            vector_t r1 = {wx[i], wy[i], wz[i]};
+            vector_t r2 = {ux[i], uy[i], uz[i]};
+            blend(q_from_rows(r0, r1, r2));
+            accepted++;
+        }
+
+        gravity.x += len; gravity.y += len; gravity.z += len;
+        magnetic.x += len; magnetic.y += len; magnetic.z += len;
+        n -= len;
+    }
+    return accepted;
+}
+
+bool fusion_has_estimate()
+{
+    return has_estimate;
+}
+
+quaternion_t fusion_get_quaternion()
+{
+    return estimate;
+}
+
+void fusion_get_frame(vector_t * north, vector_t * east, vector_t * up)
+{
+    quaternion_t q = estimate;
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    north->x = 1 - 2 * (yy + zz);
+    north->y = 2 * (xy - wz);
+    north->z = 2 * (xz + wy);
+
+    // row 1 of the rotation is u x n = -e
+    east->x = -2 * (xy + wz);
+    east->y = -(1 - 2 * (xx + zz));
+    east->z = -2 * (yz - wx);
+
+    up->x = 2 * (xz - wy);
+    up->y = 2 * (yz + wx);
+    up->z = 1 - 2 * (xx + yy);
+}
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+/**
+ * @brief quaternion of the rotation matrix with rows r0, r1, r2 (Shepperd's method)
+ */
+static quaternion_t q_from_rows(vector_t r0, vector_t r1, vector_t r2)
+{
+    quaternion_t q;
+    float trace = r0.x + r1.y + r2.z;
+    float s;
+
+    // use the largest of w, x, y, z as pivot so s never gets close to 0
+    if (trace > 0) {
+        s = 2 * fsqrt(trace + 1);
+        q.w = 0.25f * s;
+        q.x = (r2.y - r1.z) / s;
+        q.y = (r0.z - r2.x) / s;
+        q.z = (r1.x - r0.y) / s;
+    }
+    else if (r0.x > r1.y && r0.x > r2.z) {
+        s = 2 * fsqrt(1 + r0.x - r1.y - r2.z);
+        q.w = (r2.y - r1.z) / s;
+        q.x = 0.25f * s;
+        q.y = (r0.y + r1.x) / s;
+        q.z = (r0.z + r2.x) / s;
+    }
+    else if (r1.y > r2.z) {
+        s = 2 * fsqrt(1 + r1.y - r0.x - r2.z);
+        q.w = (r0.z - r2.x) / s;
+        q.x = (r0.y + r1.x) / s;
+        q.y = 0.25f * s;
+        q.z = (r1.z + r2.y) / s;
+    }
+    else {
+        s = 2 * fsqrt(1 + r2.z - r0.x - r1.y);
+        q.w = (r1.x - r0.y) / s;
+        q.x = (r0.z + r2.x) / s;
+        q.y = (r1.z + r2.y) / s;
+        q.z = 0.25f * s;
+    }
+    return q;
+}
+
+/**
+ * @brief moves the estimate FUSION_GAIN of the way towards orientation m, or takes m if there is no estimate yet
+ */
+static void blend(quaternion_t m)
+{
+    if (!has_estimate) {
+        estimate = m;
+        has_estimate = true;
+        return;
+    }
+
+    // q and -q are the same rotation, interpolate along the short way
+    float dot = estimate.w * m.w + estimate.x * m.x + estimate.y * m.y + estimate.z * m.z;
+    float k = dot < 0 ? -FUSION_GAIN : FUSION_GAIN;
+
+    estimate.w += k * m.w - FUSION_GAIN * estimate.w;
+    estimate.x += k * m.x - FUSION_GAIN * estimate.x;
+    estimate.y += k * m.y - FUSION_GAIN * estimate.y;
+    estimate.z += k * m.z - FUSION_GAIN * estimate.z;
+    estimate = q_normalize(estimate);
+}
+
+static quaternion_t q_normalize(quaternion_t q)
+{
+    float inv = 1.0f / fsqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    quaternion_t r = {q.w * inv, q.x * inv, q.y * inv, q.z * inv};
+    return r;
+}
+
+static float fsqrt(float x)
+{
+    float root;
+    arm_sqrt_f32(x, &root);
+    return root;
+}
@@ -0,0 +1,92 @@
+/***************************************************************************//**
+ * @file fusion.h
+ * @brief Quaternion complementary filter for accelerometer + magnetometer orientation
+ * @details Each sample is turned into an orientation (TRIAD: gravity gives up, the horizontal
+ * part of the magnetic field gives north) and the filtered quaternion is moved a fixed fraction
+ * of the way towards it. Quaternions have no gimbal lock, so the filter behaves the same in
+ * every orientation, and every update takes the same time.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef TP2_FUSION_H
+#define TP2_FUSION_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stdbool.h>
+#include "vector_3d.h"
+#include "Accelerometer/accelerometer.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+// time the estimate takes to follow a step in orientation (63% of the way), s.
+// longer is smoother but slower to follow real movement
+#define FUSION_TIME_CONSTANT_S  1.0f
+// samples per second the filter is fed with. Accelerometer samples are averaged down to this rate
+#define FUSION_RATE_HZ          50
+// fraction of the way the estimate moves towards each new sample, in (0, 1]
+#define FUSION_GAIN     (1.0f / (FUSION_TIME_CONSTANT_S * FUSION_RATE_HZ))
+
+#if ACCEL_ODR_HZ % FUSION_RATE_HZ
+#error "FUSION_RATE_HZ must divide ACCEL_ODR_HZ"
+#endif
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct {
+    float w;
+    float x;
+    float y;
+    float z;
+} quaternion_t;
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief forgets the current estimate. The next sample will be taken as is
+ */
+void fusion_reset();
+
+/**
+ * @brief feeds one sample to the filter
+ * @param gravity accelerometer reading, any scale
+ * @param magnetic magnetometer reading, any scale
+ * @return false if the sample was discarded (no gravity, or magnetic field parallel to it)
+ */
+bool fusion_update(vector_t gravity, vector_t magnetic);
+
+/**
+ * @brief feeds n samples to the filter, in order, using the batch vector functions
+ * @param gravity accelerometer readings, any scale
+ * @param magnetic magnetometer readings, any scale
+ * @return amount of samples accepted, see fusion_update()
+ */
+uint32_t fusion_update_n(vector_soa_t gravity, vector_soa_t magnetic, uint32_t n);
+
+/**
+ * @brief true once at least one sample was accepted
+ */
+bool fusion_has_estimate();
+
+/**
+ * @brief current orientation estimate
+ */
+quaternion_t fusion_get_quaternion();
+
+/**
+ * @brief current estimate as the north, east and up unit vectors, in sensor coordinates
+ * @details same convention as the TRIAD frame: up = -gravity, north = horizontal part of the
+ * magnetic field, east = north x up
+ */
+void fusion_get_frame(vector_t * north, vector_t * east, vector_t * up);
+
+
+#endif //TP2_FUSION_H
@@ -5,117 +5,113 @@
 #include "msg_queue.h"
 #include <string.h>
 
-#define ROCHI_DEBUG
+void mq_init(msg_queue_t * q)
+{
+    rb_clear(q);
+}
+
+//Flush queue
+void mq_flush(msg_queue_t * q)
+{
+    rb_flush(q);
+}
 
-#ifndef ROCHI_DEBUG
-#include "hardware.h"
-#endif
 
-void mq_init(msg_queue_t * q)
+uint8_t * mq_reserve(msg_queue_t * q)
 {
-    q->len = q->in = q->out = 0;
+    mq_record_t * record = rb_reserve(q);
+
+    return record != NULL ? record->data : NULL;
 }
 
+void mq_commit(msg_queue_t * q, uint8_t len)
+{
+    mq_record_t * record = (mq_record_t *)&q->buffer[(q->in & q->mask) * sizeof(mq_record_t)];
 
-//Wait for data
-void mq_read_blocking(msg_queue_t * q, uint8_t * data)
+    record->len = len <= MQ_MSG_LEN ? len : MQ_MSG_LEN;
+    rb_commit(q);
+}
+
+
+const uint8_t * mq_peek(msg_queue_t * q, uint8_t * len)
 {
-    //Atomic operation (assembly)
-    while(q->len == 0) {;} // wait for data
+    mq_record_t * record = rb_peek(q);
 
-    strcpy(data, q->buffer[q->out++]);
-    if(q->out == Q_MAX_LENGTH) {
-        q-> out = 0;
-    }
-    //Atomic operation (assembly)
-    q->len--;
+    if (record == NULL)
+        return NULL;
+
+    if (len != NULL)
+        *len = record->len;
+    return record->data;
 }
 
-//Flush queue
-void mq_flush(msg_queue_t * q)
+void mq_release(msg_queue_t * q)
 {
-#ifndef ROCHI_DEBUG
-    hw_DisableInterrupts();
-#endif
-    //Must set these three variables to zero before continuing...
-    mq_init(q);
-
-#ifndef ROCHI_DEBUG
-    hw_EnableInterrupts();
-#endif
+    rb_release(q);
 }
 
+
 //Add data to queue
-bool mq_pushback(msg_queue_t * q, uint8_t * data)
+bool mq_pushback(msg_queue_t * q, const uint8_t * data, uint8_t len)
 {
-    bool ret_val = false;
-#ifndef ROCHI_DEBUG
-    hw_DisableInterrupts();
-#endif
-
-    data[Q_MSG_LEN]=0; // assure there is a terminator
-    strcpy(q->buffer[q->in++], data);
-    if(q->in == Q_MAX_LENGTH) {
-        q->in = 0;
-    }
-    q->len = q->len <= Q_MAX_LENGTH ? q->len+1 : Q_MAX_LENGTH;
-    ret_val = true;
-#ifndef ROCHI_DEBUG
-    hw_EnableInterrupts();
-#endif
-    return ret_val;
+    uint8_t * slot = mq_reserve(q);
+
+    if (slot == NULL)
+        return false;
+
+    len = len <= MQ_MSG_LEN ? len : MQ_MSG_LEN;
+    memcpy(slot, data, len);
+    mq_commit(q, len);
+    return true;
 }
 
 
 //Add data to queue
-bool mq_pushfront(msg_queue_t * q, uint8_t * data)
+bool mq_pushfront(msg_queue_t * q, const uint8_t * data, uint8_t len)
 {
-    bool ret_val = false;
-
-#ifndef ROCHI_DEBUG
-    hw_DisableInterrupts();
-#endif
-    if(q->out == 0) {
-        q->out = Q_MAX_LENGTH;
-    }
-    data[Q_MSG_LEN] = 0;
-    q->out--;
-    strcpy(q->buffer[q->out], data);
-    q->len++;
-    ret_val = true;
-#ifndef ROCHI_DEBUG
-
-    hw_EnableInterrupts();
-#endif
-    return ret_val;
+    uint32_t out = q->out;
+
+    if (q->in - out > q->mask)
+        return false;
+
+    out--;
+    mq_record_t * record = (mq_record_t *)&q->buffer[(out & q->mask) * sizeof(mq_record_t)];
+    record->len = len <= MQ_MSG_LEN ? len : MQ_MSG_LEN;
+    memcpy(record->data, data, record->len);
+    RB_MEMORY_BARRIER();
+    q->out = out;
+    return true;
 }
 
 
-//Get current queue length
-unsigned int mq_length(msg_queue_t * q)
+uint8_t mq_popfront(msg_queue_t * q, uint8_t * data)
 {
-    //atomic read operation (assembly)
-    return q->len;
+    uint8_t len = 0;
+    const uint8_t * msg = mq_peek(q, &len);
+
+    if (msg != NULL) {
+        memcpy(data, msg, len);
+        mq_release(q);
+    }
+    return len;
 }
 
-bool mq_isfull(msg_queue_t * q)
+//Wait for data
+uint8_t mq_read_blocking(msg_queue_t * q, uint8_t * data)
 {
-    return q->len == Q_MAX_LENGTH;
+    while(q->in == q->out) {;} // wait for data
+
+    return mq_popfront(q, data);
 }
 
 
+//Get current queue length
+unsigned int mq_length(msg_queue_t * q)
+{
+    return rb_length(q);
+}
 
-void mq_popfront(msg_queue_t * q, uint8_t * data)
+bool mq_isfull(msg_queue_t * q)
 {
-   if (q->len) {
-        q->len--;
-
-        strcpy(data, q->buffer[q->out++]);
-        if(q->out == Q_MAX_LENGTH) {
-            q->out = 0;
-        }
-        //DEBUG
-//        if(q.len == Q_MAX_LENGTH)
-//        	q.len = Q_MAX_LENGTH+1;
-    }
+    return rb_isfull(q);
 }
@@ -8,41 +8,61 @@
 //Idea based on
 //https://github.com/ITBAALUMNOS/Tetris/blob/master/Sources/event_queue.h
 
-//queue for collecting events generated by several sources
+//queue for collecting fixed size messages
+//Messages are never copied by the queue itself: producers reserve a slot, fill it in place and commit it,
+//consumers peek the oldest message and release it when done. Each message carries its own length,
+//so payloads may contain any byte (including 0).
+//Record specialization of ring_t: single producer, single consumer, sized per instance with MQ_DEFINE.
 
 #ifndef _MSG_QUEUE_H_
 #define _MSG_QUEUE_H_
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "ring_buffer.h"
 
 
 
-//Total number of elements that event queue can hold
-#define Q_MAX_LENGTH	1000
-#define Q_MSG_LEN 7 // without terminator
+#define MQ_MSG_LEN		7 // max bytes per message
 
 typedef struct {
-    uint8_t buffer[Q_MAX_LENGTH][Q_MSG_LEN+1]; //leave one byte for terminator
-    volatile uint32_t len;				//Keeps track of queue length
-    volatile uint32_t in;					//Offset for adding next data
-    volatile uint32_t out;				//Offset for reading next data
-} msg_queue_t;
+    uint8_t len;                        //amount of valid bytes in data
+    uint8_t data[MQ_MSG_LEN];
+} mq_record_t;
 
+typedef ring_t msg_queue_t;
 
+//Define a file scope queue called name, with room for length messages. length must be a power of two!
+#define MQ_DEFINE(name, length)	RING_BUFFER_DEFINE(name, mq_record_t, length)
 
+
+
+//Empty the queue. Storage must have been set by MQ_DEFINE or rb_init
 void mq_init(msg_queue_t * q);
 
-//Wait for data. Can only be used by main loop.
-void mq_read_blocking(msg_queue_t * q, uint8_t * data);
-//Flush queue. Can only be used by main loop.
+//Flush queue. Consumer only.
 void mq_flush(msg_queue_t * q);
-//Add data to queue. True if event queue was not full
-bool mq_pushback(msg_queue_t * q, uint8_t * data);
-bool mq_pushfront(msg_queue_t * q, uint8_t * data);
+
+//Get a slot to write the next message in. NULL if queue is full. Producer only.
+uint8_t * mq_reserve(msg_queue_t * q);
+//Publish the slot given by mq_reserve, with len valid bytes. Producer only.
+void mq_commit(msg_queue_t * q, uint8_t len);
+
+//Get the oldest message, without removing it. NULL if queue is empty. Consumer only.
+const uint8_t * mq_peek(msg_queue_t * q, uint8_t * len);
+//Remove the message given by mq_peek. Consumer only.
+void mq_release(msg_queue_t * q);
+
+//Copying versions of the above. Push functions return true if queue was not full.
+bool mq_pushback(msg_queue_t * q, const uint8_t * data, uint8_t len);
+//Consumer only, and only while the producer is idle! Not counted in stats
+bool mq_pushfront(msg_queue_t * q, const uint8_t * data, uint8_t len);
+//Returns the length of the message copied into data, 0 if queue was empty. data must hold MQ_MSG_LEN bytes
+uint8_t mq_popfront(msg_queue_t * q, uint8_t * data);
+//Wait for data. Can only be used by main loop.
+uint8_t mq_read_blocking(msg_queue_t * q, uint8_t * data);
 
 //Get current queue length.
-void mq_popfront(msg_queue_t * q, uint8_t * data); // will return 0 if queue empty, but also if data is 0. check length first!
 unsigned int mq_length(msg_queue_t * q);
 bool mq_isfull(msg_queue_t * q);
 
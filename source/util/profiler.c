@@ -0,0 +1,105 @@
+/***************************************************************************//**
+ * @file profiler.c
+ * @brief Opt-in execution time profiler for interrupt handlers
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "profiler.h"
+#include "irq_priorities.h"
+
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#else
+#include <time.h>
+#endif
+
+static prof_stats_t entries[PROF_N_ENTRIES];
+static uint32_t budgets[PROF_N_ENTRIES];	//cycles
+
+static const uint16_t budgets_us[PROF_N_ENTRIES] = {
+	[PROF_SYSTICK] = IRQ_BUDGET_US_SYSTICK,
+	[PROF_I2C0_IRQ ... PROF_I2C2_IRQ] = IRQ_BUDGET_US_I2C,
+	[PROF_PORTA_IRQ ... PROF_PORTE_IRQ] = IRQ_BUDGET_US_PORT,
+	[PROF_UART0_IRQ ... PROF_UART4_IRQ] = IRQ_BUDGET_US_UART,
+	[PROF_PIT0_IRQ ... PROF_PIT3_IRQ] = IRQ_BUDGET_US_PIT,
+	[PROF_DMA0_IRQ ... PROF_DMA3_IRQ] = IRQ_BUDGET_US_DMA,
+};
+
+static const char * const names[PROF_N_ENTRIES] = {
+	[PROF_SYSTICK] = "SysTick",
+	[PROF_I2C0_IRQ] = "I2C0", [PROF_I2C1_IRQ] = "I2C1", [PROF_I2C2_IRQ] = "I2C2",
+	[PROF_PORTA_IRQ] = "PORTA", [PROF_PORTB_IRQ] = "PORTB", [PROF_PORTC_IRQ] = "PORTC",
+	[PROF_PORTD_IRQ] = "PORTD", [PROF_PORTE_IRQ] = "PORTE",
+	[PROF_UART0_IRQ] = "UART0", [PROF_UART1_IRQ] = "UART1", [PROF_UART2_IRQ] = "UART2",
+	[PROF_UART3_IRQ] = "UART3", [PROF_UART4_IRQ] = "UART4",
+	[PROF_PIT0_IRQ] = "PIT0", [PROF_PIT1_IRQ] = "PIT1", [PROF_PIT2_IRQ] = "PIT2", [PROF_PIT3_IRQ] = "PIT3",
+	[PROF_DMA0_IRQ] = "DMA0", [PROF_DMA1_IRQ] = "DMA1", [PROF_DMA2_IRQ] = "DMA2", [PROF_DMA3_IRQ] = "DMA3",
+};
+
+void prof_init(void)
+{
+	static bool initialized = false;
+	if(initialized) return;
+
+#ifndef ROCHI_DEBUG
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;	//DWT needs trace enabled
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	for(int i = 0; i < PROF_N_ENTRIES; i++) {
+		entries[i].min = UINT32_MAX;
+		budgets[i] = budgets_us[i] * (prof_cycles_per_second() / 1000000U);
+	}
+
+	initialized = true;
+}
+
+uint32_t prof_cycles(void)
+{
+#ifndef ROCHI_DEBUG
+	return DWT->CYCCNT;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint32_t)t.tv_sec * 1000000000U + (uint32_t)t.tv_nsec;
+#endif
+}
+
+uint32_t prof_cycles_per_second(void)
+{
+#ifndef ROCHI_DEBUG
+	return __CORE_CLOCK__;
+#else
+	return 1000000000U;
+#endif
+}
+
+void prof_record(prof_entry_t entry, uint32_t cycles)
+{
+	if(entry >= PROF_N_ENTRIES)
+		return;
+	prof_stats_t * e = &entries[entry];
+	e->count++;
+	e->total += cycles;
+	if(cycles < e->min)
+		e->min = cycles;
+	if(cycles > e->max)
+		e->max = cycles;
+	if(cycles > budgets[entry])
+		e->over_budget++;
+}
+
+bool prof_get(prof_entry_t entry, prof_stats_t * stats)
+{
+	if(entry >= PROF_N_ENTRIES || entries[entry].count == 0)
+		return false;
+	*stats = entries[entry];
+	return true;
+}
+
+const char * prof_name(prof_entry_t entry)
+{
+	if(entry >= PROF_N_ENTRIES)
+		return "";
+	return names[entry];
+}
@@ -0,0 +1,62 @@
+/***************************************************************************//**
+ * @file profiler.h
+ * @brief Opt-in execution time profiler for interrupt handlers
+ * @details Each entry keeps count, min, max and total cycles, measured with the DWT cycle counter
+ * (clock_gettime nanoseconds on host debug builds). Handlers that let other interrupts nest inside
+ * them are charged the nested time too. Runs longer than the handler's budget (see irq_priorities.h) are
+ * counted as over budget. Read the numbers with the 'P' PC command.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef UTIL_PROFILER_H_
+#define UTIL_PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//#define ROCHI_DEBUG
+
+//Set to 1 to profile. With 0 the PROF_ macros compile to nothing
+#define PROFILER_ENABLED	0
+
+typedef enum {
+	PROF_SYSTICK,
+	PROF_I2C0_IRQ, PROF_I2C1_IRQ, PROF_I2C2_IRQ,
+	PROF_PORTA_IRQ, PROF_PORTB_IRQ, PROF_PORTC_IRQ, PROF_PORTD_IRQ, PROF_PORTE_IRQ,
+	PROF_UART0_IRQ, PROF_UART1_IRQ, PROF_UART2_IRQ, PROF_UART3_IRQ, PROF_UART4_IRQ,
+	PROF_PIT0_IRQ, PROF_PIT1_IRQ, PROF_PIT2_IRQ, PROF_PIT3_IRQ,
+	PROF_DMA0_IRQ, PROF_DMA1_IRQ, PROF_DMA2_IRQ, PROF_DMA3_IRQ,
+	PROF_N_ENTRIES
+} prof_entry_t;
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t over_budget;	//runs longer than the IRQ_BUDGET_US_ of the handler
+} prof_stats_t;
+
+#if PROFILER_ENABLED
+//Measure from PROF_START to PROF_END (same block) and charge it to entry
+#define PROF_START()		uint32_t prof_start_ = prof_cycles()
+#define PROF_END(entry)		prof_record((entry), prof_cycles() - prof_start_)
+#else
+#define PROF_START()
+#define PROF_END(entry)
+#endif
+
+//Starts the cycle counter. Safe to call twice
+void prof_init(void);
+//Current value of the cycle counter (wraps around)
+uint32_t prof_cycles(void);
+//Adds one measurement of cycles to entry
+void prof_record(prof_entry_t entry, uint32_t cycles);
+//Copies the stats of entry. false if it was never recorded
+bool prof_get(prof_entry_t entry, prof_stats_t * stats);
+//Name of entry, for reports
+const char * prof_name(prof_entry_t entry);
+//Cycles per second of prof_cycles
+uint32_t prof_cycles_per_second(void);
+
+#endif /* UTIL_PROFILER_H_ */
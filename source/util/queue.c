@@ -3,103 +3,99 @@
 //
 
 #include "queue.h"
+#include <string.h>
 
-//#define ROCHI_DEBUG
-
-#ifndef ROCHI_DEBUG
-#include "hardware.h"
-#endif
 
 
 void q_init(queue_t * q)
 {
-	q->len = q->in = q->out = 0;
+	rb_clear(q);
 }
 
 
 //Wait for data
 uint8_t q_read_blocking(queue_t * q)
 {
-	uint8_t ans;
-    //Atomic operation (assembly)
-    while(q->len == 0) {;} // wait for data
-
-    ans = q->buffer[q->out++];
-    if(q->out == Q_MAX_LENGTH) {
-        q-> out = 0;
-    }
-    //Atomic operation (assembly)
-    q->len--;
+    while(q->in == q->out) {;} // wait for data
 
-    return ans;
+    return q_popfront(q);
 }
 
 //Flush queue
 void q_flush(queue_t * q)
 {
-#ifndef ROCHI_DEBUG
-    hw_DisableInterrupts();
-#endif
-    //Must set these three variables to zero before continuing...
-    q_init(q);
-#ifndef ROCHI_DEBUG
-    hw_EnableInterrupts();
-#endif
+    rb_flush(q);
 }
 
 //Add data to queue
 bool q_pushback(queue_t * q, uint8_t data)
 {
-    bool ret_val = false;
-#ifndef ROCHI_DEBUG
-    hw_DisableInterrupts();
-#endif
-    q->buffer[q->in++] = data;
-    if(q->in == Q_MAX_LENGTH)
-        q->in = 0;
-    q->len = q->len <= Q_MAX_LENGTH? q->len+1 : Q_MAX_LENGTH;
-    ret_val = true;
-
-#ifndef ROCHI_DEBUG
-    hw_EnableInterrupts();
-#endif
-    return ret_val;
+    uint32_t in = q->in;
+
+    if(in - q->out > q->mask) {
+        rb_stats_dropped(q, 1);
+        return false;
+    }
+
+    q->buffer[in & q->mask] = data;
+    RB_MEMORY_BARRIER();         //data must be stored before the consumer can see the new counter
+    q->in = in + 1;
+    rb_stats_pushed(q, 1);
+
+    return true;
 }
 
 
 //Add data to queue
-bool q_pushfront(queue_t * q, uint8_t data)
+uint32_t q_push_n(queue_t * q, const uint8_t * data, uint32_t n)
 {
-    bool ret_val = false;
-#ifndef ROCHI_DEBUG
-    hw_DisableInterrupts();
-#endif
-    if(q->len != Q_MAX_LENGTH) {
-    	if(q->out == 0) {
-    		q->out = Q_MAX_LENGTH;
-    	}
-    	q->out--;
-        q->buffer[q->out] = data;
-        q->len++;
-        ret_val = true;
+    uint32_t in = q->in;
+    uint32_t space = q->mask + 1 - (in - q->out);
+    if (n > space) {
+        rb_stats_dropped(q, n - space);
+        n = space;
     }
-#ifndef ROCHI_DEBUG
-    hw_EnableInterrupts();
-#endif
-    return ret_val;
+
+    uint32_t start = in & q->mask;
+    uint32_t first = q->mask + 1 - start;  //contiguous room before the wrap point
+    first = n <= first ? n : first;
+
+    memcpy(&q->buffer[start], data, first);
+    memcpy(q->buffer, &data[first], n - first);
+    RB_MEMORY_BARRIER();         //data must be stored before the consumer can see the new counter
+    q->in = in + n;
+    rb_stats_pushed(q, n);
+
+    return n;
+}
+
+
+//Add data to queue
+bool q_pushfront(queue_t * q, uint8_t data)
+{
+    uint32_t out = q->out;
+
+    if(q->in - out > q->mask)
+        return false;
+
+    out--;
+    q->buffer[out & q->mask] = data;
+    RB_MEMORY_BARRIER();
+    q->out = out;
+
+    return true;
 }
 
 
 //Get current queue length
 unsigned int q_length(queue_t * q)
 {
-    //atomic read operation (assembly)
-    return q->len;
+    return rb_length(q);
 }
 
 bool q_isfull(queue_t * q)
 {
-	return q->len == Q_MAX_LENGTH;
+	return rb_isfull(q);
 }
 
 
@@ -107,18 +103,36 @@ bool q_isfull(queue_t * q)
 uint8_t q_popfront(queue_t * q)
 {
 	uint8_t data = 0;
+    uint32_t out = q->out;
 
-    if (q->len) {
-        q->len--;
-
-        data = q->buffer[q->out++];
-        if(q->out == Q_MAX_LENGTH) {
-        	q->out = 0;
-        }
-        //DEBUG
-//        if(q.len == Q_MAX_LENGTH)
-//        	q.len = Q_MAX_LENGTH+1;
+    if (q->in != out) {
+        RB_MEMORY_BARRIER();     //counter must be read before the data it protects
+        data = q->buffer[out & q->mask];
+        RB_MEMORY_BARRIER();     //data must be read before the slot is handed back to the producer
+        q->out = out + 1;
     }
 
     return data;
 }
+
+
+uint32_t q_pop_n(queue_t * q, uint8_t * data, uint32_t n)
+{
+    uint32_t out = q->out;
+    uint32_t len = q->in - out;
+    n = n <= len ? n : len;
+
+    if (n) {
+        uint32_t start = out & q->mask;
+        uint32_t first = q->mask + 1 - start;  //contiguous data before the wrap point
+        first = n <= first ? n : first;
+
+        RB_MEMORY_BARRIER();     //counter must be read before the data it protects
+        memcpy(data, &q->buffer[start], first);
+        memcpy(&data[first], q->buffer, n - first);
+        RB_MEMORY_BARRIER();     //data must be read before the slots are handed back to the producer
+        q->out = out + n;
+    }
+
+    return n;
+}
@@ -9,36 +9,41 @@
 //https://github.com/ITBAALUMNOS/Tetris/blob/master/Sources/event_queue.h
 
 //queue for collecting events generated by several sources
+//Byte specialization of ring_t: single producer, single consumer, sized per instance with QUEUE_DEFINE.
 
 #ifndef _QUEUE_H_
 #define _QUEUE_H_
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "ring_buffer.h"
 
-//Total number of elements that event queue can hold
-#define Q_MAX_LENGTH	1000
+typedef ring_t queue_t;
 
-typedef struct {
-	volatile uint8_t buffer[Q_MAX_LENGTH];
-	volatile uint32_t len;				//Keeps track of queue length
-	volatile uint32_t in;					//Offset for adding next data
-	volatile uint32_t out;				//Offset for reading next data
-} queue_t;
+//Define a file scope queue called name, with room for length bytes. length must be a power of two!
+#define QUEUE_DEFINE(name, length)	RING_BUFFER_DEFINE(name, uint8_t, length)
 
 
+//Empty the queue. Storage must have been set by QUEUE_DEFINE or rb_init
 void q_init(queue_t * q);
 
 //Wait for data. Can only be used by main loop.
 uint8_t q_read_blocking(queue_t * q);
 //Flush queue. Can only be used by main loop.
 void q_flush(queue_t * q);
-//Add data to queue. True if event queue was not full
+//Add data to queue. True if event queue was not full (data is dropped otherwise). Producer only.
 bool q_pushback(queue_t * q, uint8_t data);
+//Put data back in front of the queue. Consumer only, and only while the producer is idle! Not counted in stats
 bool q_pushfront(queue_t * q, uint8_t data);
 
-//Get current queue length.
+//Add up to n bytes from data, in at most two copies. Returns amount of bytes actually added. Producer only.
+uint32_t q_push_n(queue_t * q, const uint8_t * data, uint32_t n);
+
+//Consumer only.
 uint8_t q_popfront(queue_t * q); // will return 0 if queue empty, but also if data is 0. check length first!
+//Remove up to n bytes into data, in at most two copies. Returns amount of bytes actually removed. Consumer only.
+uint32_t q_pop_n(queue_t * q, uint8_t * data, uint32_t n);
+//Get current queue length.
 unsigned int q_length(queue_t * q);
 bool q_isfull(queue_t * q);
 
@@ -0,0 +1,85 @@
+/***************************************************************************//**
+ * @file raw_math.c
+ * @brief Integer math on raw int16 sensor samples, using the Cortex-M4 SIMD instructions
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "raw_math.h"
+
+//#define ROCHI_DEBUG
+
+#if RAW_MATH_USE_SIMD
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#else
+#include "arm_math.h"   // CMSIS C versions of the intrinsics, see tools/raw_math_check.c
+#endif
+
+#define smlad   __SMLAD
+#endif
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define PACK(lo, hi)    ((uint32_t)(uint16_t)(lo) | ((uint32_t)(uint16_t)(hi) << 16))
+#define LO(w)           ((int16_t)((w) & 0xFFFF))
+#define HI(w)           ((int16_t)((w) >> 16))
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+#if !RAW_MATH_USE_SIMD
+// C version of the instruction, see the ARMv7-M reference manual for its exact behavior
+static uint32_t smlad(uint32_t a, uint32_t b, uint32_t acc);
+#endif
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+uint32_t rm_norm2(accel_raw_data_t v)
+{
+    uint32_t xy = PACK(v.x, v.y);
+    uint32_t z = PACK(v.z, 0);
+    // the sum may wrap as a signed value (sets Q), but it always fits as unsigned
+    return smlad(xy, xy, smlad(z, z, 0));
+}
+
+accel_raw_data_t rm_average(const accel_raw_data_t * samples, uint32_t n)
+{
+    accel_raw_data_t r = {0, 0, 0};
+    if (n == 0)
+        return r;
+
+    int64_t sx = 0, sy = 0, sz = 0;
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        sx += samples[i].x;
+        sy += samples[i].y;
+        sz += samples[i].z;
+    }
+
+    int64_t half = n / 2;
+    r.x = (int16_t)((sx + (sx < 0 ? -half : half)) / (int64_t)n);
+    r.y = (int16_t)((sy + (sy < 0 ? -half : half)) / (int64_t)n);
+    r.z = (int16_t)((sz + (sz < 0 ? -half : half)) / (int64_t)n);
+    return r;
+}
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+#if !RAW_MATH_USE_SIMD
+static uint32_t smlad(uint32_t a, uint32_t b, uint32_t acc)
+{
+    // modulo 2^32, like the instruction
+    return acc + (uint32_t)((int32_t)LO(a) * LO(b)) + (uint32_t)((int32_t)HI(a) * HI(b));
+}
+#endif
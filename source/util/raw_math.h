@@ -0,0 +1,49 @@
+/***************************************************************************//**
+ * @file raw_math.h
+ * @brief Integer math on raw int16 sensor samples, using the Cortex-M4 SIMD instructions
+ * @details x and y are packed in one 32 bit word so each dual 16 bit instruction handles both.
+ * Builds without the DSP extension (host) use a C version of each instruction, which gives the
+ * same results bit by bit.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef TP2_RAW_MATH_H
+#define TP2_RAW_MATH_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stdint.h>
+#include "Accelerometer/accelerometer.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+// 1: SIMD instructions, through the CMSIS intrinsics. 0: C versions. tools/raw_math_check.c builds both
+#ifndef RAW_MATH_USE_SIMD
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define RAW_MATH_USE_SIMD   1
+#else
+#define RAW_MATH_USE_SIMD   0
+#endif
+#endif
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief squared norm, x*x + y*y + z*z. Never overflows, max is 3 * 2^30
+ */
+uint32_t rm_norm2(accel_raw_data_t v);
+
+/**
+ * @brief component wise average of n samples, rounded to nearest (ties away from zero)
+ * @return all zeros if n is 0
+ */
+accel_raw_data_t rm_average(const accel_raw_data_t * samples, uint32_t n);
+
+
+#endif //TP2_RAW_MATH_H
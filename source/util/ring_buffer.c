@@ -0,0 +1,157 @@
+/*
+ * ring_buffer.c
+ *
+ *  Created on: Oct 17, 2019
+ *      Author: Grupo 1 Labo de Micros
+ */
+
+#include "ring_buffer.h"
+#include "critical.h"
+#include <string.h>
+
+typedef struct {
+	ring_t * rb;
+	const char * name;
+} rb_registry_entry_t;
+
+static rb_registry_entry_t registry[RB_MAX_REGISTERED];
+static unsigned int registered = 0;
+
+
+void rb_init(ring_t * rb, void * storage, uint32_t elem_size, uint32_t capacity)
+{
+	rb->buffer = (uint8_t *)storage;
+	rb->elem_size = elem_size;
+	rb->mask = capacity - 1;
+	rb_clear(rb);
+#if RB_STATS_ENABLED
+	memset(&rb->stats, 0, sizeof(rb->stats));
+#endif
+}
+
+void rb_clear(ring_t * rb)
+{
+	crit_state_t crit = crit_enter();		//producer and consumer counters change together
+	rb->in = rb->out = 0;
+	crit_exit(crit);
+}
+
+void rb_flush(ring_t * rb)
+{
+	//only the consumer's counter is touched, so the producer may keep pushing meanwhile
+	rb->out = rb->in;
+}
+
+
+void * rb_reserve(ring_t * rb)
+{
+	uint32_t in = rb->in;
+
+	if (in - rb->out > rb->mask) {
+		rb_stats_dropped(rb, 1);
+		return NULL;
+	}
+
+	return &rb->buffer[(in & rb->mask) * rb->elem_size];
+}
+
+void rb_commit(ring_t * rb)
+{
+	RB_MEMORY_BARRIER();		//element must be stored before the consumer can see the new counter
+	rb->in = rb->in + 1;
+	rb_stats_pushed(rb, 1);
+}
+
+
+void * rb_peek(ring_t * rb)
+{
+	uint32_t out = rb->out;
+
+	if (rb->in == out)
+		return NULL;
+
+	RB_MEMORY_BARRIER();		//counter must be read before the element it protects
+	return &rb->buffer[(out & rb->mask) * rb->elem_size];
+}
+
+void rb_release(ring_t * rb)
+{
+	uint32_t out = rb->out;
+
+	if (rb->in != out) {
+		RB_MEMORY_BARRIER();	//element must be read before the slot is handed back to the producer
+		rb->out = out + 1;
+	}
+}
+
+
+uint32_t rb_length(ring_t * rb)
+{
+	//both counters are read atomically, and unsigned difference handles wrap around
+	return rb->in - rb->out;
+}
+
+uint32_t rb_capacity(ring_t * rb)
+{
+	return rb->mask + 1;
+}
+
+bool rb_isfull(ring_t * rb)
+{
+	return rb_length(rb) > rb->mask;
+}
+
+
+void rb_register(ring_t * rb, const char * name)
+{
+	if (registered < RB_MAX_REGISTERED) {
+		registry[registered].rb = rb;
+		registry[registered].name = name;
+		registered++;
+	}
+}
+
+unsigned int rb_registered_count(void)
+{
+	return registered;
+}
+
+bool rb_snapshot(unsigned int index, rb_snapshot_t * snapshot)
+{
+	if (index >= registered)
+		return false;
+
+	ring_t * rb = registry[index].rb;
+	snapshot->name = registry[index].name;
+	snapshot->capacity = rb_capacity(rb);
+	snapshot->length = rb_length(rb);
+#if RB_STATS_ENABLED
+	snapshot->stats = rb->stats;
+#else
+	memset(&snapshot->stats, 0, sizeof(snapshot->stats));
+#endif
+	return true;
+}
+
+
+#if RB_STATS_ENABLED
+void rb_stats_pushed(ring_t * rb, uint32_t n)
+{
+	uint32_t len = rb_length(rb);
+
+	if (n == 0)
+		return;
+	if (len == 0)
+		len = 1;		//consumer already took the new elements, count them as the only ones
+
+	rb->stats.pushes += n;
+	if (len > rb->stats.high_water)
+		rb->stats.high_water = len;
+	rb->stats.histogram[((len - 1) * RB_HISTOGRAM_BINS) / (rb->mask + 1)]++;
+}
+
+void rb_stats_dropped(ring_t * rb, uint32_t n)
+{
+	rb->stats.drops += n;
+}
+#endif
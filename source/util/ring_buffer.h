@@ -0,0 +1,117 @@
+/*
+ * ring_buffer.h
+ *
+ *  Created on: Oct 17, 2019
+ *      Author: Grupo 1 Labo de Micros
+ */
+
+//Generic ring buffer for fixed size elements, shared by queue_t, msg_queue_t and the CAN buffers.
+//Element type and capacity are chosen per instance at compile time (see RING_BUFFER_DEFINE),
+//so each buffer only takes the RAM it actually needs.
+//Single producer, single consumer: in and out are free-running counters, each one written only by
+//its owner, so one ISR and the main loop may share a ring without masking interrupts.
+
+#ifndef UTIL_RING_BUFFER_H_
+#define UTIL_RING_BUFFER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+//#define ROCHI_DEBUG
+
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#define RB_MEMORY_BARRIER()	__DMB()
+#else
+#define RB_MEMORY_BARRIER()	__atomic_thread_fence(__ATOMIC_ACQ_REL)	//enough for one producer and one consumer, no mfence on x86
+#endif
+
+//Health statistics for every ring. Set to 0 to remove them (and their cost) from the build
+#define RB_STATS_ENABLED	1
+#define RB_HISTOGRAM_BINS	8		//occupancy histogram bins, each one capacity/RB_HISTOGRAM_BINS wide
+#define RB_MAX_REGISTERED	12		//max amount of rings that can be registered for snapshots
+
+//Updated by the producer only, so they need no locking
+typedef struct {
+	uint32_t high_water;				//max length ever reached
+	uint32_t pushes;					//elements added
+	uint32_t drops;						//elements rejected because the ring was full
+	uint32_t histogram[RB_HISTOGRAM_BINS];	//length after each push. Bin i: length in (i*capacity/BINS, (i+1)*capacity/BINS]
+} rb_stats_t;
+
+typedef struct {
+	uint8_t * buffer;					//storage for capacity elements
+	uint32_t elem_size;					//size in bytes of each element
+	uint32_t mask;						//capacity - 1. Capacity must be a power of two
+	volatile uint32_t in;				//Counter for adding next element. Written by producer only
+	volatile uint32_t out;				//Counter for reading next element. Written by consumer only
+#if RB_STATS_ENABLED
+	rb_stats_t stats;
+#endif
+} ring_t;
+
+//Copy of the state of a registered ring, see rb_snapshot()
+typedef struct {
+	const char * name;
+	uint32_t capacity;
+	uint32_t length;
+	rb_stats_t stats;
+} rb_snapshot_t;
+
+#if RB_STATS_ENABLED
+#define RB_STATS_INITIALIZER	, {0}
+#else
+#define RB_STATS_INITIALIZER
+#endif
+
+//Static initializer for a ring using storage, an array of capacity elements of type elem_t
+#define RING_BUFFER_INITIALIZER(storage, elem_t, capacity)	\
+	{ (uint8_t *)(storage), sizeof(elem_t), (capacity) - 1, 0, 0 RB_STATS_INITIALIZER }
+
+//Define a file scope ring called name, with room for capacity elements of type elem_t
+#define RING_BUFFER_DEFINE(name, elem_t, capacity)										\
+	typedef char name##_capacity_must_be_power_of_two[((capacity) > 0 && ((capacity) & ((capacity) - 1)) == 0) ? 1 : -1]; \
+	static elem_t name##_storage[(capacity)];											\
+	static ring_t name = RING_BUFFER_INITIALIZER(name##_storage, elem_t, capacity)
+
+//Initialize a ring at run time. capacity must be a power of two
+void rb_init(ring_t * rb, void * storage, uint32_t elem_size, uint32_t capacity);
+//Empty ring, resetting both counters. Masks interrupts meanwhile, so an ISR producer or consumer may be active.
+void rb_clear(ring_t * rb);
+//Flush ring. Consumer only.
+void rb_flush(ring_t * rb);
+
+//Get a slot to write the next element in. NULL if ring is full. Producer only.
+void * rb_reserve(ring_t * rb);
+//Publish the slot given by rb_reserve. Producer only.
+void rb_commit(ring_t * rb);
+
+//Get the oldest element, without removing it. NULL if ring is empty. Consumer only.
+void * rb_peek(ring_t * rb);
+//Remove the element given by rb_peek. Consumer only.
+void rb_release(ring_t * rb);
+
+//Register ring with a name, so it is included in snapshots. Has no effect when the registry is full
+void rb_register(ring_t * rb, const char * name);
+//Amount of registered rings
+unsigned int rb_registered_count(void);
+//Copy the state of the registered ring number index. False if there is no such ring.
+//Counters are copied one by one while the producer may keep running, they are not a single atomic picture
+bool rb_snapshot(unsigned int index, rb_snapshot_t * snapshot);
+
+#if RB_STATS_ENABLED
+//Account for n elements added/rejected by a producer that does not use rb_reserve and rb_commit
+void rb_stats_pushed(ring_t * rb, uint32_t n);
+void rb_stats_dropped(ring_t * rb, uint32_t n);
+#else
+#define rb_stats_pushed(rb, n)
+#define rb_stats_dropped(rb, n)
+#endif
+
+//Get current ring length.
+uint32_t rb_length(ring_t * rb);
+uint32_t rb_capacity(ring_t * rb);
+bool rb_isfull(ring_t * rb);
+
+#endif /* UTIL_RING_BUFFER_H_ */
@@ -0,0 +1,272 @@
+/***************************************************************************//**
+ * @file scheduler.c
+ * @brief Cooperative, run to completion task scheduler for the main loop
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include "scheduler.h"
+#include "clock.h"
+#include "critical.h"
+#include <stddef.h>
+
+//#define ROCHI_DEBUG
+
+#ifndef ROCHI_DEBUG
+#include "hardware.h"
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct {
+    sched_task_t task;
+    uint32_t period_us;
+    sched_events_t wake_on;
+    deadline_t next;            // next periodic run, or the time set by sched_wake_at()
+    bool timed;                 // next is valid: always for periodic tasks
+    sched_task_stats_t stats;
+} task_data_t;
+
+/*******************************************************************************
+ * VARIABLES WITH LOCAL SCOPE
+ ******************************************************************************/
+
+static task_data_t tasks[SCHED_MAX_TASKS];
+static uint8_t tasks_count;
+
+static volatile sched_events_t pending;
+static volatile uint32_t event_time[SCHED_MAX_EVENTS];  // low 32 bits of the time each pending event was signaled
+static volatile uint32_t event_count[SCHED_MAX_EVENTS];
+static uint32_t event_max_latency[SCHED_MAX_EVENTS];
+static uint64_t idle_us;
+
+#ifdef ROCHI_DEBUG
+// host builds: there is no WFI, sched_idle() waits on this condition and sched_signal() wakes it up.
+// clock_host_get_us() must run at real speed for timed tasks to wake up on time
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static bool any_ready(clock_us_t now);
+#ifdef ROCHI_DEBUG
+static bool next_timed(clock_us_t * when);
+#endif
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+uint8_t sched_add_task(const char * name, sched_task_t task, uint32_t period_us, uint8_t priority, sched_events_t wake_on)
+{
+    if (tasks_count >= SCHED_MAX_TASKS || task == NULL)
+        return SCHED_NO_TASK;
+
+    clock_init();
+
+    task_data_t * t = &tasks[tasks_count];
+    t->task = task;
+    t->period_us = period_us;
+    t->wake_on = wake_on;
+    deadline_start(&t->next, period_us);
+    t->timed = period_us != 0;
+    t->stats = (sched_task_stats_t){0};
+    t->stats.name = name;
+    t->stats.priority = priority;
+    return tasks_count++;
+}
+
+void sched_wake_at(uint8_t index, clock_us_t when)
+{
+    if (index >= tasks_count || tasks[index].period_us != 0)
+        return;
+    tasks[index].next.expires = when;
+    tasks[index].timed = true;
+}
+
+void sched_signal(sched_events_t events)
+{
+    uint32_t now = (uint32_t)clock_get_us();
+
+    // masked: an interrupt signaling in the middle would lose a count, or see the event pending before its time
+    // is written and leave the time of the previous signal
+    crit_state_t crit = crit_enter();
+    sched_events_t counted = events;
+    while (counted) {
+        event_count[__builtin_ctz(counted)]++;
+        counted &= counted - 1;
+    }
+
+    sched_events_t new_events = events & ~pending; // only the first signal counts for latency
+    while (new_events) {
+        event_time[__builtin_ctz(new_events)] = now;
+        new_events &= new_events - 1;
+    }
+    __atomic_fetch_or(&pending, events, __ATOMIC_SEQ_CST);
+    crit_exit(crit);
+
+#ifdef ROCHI_DEBUG
+    // under the mutex, so it cannot come between the check and the wait in sched_idle()
+    pthread_mutex_lock(&idle_mutex);
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&idle_mutex);
+#endif
+}
+
+bool sched_run_once()
+{
+    clock_us_t now = clock_get_us();
+    sched_events_t events = pending;
+
+    uint8_t i, best = SCHED_NO_TASK;
+    for (i = 0; i < tasks_count; i++) {
+        task_data_t * t = &tasks[i];
+        bool ready = (events & t->wake_on) || (t->timed && now >= t->next.expires);
+        if (ready && (best == SCHED_NO_TASK || t->stats.priority < tasks[best].stats.priority))
+            best = i;
+    }
+    if (best == SCHED_NO_TASK)
+        return false;
+
+    task_data_t * t = &tasks[best];
+    uint32_t latency = 0;
+
+    sched_events_t woken_by = t->wake_on & __atomic_fetch_and(&pending, ~t->wake_on, __ATOMIC_SEQ_CST);
+    while (woken_by) {
+        uint8_t ev = __builtin_ctz(woken_by);
+        int32_t ev_latency = (int32_t)((uint32_t)now - event_time[ev]);
+        if (ev_latency < 0) // signaled by an interrupt after now was read
+            ev_latency = 0;
+        if ((uint32_t)ev_latency > event_max_latency[ev])
+            event_max_latency[ev] = ev_latency;
+        if ((uint32_t)ev_latency > latency)
+            latency = ev_latency;
+        woken_by &= woken_by - 1;
+    }
+
+    if (t->timed && now >= t->next.expires) {
+        clock_us_t late = now - t->next.expires;
+        if (late > latency)
+            latency = (uint32_t)late;
+        if (t->period_us == 0) {
+            t->timed = false;   // once, the task may set a new time while it runs
+        }
+        else {
+            if (late >= t->period_us)
+                t->stats.overruns++;
+            deadline_periodic(&t->next, t->period_us);
+        }
+    }
+
+    clock_us_t start = clock_get_us();
+    t->task();
+    uint32_t run = (uint32_t)(clock_get_us() - start);
+
+    t->stats.runs++;
+    t->stats.total_run_us += run;
+    if (run > t->stats.max_run_us)
+        t->stats.max_run_us = run;
+    if (latency > t->stats.max_latency_us)
+        t->stats.max_latency_us = latency;
+    return true;
+}
+
+void sched_idle()
+{
+#ifndef ROCHI_DEBUG
+    crit_state_t state = crit_enter(); // PRIMASK, WFI still wakes up on masked interrupts
+    clock_us_t start = clock_get_us();
+    if (!any_ready(start)) {
+        __WFI(); // wakes up on any pending interrupt, even masked
+        idle_us += clock_get_us() - start;
+    }
+    crit_exit(state); // the interrupt that woke the core runs now
+#else
+    pthread_mutex_lock(&idle_mutex);
+    clock_us_t start = clock_get_us();
+    clock_us_t wake = 0;
+    if (!any_ready(start)) {
+        if (next_timed(&wake)) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            uint64_t ns = until.tv_nsec + (wake - start) * 1000U;
+            until.tv_sec += ns / 1000000000U;
+            until.tv_nsec = ns % 1000000000U;
+            pthread_cond_timedwait(&idle_cond, &idle_mutex, &until);
+        }
+        else {
+            pthread_cond_wait(&idle_cond, &idle_mutex);
+        }
+        idle_us += clock_get_us() - start;
+    }
+    pthread_mutex_unlock(&idle_mutex);
+#endif
+}
+
+uint64_t sched_get_idle_us()
+{
+    return idle_us;
+}
+
+uint32_t sched_get_event_latency(uint8_t event, uint32_t * count)
+{
+    if (event >= SCHED_MAX_EVENTS)
+        return 0;
+    if (count != NULL)
+        *count = event_count[event];
+    return event_max_latency[event];
+}
+
+uint8_t sched_task_count()
+{
+    return tasks_count;
+}
+
+bool sched_get_stats(uint8_t index, sched_task_stats_t * stats)
+{
+    if (index >= tasks_count)
+        return false;
+    *stats = tasks[index].stats;
+    return true;
+}
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+static bool any_ready(clock_us_t now)
+{
+    uint8_t i;
+    for (i = 0; i < tasks_count; i++) {
+        if ((pending & tasks[i].wake_on) || (tasks[i].timed && now >= tasks[i].next.expires))
+            return true;
+    }
+    return false;
+}
+
+#ifdef ROCHI_DEBUG
+// earliest periodic run or sched_wake_at() time, false if there is none
+static bool next_timed(clock_us_t * when)
+{
+    bool found = false;
+    uint8_t i;
+    for (i = 0; i < tasks_count; i++) {
+        if (tasks[i].timed && (!found || tasks[i].next.expires < *when)) {
+            *when = tasks[i].next.expires;
+            found = true;
+        }
+    }
+    return found;
+}
+#endif
@@ -0,0 +1,113 @@
+/***************************************************************************//**
+ * @file scheduler.h
+ * @brief Cooperative, run to completion task scheduler for the main loop
+ * @details Each task has a priority, an optional period and a mask of events (see events.h) it wakes up on.
+ * Every call to sched_run_once() runs the most urgent task that is ready, so a high priority task never
+ * waits for more than one (whole) lower priority task, and tasks with nothing to do are not called at all.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#ifndef TP2_SCHEDULER_H
+#define TP2_SCHEDULER_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define SCHED_MAX_TASKS     8
+#define SCHED_NO_TASK       SCHED_MAX_TASKS
+#define SCHED_MAX_EVENTS    32  // bits in sched_events_t
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef void (*sched_task_t)(void);
+typedef uint32_t sched_events_t;
+
+typedef struct {
+    const char * name;
+    uint8_t priority;
+    uint32_t runs;
+    uint32_t overruns;          // times a periodic task started a whole period or more late
+    uint32_t max_run_us;        // longest run
+    uint32_t max_latency_us;    // longest time between becoming ready and starting to run
+    uint64_t total_run_us;
+} sched_task_stats_t;
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief adds a task to the scheduler
+ * @param name for statistics
+ * @param task function to be called each time the task is ready. Must return without blocking
+ * @param period_us the task is ready every period_us, 0 if it only runs on events
+ * @param priority 0 is the most urgent. Tasks with the same priority run in the order they were added
+ * @param wake_on events (see events.h) that make the task ready. They are cleared before it runs
+ * @return task index, SCHED_NO_TASK if there is no room (see SCHED_MAX_TASKS)
+ */
+uint8_t sched_add_task(const char * name, sched_task_t task, uint32_t period_us, uint8_t priority, sched_events_t wake_on);
+
+/**
+ * @brief makes a task that has no period ready once, at the given time. Call from the main loop
+ * @details replaces the previous wake up time of the task, if it did not run yet. Lets a task sleep
+ * until its next deadline instead of polling with a short period
+ * @param index as returned by sched_add_task()
+ * @param when time as given by clock_get_us()
+ */
+void sched_wake_at(uint8_t index, clock_us_t when);
+
+/**
+ * @brief signals events, waking up the tasks that wait for them. Can be called from interrupts
+ */
+void sched_signal(sched_events_t events);
+
+/**
+ * @brief runs the most urgent ready task, if any
+ * @return true if a task was run
+ */
+bool sched_run_once();
+
+/**
+ * @brief sleeps the core until an interrupt, unless a task is ready. Call when sched_run_once() returns false
+ * @details interrupts are masked while checking, so an event signaled right before sleeping is not missed:
+ * the pending interrupt wakes the core at once
+ */
+void sched_idle();
+
+/**
+ * @brief microseconds spent in sched_idle() since the first task was added
+ */
+uint64_t sched_get_idle_us();
+
+/**
+ * @brief worst time between an event being signaled and a task woken by it starting to run
+ * @param event index of the event bit
+ * @param count if not NULL, gets the amount of times the event was signaled
+ * @return latency in us
+ */
+uint32_t sched_get_event_latency(uint8_t event, uint32_t * count);
+
+/**
+ * @brief amount of tasks added
+ */
+uint8_t sched_task_count();
+
+/**
+ * @brief gets the statistics of a task
+ * @return false if there is no task with that index
+ */
+bool sched_get_stats(uint8_t index, sched_task_stats_t * stats);
+
+
+#endif //TP2_SCHEDULER_H
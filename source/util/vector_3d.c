@@ -5,6 +5,16 @@
 #include "vector_3d.h"
 #include <math.h>
 
+//#define ROCHI_DEBUG
+
+#if VECTOR_3D_USE_CMSIS_DSP || (V3D_SINGLE_PRECISION && !defined(ROCHI_DEBUG))
+#include "arm_math.h"
+#elif V3D_SINGLE_PRECISION
+#define arm_sqrt_f32(in, out)   (*(out) = sqrtf(in))    // host builds, see tools/vector_3d_check.c
+#endif
+
+#define VB_BLOCK    32  // scratch size for batch functions that need temporaries
+
 vector_t v_add(vector_t v, vector_t w) {
     vector_t u = {v.x+w.x, v.y + w.y, v.z + w.z};
     return u;
@@ -31,12 +41,22 @@ vector_t v_invert(vector_t v)
 
 float v_norm (vector_t v)
 {
+#if V3D_SINGLE_PRECISION
+    float norm;
+    arm_sqrt_f32(v_dot_product(v, v), &norm);
+    return norm;
+#else
     return sqrt(v_dot_product(v, v));
+#endif
 }
 
 vector_t v_normalize(vector_t v)
 {
+#if V3D_SINGLE_PRECISION
+    vector_t u = v_scalar_product(1.0f/v_norm(v), v);
+#else
     vector_t u = v_scalar_product(1.0/v_norm(v), v);
+#endif
     return u;
 }
 
@@ -97,9 +117,127 @@ float iv_dot_product(ivector_t a, ivector_t b)
     return a.x*b.x+a.y*b.y+a.z*b.z;
 }
 
-ivector_t iv_crossProduct(ivector_t a, ivector_t b)
+ivector_t iv_cross_product(ivector_t a, ivector_t b)
 {
     ivector_t c = {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
     return c;
 }
 
+
+
+void vb_add(vector_soa_t a, vector_soa_t b, vector_soa_t out, uint32_t n)
+{
+#if VECTOR_3D_USE_CMSIS_DSP
+    arm_add_f32(a.x, b.x, out.x, n);
+    arm_add_f32(a.y, b.y, out.y, n);
+    arm_add_f32(a.z, b.z, out.z, n);
+#else
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        out.x[i] = a.x[i] + b.x[i];
+        out.y[i] = a.y[i] + b.y[i];
+        out.z[i] = a.z[i] + b.z[i];
+    }
+#endif
+}
+
+void vb_scale(float alpha, vector_soa_t a, vector_soa_t out, uint32_t n)
+{
+#if VECTOR_3D_USE_CMSIS_DSP
+    arm_scale_f32(a.x, alpha, out.x, n);
+    arm_scale_f32(a.y, alpha, out.y, n);
+    arm_scale_f32(a.z, alpha, out.z, n);
+#else
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        out.x[i] = alpha * a.x[i];
+        out.y[i] = alpha * a.y[i];
+        out.z[i] = alpha * a.z[i];
+    }
+#endif
+}
+
+void vb_dot(vector_soa_t a, vector_soa_t b, float * out, uint32_t n)
+{
+#if VECTOR_3D_USE_CMSIS_DSP
+    float tmp[VB_BLOCK];
+    while (n) {
+        uint32_t len = n < VB_BLOCK ? n : VB_BLOCK;
+        arm_mult_f32(a.x, b.x, out, len);
+        arm_mult_f32(a.y, b.y, tmp, len);
+        arm_add_f32(out, tmp, out, len);
+        arm_mult_f32(a.z, b.z, tmp, len);
+        arm_add_f32(out, tmp, out, len);
+        a.x += len; a.y += len; a.z += len;
+        b.x += len; b.y += len; b.z += len;
+        out += len;
+        n -= len;
+    }
+#else
+    uint32_t i;
+    for (i = 0; i < n; i++)
+        out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i];
+#endif
+}
+
+void vb_norm(vector_soa_t a, float * out, uint32_t n)
+{
+    vb_dot(a, a, out, n);
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+#if V3D_SINGLE_PRECISION || VECTOR_3D_USE_CMSIS_DSP
+        arm_sqrt_f32(out[i], &out[i]);
+#else
+        out[i] = sqrtf(out[i]);
+#endif
+    }
+}
+
+void vb_normalize(vector_soa_t a, vector_soa_t out, uint32_t n)
+{
+    float norm[VB_BLOCK];
+    while (n) {
+        uint32_t len = n < VB_BLOCK ? n : VB_BLOCK;
+        uint32_t i;
+        vb_norm(a, norm, len);
+        for (i = 0; i < len; i++) {
+            float inv = 1.0f / norm[i];
+            out.x[i] = a.x[i] * inv;
+            out.y[i] = a.y[i] * inv;
+            out.z[i] = a.z[i] * inv;
+        }
+        a.x += len; a.y += len; a.z += len;
+        out.x += len; out.y += len; out.z += len;
+        n -= len;
+    }
+}
+
+void vb_cross(vector_soa_t a, vector_soa_t b, vector_soa_t out, uint32_t n)
+{
+#if VECTOR_3D_USE_CMSIS_DSP
+    float tmp[VB_BLOCK];
+    while (n) {
+        uint32_t len = n < VB_BLOCK ? n : VB_BLOCK;
+        arm_mult_f32(a.y, b.z, out.x, len);
+        arm_mult_f32(a.z, b.y, tmp, len);
+        arm_sub_f32(out.x, tmp, out.x, len);
+        arm_mult_f32(a.z, b.x, out.y, len);
+        arm_mult_f32(a.x, b.z, tmp, len);
+        arm_sub_f32(out.y, tmp, out.y, len);
+        arm_mult_f32(a.x, b.y, out.z, len);
+        arm_mult_f32(a.y, b.x, tmp, len);
+        arm_sub_f32(out.z, tmp, out.z, len);
+        a.x += len; a.y += len; a.z += len;
+        b.x += len; b.y += len; b.z += len;
+        out.x += len; out.y += len; out.z += len;
+        n -= len;
+    }
+#else
+    uint32_t i;
+    for (i = 0; i < n; i++) {
+        out.x[i] = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+        out.y[i] = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+        out.z[i] = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+    }
+#endif
+}
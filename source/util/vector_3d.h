@@ -7,6 +7,16 @@
 
 #include <stdint.h>
 
+// 1: orientation math is done strictly in single precision, using the FPU and CMSIS arm_sqrt_f32
+// 0: double precision libm, which the Cortex-M4F emulates in software
+#define V3D_SINGLE_PRECISION 1
+
+// 1: batch functions use the CMSIS-DSP arm_*_f32 kernels, needs libarm_cortexM4lf_math to be linked
+// 0: plain C loops, which the compiler can vectorize. tools/vector_3d_check.c builds both
+#ifndef VECTOR_3D_USE_CMSIS_DSP
+#define VECTOR_3D_USE_CMSIS_DSP 0
+#endif
+
 typedef struct {
     float x;
     float y;
@@ -19,6 +29,13 @@ typedef struct {
     int32_t z;
 } ivector_t;
 
+// n vectors stored as struct of arrays: vector i is (x[i], y[i], z[i])
+typedef struct {
+    float * x;
+    float * y;
+    float * z;
+} vector_soa_t;
+
 vector_t v_add(vector_t v, vector_t w);
 vector_t v_substract(vector_t v, vector_t w);
 vector_t v_invert(vector_t v);
@@ -37,6 +54,14 @@ float iv_norm (ivector_t v);
 vector_t iv_normalize(ivector_t v);
 ivector_t iv_cross_product(ivector_t a, ivector_t b);
 
+// batch versions over n vectors. out may be one of the inputs, except for vb_cross
+void vb_add(vector_soa_t a, vector_soa_t b, vector_soa_t out, uint32_t n);
+void vb_scale(float alpha, vector_soa_t a, vector_soa_t out, uint32_t n);
+void vb_dot(vector_soa_t a, vector_soa_t b, float * out, uint32_t n);
+void vb_norm(vector_soa_t a, float * out, uint32_t n);
+void vb_normalize(vector_soa_t a, vector_soa_t out, uint32_t n);
+void vb_cross(vector_soa_t a, vector_soa_t b, vector_soa_t out, uint32_t n);
+
 
 
 
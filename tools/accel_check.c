@@ -0,0 +1,389 @@
+/***************************************************************************//**
+ * @file accel_check.c
+ * @brief Host test: the shipped accelerometer driver (accelerometer.c) against a model of the FXOS8700 registers,
+ *        FIFO and INT2 pin on a simulated I2C bus and clock.
+ *
+ * Build and run from the repository root, once per rate and mode:
+ *     for cfg in "200" "400" "800" "200 -DACCEL_USE_FIFO=0" "400 -DACCEL_USE_FIFO=0"; do
+ *         gcc -O2 -pthread -DROCHI_DEBUG -DACCEL_ODR_HZ=$cfg -I source -I source/util tools/accel_check.c \
+ *             source/Accelerometer/accelerometer.c source/util/ring_buffer.c source/util/defer.c \
+ *             source/util/scheduler.c source/util/clock.c source/util/critical.c -o accel_check && ./accel_check
+ *     done
+ *     ./accel_check 3 && ./accel_check 10     # the sensor does not answer the first 3 or 10 WHOAMI reads
+ * The model answers the driver's I2C transactions one at a time, each taking BYTE_US per byte on the bus (65 kHz
+ * SCL, 9 clocks per byte), and decodes the rate from CTRL_REG1 and M_CTRL_REG1 as the sensor does. Each sample
+ * carries its sequence number in x and y. INT2 is low while the FIFO holds the watermark (FIFO mode) or while
+ * there is a sample not read yet (one read per sample), and the driver's level interrupt runs while it is low and
+ * enabled. The main loop runs the scheduler, which runs the driver's deferred parsing and a task that takes every
+ * sample on EV_ACCEL_SAMPLE, as the sensors task does.
+ * With an argument N, the sensor NACKs the first N WHOAMI reads. The driver must ask again from the main loop,
+ * not from the I2C interrupt, waiting longer each time, and report ACCEL_NOT_FOUND after ACCEL_WHOAMI_TRIES.
+ * Fails (exit code 1) if a sample is taken twice or missed, if the FIFO overflows, if the rate the sensor was set
+ * to is not ACCEL_ODR_HZ, if a register is written while the sensor is active, or if the FIFO build at 200 Hz
+ * needs more than a tenth of the I2C transactions of the old 533 Hz polling. Also if the WHOAMI retries come
+ * sooner than 10 ms after the previous one, or twice as long as it, or from the I2C interrupt.
+ * Reports the transactions and bytes per second and how far the sample times are from when the samples were taken.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Accelerometer/accelerometer.h"
+#include "I2C/i2c_master_int.h"
+#include "Interrupts/interrupts.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "events.h"
+
+#define STEP_US         10
+#define RUN_US          3000000U    // from when the sensor is made active
+#define ABSENT_RUN_US   10000000U   // when the sensor never answers
+#define FIRST_RETRY_US  10000
+#define BYTE_US         138
+#define FIFO_SIZE       32
+#define OLD_POLL_HZ     533     // reads per second of the SysTick polling it replaced
+#define MAX_SAMPLES     8192
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+// registers
+#define R_STATUS        0x00
+#define R_OUT_X_MSB     0x01
+#define R_F_SETUP       0x09
+#define R_WHOAMI        0x0D
+#define R_CTRL_REG1     0x2A
+#define R_CTRL_REG4     0x2D
+#define R_CTRL_REG5     0x2E
+#define R_M_OUT_X_MSB   0x33
+#define R_M_CTRL_REG1   0x5B
+#define R_M_CTRL_REG2   0x5C
+
+static clock_us_t now_us;
+static unsigned int failures;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+clock_us_t clock_host_get_us(void)
+{
+    return now_us;
+}
+
+/*******************************************************************************
+ * FXOS8700 MODEL
+ ******************************************************************************/
+
+static uint8_t regs[128];
+static clock_us_t next_sample_us, active_since;
+static uint32_t produced;                   // samples taken by the sensor
+static clock_us_t sample_time[MAX_SAMPLES];
+static uint32_t fifo[FIFO_SIZE];            // sequence numbers, oldest first
+static unsigned int fifo_count;
+static bool fifo_overflow;
+static uint32_t latest;                     // one read per sample: the sample in the output registers
+static bool data_ready, data_overwritten;
+static unsigned long overflows_seen, overwrites_seen, empty_reads, writes_while_active;
+
+static bool active(void) { return regs[R_CTRL_REG1] & 0x01; }
+static bool fifo_on(void) { return regs[R_F_SETUP] >> 6 != 0; }
+static unsigned int watermark(void) { return regs[R_F_SETUP] & 0x3F; }
+
+// the sample period set by CTRL_REG1 DR and the mode in M_CTRL_REG1
+static clock_us_t sample_period_us(void)
+{
+    static const clock_us_t accel_only[8] = {1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000};
+    bool hybrid = (regs[R_M_CTRL_REG1] & 0x03) == 0x03;
+    clock_us_t period = accel_only[(regs[R_CTRL_REG1] >> 3) & 0x07];
+    return hybrid ? 2 * period : period;
+}
+
+static void take_sample(void)
+{
+    uint32_t seq = produced++;
+    if (seq < MAX_SAMPLES)
+        sample_time[seq] = now_us;
+    if (fifo_on()) {
+        if (fifo_count == FIFO_SIZE) {      // circular mode: the oldest is overwritten
+            memmove(fifo, fifo + 1, (FIFO_SIZE - 1) * sizeof(fifo[0]));
+            fifo_count--;
+            fifo_overflow = true;
+            overflows_seen++;
+        }
+        fifo[fifo_count++] = seq;
+    }
+    else {
+        if (data_ready) {
+            data_overwritten = true;
+            overwrites_seen++;
+        }
+        latest = seq;
+        data_ready = true;
+    }
+}
+
+static void sensor_step(void)
+{
+    if (!active())
+        return;
+    while (now_us >= next_sample_us) {
+        take_sample();
+        next_sample_us += sample_period_us();
+    }
+}
+
+// INT2 is active low
+static bool int2_low(void)
+{
+    uint8_t enabled = regs[R_CTRL_REG4], to_int1 = regs[R_CTRL_REG5];
+    bool fifo_int = (enabled & 0x40) && !(to_int1 & 0x40) && fifo_on() && fifo_count >= watermark();
+    bool drdy_int = (enabled & 0x01) && !(to_int1 & 0x01) && !fifo_on() && data_ready;
+    return active() && (fifo_int || drdy_int);
+}
+
+// 14 bit samples, left justified, msb first. x and y carry the sequence number
+static void put_sample(uint8_t * out, uint32_t seq)
+{
+    int16_t v[3] = {(int16_t)(seq & 0x1FFF), (int16_t)((seq >> 13) & 0x1FFF), 1024};
+    for (int i = 0; i < 3; i++) {
+        out[2 * i] = (uint8_t)((uint16_t)(v[i] << 2) >> 8);
+        out[2 * i + 1] = (uint8_t)(v[i] << 2);
+    }
+}
+
+static void reg_write(uint8_t reg, uint8_t value)
+{
+    if (active() && reg != R_CTRL_REG1)
+        writes_while_active++;      // ignored by the sensor
+    else
+        regs[reg] = value;
+    if (reg == R_CTRL_REG1 && (value & 0x01) && !active_since) {
+        active_since = now_us;
+        next_sample_us = now_us + sample_period_us();
+    }
+}
+
+static void reg_read(uint8_t reg, uint8_t * out, int len)
+{
+    int i = 0;
+    if (reg == R_WHOAMI) {
+        out[i++] = 0xC7;
+    }
+    else if (reg == R_M_OUT_X_MSB) {
+        static const uint8_t mag[6] = {0x01, 0x2C, 0xFF, 0x38, 0xFE, 0x70};
+        for (; i < len && i < 6; i++)
+            out[i] = mag[i];
+    }
+    else if (fifo_on() && reg == R_STATUS && len == 1) {
+        out[i++] = (uint8_t)((fifo_overflow ? 0x80 : 0) | (fifo_count >= watermark() ? 0x40 : 0) | fifo_count);
+        fifo_overflow = false;
+    }
+    else if (fifo_on() && reg == R_OUT_X_MSB) {
+        for (; i + 6 <= len; i += 6) {      // no hybrid auto increment: wraps from OUT_Z_LSB to OUT_X_MSB
+            if (fifo_count == 0) {
+                empty_reads++;
+                memset(out + i, 0, 6);
+                continue;
+            }
+            put_sample(out + i, fifo[0]);
+            memmove(fifo, fifo + 1, (FIFO_SIZE - 1) * sizeof(fifo[0]));
+            fifo_count--;
+        }
+    }
+    else if (!fifo_on() && reg == R_STATUS) {
+        out[i++] = (uint8_t)((data_overwritten ? 0x80 : 0) | (data_ready ? 0x08 : 0));
+        if (len >= 7) {
+            if (!data_ready)
+                empty_reads++;
+            put_sample(out + 1, latest);
+            data_ready = data_overwritten = false;
+            i = 7;
+        }
+        if (len >= 13 && (regs[R_M_CTRL_REG2] & 0x20)) {   // hybrid auto increment goes on to the magnetometer
+            reg_read(R_M_OUT_X_MSB, out + 7, 6);
+            i = 13;
+        }
+    }
+    for (; i < len; i++)
+        out[i] = 0;
+}
+
+/*******************************************************************************
+ * I2C AND GPIO STUBS
+ ******************************************************************************/
+
+static i2c_transaction_t * i2c_queue[I2C_INT_QUEUE_LENGTH];
+static unsigned int i2c_queued;
+static clock_us_t i2c_done_at;              // end of the transaction at the head of the queue
+static unsigned long i2c_transactions, i2c_bytes;
+
+static pinIrqFun_t int2_handler;
+static bool int2_enabled;
+
+static unsigned int whoami_nacks;           // WHOAMI reads the sensor does not answer
+static unsigned int whoami_asked, whoami_from_irq, whoami_wrong_wait;
+static clock_us_t whoami_last_us, whoami_last_wait;
+static bool in_i2c_irq;
+
+void i2c_master_int_init(i2c_module_id_int_t mod_id) { (void)mod_id; }
+bool i2c_master_int_bus_busy(i2c_module_id_int_t mod_id) { (void)mod_id; return i2c_queued != 0; }
+void interrupts_init() {}
+void gpioMode(pin_t pin, uint8_t mode) { (void)pin; (void)mode; }
+
+static clock_us_t transaction_us(const i2c_transaction_t * t)
+{
+    unsigned int bytes = 1 + t->write_len + (t->read_len ? 1 + t->read_len : 0);
+    return bytes * BYTE_US;
+}
+
+bool i2c_master_int_submit(i2c_module_id_int_t mod_id, i2c_transaction_t * transaction)
+{
+    (void)mod_id;
+    if (i2c_queued == I2C_INT_QUEUE_LENGTH)
+        return false;
+    transaction->status = I2C_TR_QUEUED;
+    if (transaction->write_data[0] == R_WHOAMI && transaction->read_len) {
+        if (in_i2c_irq)
+            whoami_from_irq++;
+        // a wait within the first FIRST_RETRY_US and doubling: 10, 20, 40 ms...
+        clock_us_t wait = now_us - whoami_last_us;
+        if (whoami_asked && (wait < FIRST_RETRY_US || (whoami_last_wait && wait > 2 * whoami_last_wait + 1000)))
+            whoami_wrong_wait++;
+        printf("  WHOAMI %u at %.3f s\n", whoami_asked + 1, now_us / 1e6);
+        whoami_last_wait = whoami_asked ? wait : 0;
+        whoami_last_us = now_us;
+        whoami_asked++;
+    }
+    i2c_queue[i2c_queued++] = transaction;
+    if (i2c_queued == 1)
+        i2c_done_at = now_us + transaction_us(transaction);
+    return true;
+}
+
+void gpioIRQ(pin_t pin, uint8_t irqMode, pinIrqFun_t irqFun)
+{
+    (void)pin;
+    int2_enabled = irqMode == GPIO_IRQ_MODE_LOGIC_0;
+    int2_handler = irqFun;
+}
+
+// the stop interrupt of the transaction at the head: the sensor answers, the next one starts
+static void i2c_step(void)
+{
+    while (i2c_queued && now_us >= i2c_done_at) {
+        i2c_transaction_t * t = i2c_queue[0];
+        memmove(i2c_queue, i2c_queue + 1, (--i2c_queued) * sizeof(i2c_queue[0]));
+        if (i2c_queued)
+            i2c_done_at = now_us + transaction_us(i2c_queue[0]);
+        i2c_transactions++;
+        i2c_bytes += transaction_us(t) / BYTE_US;
+
+        if (t->write_data[0] == R_WHOAMI && whoami_asked <= whoami_nacks) {
+            t->status = I2C_TR_NACK;        // not there: nothing is read
+        }
+        else {
+            if (t->write_len >= 2)
+                reg_write(t->write_data[0], t->write_data[1]);
+            if (t->read_len)
+                reg_read(t->write_data[0], t->read_data, t->read_len);
+            t->status = I2C_TR_DONE;
+        }
+        in_i2c_irq = true;
+        if (t->callback != NULL)
+            t->callback(t);
+        in_i2c_irq = false;
+    }
+}
+
+/*******************************************************************************
+ * CONSUMER
+ ******************************************************************************/
+
+static uint32_t taken, duplicates, missed;
+static int64_t expected_seq;
+static clock_us_t worst_time_error;
+
+static void take_samples(void)
+{
+    accel_sample_t s;
+    while (accel_pop_sample(&s)) {
+        int64_t seq = (s.acc.x & 0x1FFF) | (int64_t)(s.acc.y & 0x1FFF) << 13;
+        if (seq < expected_seq)
+            duplicates++;
+        else if (seq > expected_seq)
+            missed += (uint32_t)(seq - expected_seq);
+        expected_seq = seq + 1;
+        taken++;
+        if (seq < MAX_SAMPLES) {
+            clock_us_t error = s.time_us > sample_time[seq] ? s.time_us - sample_time[seq]
+                                                           : sample_time[seq] - s.time_us;
+            if (error > worst_time_error)
+                worst_time_error = error;
+        }
+    }
+}
+
+/*******************************************************************************
+ * RUN
+ ******************************************************************************/
+
+int main(int argc, char ** argv)
+{
+    whoami_nacks = argc > 1 ? (unsigned int)atoi(argv[1]) : 0;
+    bool found = whoami_nacks < ACCEL_WHOAMI_TRIES;
+    accel_init();
+    sched_add_task("consumer", take_samples, 0, 1, EV_ACCEL_SAMPLE);
+
+    while (now_us < (active_since ? active_since + RUN_US : ABSENT_RUN_US)) {
+        now_us += STEP_US;
+        sensor_step();
+        i2c_step();
+        if (int2_enabled && int2_low() && int2_handler != NULL)
+            int2_handler();
+        while (sched_run_once())
+            ;
+    }
+
+    printf("%u WHOAMI reads, %u not answered, status %d\n", whoami_asked, whoami_nacks, accel_get_status());
+    CHECK(whoami_from_irq == 0 && whoami_wrong_wait == 0);
+    if (!found) {
+        CHECK(accel_get_status() == ACCEL_NOT_FOUND);
+        CHECK(whoami_asked == ACCEL_WHOAMI_TRIES);
+        CHECK(!active_since && taken == 0);
+        printf("accel_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+        return failures != 0;
+    }
+    CHECK(accel_get_status() == ACCEL_RUNNING);
+    CHECK(whoami_asked == whoami_nacks + 1);
+
+    double active_s = RUN_US / 1e6;
+    unsigned int left = fifo_on() ? fifo_count : data_ready;    // not read yet, less than a watermark
+    printf("ODR %u Hz, %s: %u samples taken of %u, %u left in the sensor, %u duplicated, %u missed\n",
+           ACCEL_ODR_HZ, ACCEL_USE_FIFO ? "FIFO" : "one read per sample", taken, produced, left, duplicates,
+           missed);
+    printf("  %.1f I2C transactions/s (driver count %.1f/s), %.0f bytes/s, the old polling made %u/s\n",
+           i2c_transactions / active_s, accel_get_transaction_count() / active_s, i2c_bytes / active_s,
+           OLD_POLL_HZ);
+    printf("  sample times off by up to %u us\n", (unsigned int)worst_time_error);
+
+    CHECK(sample_period_us() == 1000000U / ACCEL_ODR_HZ);
+    CHECK(produced >= (uint32_t)(active_s * ACCEL_ODR_HZ) - 1);
+    CHECK(duplicates == 0 && missed == 0);
+    CHECK(taken + left == produced);
+    CHECK(left < (ACCEL_USE_FIFO ? ACCEL_FIFO_WATERMARK : 1) + 1);
+    CHECK(overflows_seen == 0 && overwrites_seen == 0 && empty_reads == 0);
+    CHECK(accel_get_overflow_count() == 0);
+    CHECK(writes_while_active == 0);
+    if (ACCEL_USE_FIFO && ACCEL_ODR_HZ == 200)
+        CHECK(i2c_transactions / active_s <= OLD_POLL_HZ / 10.0);
+
+    printf("accel_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
@@ -0,0 +1,295 @@
+/***************************************************************************//**
+ * @file board_sim_check.c
+ * @brief Host test: the shipped board_app and board_manager modules, with the pc interface, run by the scheduler
+ *        on a simulated clock, fed by a simulated accelerometer and by frames from another board.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -pthread -DROCHI_DEBUG -I source -I source/util -I source/util/Timer tools/board_sim_check.c \
+ *         source/board_app.c source/board_manager/board_can_network.c source/board_manager/board_database.c \
+ *         source/board_manager/board_ev_sources.c source/board_manager/board_observers.c \
+ *         source/pc_interface/pc_interface.c source/util/msg_queue.c source/util/ring_buffer.c source/util/queue.c \
+ *         source/util/defer.c source/util/scheduler.c source/util/clock.c source/util/critical.c \
+ *         source/util/Timer/timers.c source/util/fusion.c source/util/vector_3d.c source/util/fast_math.c \
+ *         source/util/fast_math_table.c source/util/raw_math.c \
+ *         -lm -o board_sim_check
+ *     ./board_sim_check
+ * The simulated clock moves in 100 us steps. On each step the "interrupts" due run first: the accelerometer
+ * model adds a sample every 1/ACCEL_ODR_HZ and signals EV_ACCEL_SAMPLE every ACCEL_FIFO_WATERMARK samples, as
+ * its INT2 reads do. Then the main loop runs every task that is ready, as App_Run does. What the host builds of
+ * pc_interface.c and board_can_network.c print is kept with the time it was printed.
+ * The board is tilted to pitch -20 roll 30, then to pitch 10 roll -45. Board 3 sends its three angles over CAN
+ * every 500 ms from 2 s to 6 s, then stops.
+ * Fails (exit code 1) if the last angles sent to the PC for this board are not within ANGLE_TOLERANCE of the ones
+ * worked out from a single sample (get_angles()), if board 3's angles are not sent to the PC or its timeout is not
+ * sent ANGLE_TIMEOUT_MS after its last frame, if the PC or CAN messages come faster than their max rates, or if a
+ * burst of samples is missed. Reports how often each task ran.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "board_app.h"
+#include "board_manager/board_database.h"
+#include "board_manager/board_can_network.h"
+#include "pc_interface/pc_interface.h"
+#include "Accelerometer/accelerometer.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "events.h"
+
+#define STEP_US             100
+#define SAMPLE_US           (1000000U / ACCEL_ODR_HZ)
+#define FIRST_TILT_US       0
+#define SECOND_TILT_US      10000000U
+#define END_US              20000000U
+#define SETTLE_US           5000000U    // the filter gets to the new angles within this
+#define OTHER_BOARD         3
+#define OTHER_FROM_US       2000000U
+#define OTHER_TO_US         6000000U
+#define OTHER_EVERY_US      500000U
+#define ANGLE_TOLERANCE     2           // degrees
+#define COUNTS_PER_G        2048
+#define SAMPLE_RING         64
+#define MAX_LINES           4096
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+void get_angles(int32_t * angles);
+void can_callback(uint8_t msg_id, uint8_t * can_data);
+
+typedef struct {
+    clock_us_t time;
+    char text[16];
+} line_t;
+
+static clock_us_t now_us;
+static unsigned int failures;
+
+// what the modules printed
+static FILE * out;
+static char * out_buffer;
+static size_t out_size, out_parsed;
+static line_t pc_lines[MAX_LINES], can_lines[MAX_LINES];
+static unsigned int pc_count, can_count;
+
+// the accelerometer model
+static accel_sample_t ring[SAMPLE_RING];
+static unsigned int ring_in, ring_out;
+static accel_raw_data_t acc_now, magnet;
+static uint32_t samples, bursts, lost;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        fprintf(stderr, "FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+clock_us_t clock_host_get_us(void)
+{
+    return now_us;
+}
+
+/*******************************************************************************
+ * ACCELEROMETER MODEL
+ ******************************************************************************/
+
+void accel_init() {}
+
+accel_raw_data_t accel_get_last_data(accel_data_options_t data_option)
+{
+    return data_option == ACCEL_MAGNET_DATA ? magnet : acc_now;
+}
+
+uint32_t accel_get_sample_count() { return samples; }
+uint32_t accel_get_transaction_count() { return bursts; }
+uint32_t accel_get_overflow_count() { return lost; }
+accel_status_t accel_get_status() { return ACCEL_RUNNING; }
+
+bool accel_pop_sample(accel_sample_t * sample)
+{
+    if (ring_out == ring_in)
+        return false;
+    *sample = ring[ring_out++ % SAMPLE_RING];
+    return true;
+}
+
+// up is the z axis tilted by pitch about x, then by roll about y, as frame_to_angles() reads it
+static void tilt(double pitch_deg, double roll_deg)
+{
+    double p = pitch_deg * M_PI / 180, r = roll_deg * M_PI / 180;
+    acc_now = (accel_raw_data_t){(int16_t)lround(-sin(r) * cos(p) * COUNTS_PER_G),
+                                 (int16_t)lround(sin(p) * COUNTS_PER_G),
+                                 (int16_t)lround(cos(r) * cos(p) * COUNTS_PER_G)};
+}
+
+static void accel_interrupt(void)
+{
+    if (ring_in - ring_out == SAMPLE_RING)
+        lost++;
+    else
+        ring[ring_in++ % SAMPLE_RING] = (accel_sample_t){acc_now, now_us};
+    if (++samples % ACCEL_FIFO_WATERMARK == 0) {
+        bursts++;
+        sched_signal(EV_ACCEL_SAMPLE);
+    }
+}
+
+/*******************************************************************************
+ * OUTPUT
+ ******************************************************************************/
+
+static void keep_line(line_t * lines, unsigned int * count, const char * text, size_t len)
+{
+    if (*count == MAX_LINES)
+        return;
+    line_t * l = &lines[(*count)++];
+    l->time = now_us;
+    len = len < sizeof(l->text) - 1 ? len : sizeof(l->text) - 1;
+    memcpy(l->text, text, len);
+    l->text[len] = 0;
+}
+
+// "PC: D1R+030 \n" and "CAN: 1R+030 \n"
+static void parse_output(void)
+{
+    fflush(out);
+    while (out_parsed < out_size) {
+        char * line = out_buffer + out_parsed;
+        char * end = memchr(line, '\n', out_size - out_parsed);
+        if (end == NULL)
+            break;
+        size_t len = (size_t)(end - line);
+        if (len > 0 && line[len - 1] == ' ')
+            len--;
+        if (strncmp(line, "PC: ", 4) == 0)
+            keep_line(pc_lines, &pc_count, line + 4, len - 4);
+        else if (strncmp(line, "CAN: ", 5) == 0)
+            keep_line(can_lines, &can_count, line + 5, len - 5);
+        out_parsed = (size_t)(end - out_buffer) + 1;
+    }
+}
+
+// last value of an angle sent to the PC for a board, up to a time. false if there was none
+static bool last_pc_angle(uint8_t board, char type, clock_us_t until, int * angle)
+{
+    bool found = false;
+    for (unsigned int i = 0; i < pc_count && pc_lines[i].time <= until; i++) {
+        const char * t = pc_lines[i].text;
+        if (t[0] == 'D' && t[1] == '0' + board && t[2] == type) {
+            *angle = atoi(t + 3);
+            found = true;
+        }
+    }
+    return found;
+}
+
+static bool min_spacing(const line_t * lines, unsigned int count, clock_us_t spacing)
+{
+    for (unsigned int i = 1; i < count; i++)
+        if (lines[i].time - lines[i - 1].time < spacing)
+            return false;
+    return true;
+}
+
+/*******************************************************************************
+ * RUN
+ ******************************************************************************/
+
+static void check_own_angles(clock_us_t until)
+{
+    int32_t expected[N_ANGLE_TYPES];
+    get_angles(expected);
+    int pitch = 1000, roll = 1000;
+    CHECK(last_pc_angle(BA_MY_ID, PITCH_CHAR, until, &pitch));
+    CHECK(last_pc_angle(BA_MY_ID, ROLL_CHAR, until, &roll));
+    printf("at %.1f s: pitch %d roll %d sent to the PC, %d %d from a single sample\n", until / 1e6, pitch, roll,
+           expected[PITCH], expected[ROLL]);
+    CHECK(abs(pitch - expected[PITCH]) <= ANGLE_TOLERANCE);
+    CHECK(abs(roll - expected[ROLL]) <= ANGLE_TOLERANCE);
+}
+
+int main(void)
+{
+    out = open_memstream(&out_buffer, &out_size);
+    FILE * console = stdout;
+    stdout = out;   // the host builds of the modules print their messages
+
+    magnet = (accel_raw_data_t){300, -200, -400};
+    tilt(-20, 30);
+    ba_init();
+
+    clock_us_t next_sample = SAMPLE_US, next_other = OTHER_FROM_US, last_other = 0;
+    unsigned long runs = 0;
+    bool second_tilt = false;
+    while (now_us < END_US) {
+        now_us += STEP_US;
+        if (now_us >= next_sample) {
+            accel_interrupt();
+            next_sample += SAMPLE_US;
+        }
+        if (now_us >= SECOND_TILT_US && !second_tilt) {
+            stdout = console;
+            check_own_angles(SECOND_TILT_US);
+            stdout = out;
+            tilt(10, -45);
+            second_tilt = true;
+        }
+        if (now_us >= next_other && now_us <= OTHER_TO_US) {
+            // as bn_periodic hands the frames over on target
+            can_callback(OTHER_BOARD, (uint8_t *)"C-5");
+            can_callback(OTHER_BOARD, (uint8_t *)"R+12");
+            can_callback(OTHER_BOARD, (uint8_t *)"O+90");
+            last_other = now_us;
+            next_other += OTHER_EVERY_US;
+        }
+        while (sched_run_once())
+            runs++;
+        parse_output();
+    }
+    stdout = console;
+
+    check_own_angles(END_US);
+    CHECK(SECOND_TILT_US + SETTLE_US < END_US);
+
+    int other_pitch = 0, other_roll = 0;
+    CHECK(last_pc_angle(OTHER_BOARD, PITCH_CHAR, END_US, &other_pitch) && other_pitch == -5);
+    CHECK(last_pc_angle(OTHER_BOARD, ROLL_CHAR, END_US, &other_roll) && other_roll == 12);
+    clock_us_t timeout_at = 0;
+    for (unsigned int i = 0; i < pc_count; i++)
+        if (pc_lines[i].text[0] == 'T' && pc_lines[i].text[1] == '0' + OTHER_BOARD)
+            timeout_at = pc_lines[i].time;
+    printf("board %d: last frame at %.2f s, timeout sent to the PC at %.2f s\n", OTHER_BOARD, last_other / 1e6,
+           timeout_at / 1e6);
+    CHECK(timeout_at >= last_other + CLOCK_MS_TO_US(ANGLE_TIMEOUT_MS));
+    CHECK(timeout_at <= last_other + CLOCK_MS_TO_US(ANGLE_TIMEOUT_MS) + 500000U);
+
+    printf("%u PC messages, %u CAN messages, %u bursts of %u samples\n", pc_count, can_count, bursts,
+           ACCEL_FIFO_WATERMARK);
+    CHECK(pc_count > 0 && can_count > 0);
+    CHECK(min_spacing(pc_lines, pc_count, CLOCK_HZ_TO_US(PC_MAX_FREQ)));
+    CHECK(min_spacing(can_lines, can_count, CLOCK_HZ_TO_US(CAN_MAX_FREQ)));
+    CHECK(lost == 0 && ring_in == ring_out);
+
+    uint32_t accel_events;
+    sched_get_event_latency(__builtin_ctz(EV_ACCEL_SAMPLE), &accel_events);
+    CHECK(accel_events == bursts);
+
+    printf("%lu task runs in %u s of simulated time:\n", runs, END_US / 1000000U);
+    for (uint8_t i = 0; i < sched_task_count(); i++) {
+        sched_task_stats_t stats;
+        sched_get_stats(i, &stats);
+        printf("  %-8s p%u %6u runs (%.1f/s), %u overruns, worst latency %u us\n", stats.name, stats.priority,
+               stats.runs, stats.runs * 1e6 / END_US, stats.overruns, stats.max_latency_us);
+        CHECK(stats.overruns == 0);
+    }
+
+    printf("board_sim_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
@@ -0,0 +1,114 @@
+/***************************************************************************//**
+ * @file fast_math_check.c
+ * @brief Host test: sweeps the shipped fast_atan2f/fast_asinf (fast_math.c and the checked in table)
+ *        against libm, and reports their worst case error and time per call.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -DROCHI_DEBUG -I source/util tools/fast_math_check.c source/util/fast_math.c \
+ *         source/util/fast_math_table.c -lm -o fast_math_check
+ *     ./fast_math_check
+ * Fails (exit code 1) if an error is over FAST_*_MAX_ERR_DEG in fast_math.h.
+ * Times are host ns and, on x86, TSC cycles per call: only good to compare with libm, not for the K64.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include "fast_math.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()        __rdtsc()
+#else
+#define CYCLES()        0ULL
+#endif
+
+#define SWEEP_STEPS     2000000
+#define RAD2DEG(x)      ((x)*180.0/M_PI)
+
+#define TIME_STEPS      65536   // inputs precomputed, so only the calls are timed
+#define TIME_REPEAT     64
+
+typedef float (*fn2_t)(float, float);
+typedef float (*fn1_t)(float);
+
+static float xs[TIME_STEPS], ys[TIME_STEPS], ss[TIME_STEPS];
+static volatile float sink;     // keeps the timed calls from being optimized away
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char * name, double ns, unsigned long long cycles)
+{
+    double calls = (double)TIME_STEPS * TIME_REPEAT;
+    printf("%-12s %6.1f ns/call %7.1f cycles/call\n", name, ns / calls, cycles / calls);
+}
+
+static void time_atan2(const char * name, fn2_t f)
+{
+    float acc = 0;
+    double t0 = now_ns();
+    unsigned long long c0 = CYCLES();
+    for (int r = 0; r < TIME_REPEAT; r++)
+        for (int i = 0; i < TIME_STEPS; i++)
+            acc += f(ys[i], xs[i]);
+    unsigned long long c1 = CYCLES();
+    double t1 = now_ns();
+    sink = acc;
+    report(name, t1 - t0, c1 - c0);
+}
+
+static void time_asin(const char * name, fn1_t f)
+{
+    float acc = 0;
+    double t0 = now_ns();
+    unsigned long long c0 = CYCLES();
+    for (int r = 0; r < TIME_REPEAT; r++)
+        for (int i = 0; i < TIME_STEPS; i++)
+            acc += f(ss[i]);
+    unsigned long long c1 = CYCLES();
+    double t1 = now_ns();
+    sink = acc;
+    report(name, t1 - t0, c1 - c0);
+}
+
+int main(void)
+{
+    // every direction on the unit circle for atan2, every sine in [-1, 1] for asin
+    double max_atan2 = 0, max_asin = 0;
+    for (int i = 0; i <= SWEEP_STEPS; i++) {
+        double ang = -M_PI + 2 * M_PI * i / SWEEP_STEPS;
+        float x = (float)cos(ang), y = (float)sin(ang);
+        double err = fabs(fast_atan2f(y, x) - atan2((double)y, (double)x));
+        if (err > M_PI)
+            err = 2 * M_PI - err; // +pi and -pi are the same direction
+        if (err > max_atan2)
+            max_atan2 = err;
+
+        float s = (float)(-1.0 + 2.0 * i / SWEEP_STEPS);
+        err = fabs(fast_asinf(s) - asin((double)s));
+        if (err > max_asin)
+            max_asin = err;
+    }
+    printf("table size %d: max error atan2 %.5f deg (limit %.4f), asin %.5f deg (limit %.4f)\n",
+           FAST_ATAN_TABLE_SIZE, RAD2DEG(max_atan2), FAST_ATAN2_MAX_ERR_DEG,
+           RAD2DEG(max_asin), FAST_ASIN_MAX_ERR_DEG);
+
+    for (int i = 0; i < TIME_STEPS; i++) {
+        double ang = -M_PI + 2 * M_PI * i / TIME_STEPS;
+        xs[i] = (float)cos(ang);
+        ys[i] = (float)sin(ang);
+        ss[i] = (float)(-1.0 + 2.0 * i / TIME_STEPS);
+    }
+    time_atan2("fast_atan2f", fast_atan2f);
+    time_atan2("atan2f", atan2f);
+    time_asin("fast_asinf", fast_asinf);
+    time_asin("asinf", asinf);
+
+    return RAD2DEG(max_atan2) > FAST_ATAN2_MAX_ERR_DEG || RAD2DEG(max_asin) > FAST_ASIN_MAX_ERR_DEG;
+}
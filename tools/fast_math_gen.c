@@ -0,0 +1,34 @@
+/***************************************************************************//**
+ * @file fast_math_gen.c
+ * @brief Host tool: generates source/util/fast_math_table.c
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -I source/util tools/fast_math_gen.c -lm -o fast_math_gen
+ *     ./fast_math_gen > source/util/fast_math_table.c
+ * Then run tools/fast_math_check.c and copy the max errors to FAST_*_MAX_ERR_DEG in fast_math.h
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include "fast_math.h"
+
+#define N               FAST_ATAN_TABLE_SIZE
+
+int main(void)
+{
+    int i;
+
+    printf("/***************************************************************************//**\n");
+    printf(" * @file fast_math_table.c\n");
+    printf(" * @brief atan(t) for t = i/%d, i = 0..%d. Generated by tools/fast_math_gen.c, do not edit\n", N, N);
+    printf(" * @author Grupo 1 Laboratorio de Microprocesadores\n");
+    printf("******************************************************************************/\n\n");
+    printf("#include \"fast_math.h\"\n\n");
+    printf("const float fast_atan_table[FAST_ATAN_TABLE_SIZE + 1] = {\n");
+    for (i = 0; i <= N; i++)
+        printf("%s%.9ef,%s", i % 4 == 0 ? "    " : "", (float)atan((double)i / N),
+               (i % 4 == 3 || i == N) ? "\n" : " ");
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,719 @@
+/***************************************************************************//**
+ * @file i2c_check.c
+ * @brief Host test: the shipped I2C master (i2c_master_int.c) and eDMA driver (dma.c) against a model of the K64
+ *        I2C module, its DMA request and an FXOS8700 like slave on the bus.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -pthread -DROCHI_DEBUG -DCPU_MK64FN1M0VLL12 -I source -I source/DMA -I SDK/CMSIS -I SDK/startup \
+ *         tools/i2c_check.c source/I2C/i2c_master_int.c source/DMA/dma.c source/util/ring_buffer.c \
+ *         source/util/critical.c -o i2c_check
+ *     ./i2c_check
+ * The model takes the place of i2c_dr_master.c. Like the K64 at F = 0x2E (65 kHz SCL), a START, repeated START
+ * or STOP takes a bit time and a byte 9 of them, then sets IICIF (and TCF for bytes). In master receive mode,
+ * reading D starts the next byte, acknowledged with the TXAK there was when it started. With DMAEN, each byte
+ * received is a request of DMAMUX source 18, served by the channel dma.c set up: the model reads its TCD, reads
+ * D through SADDR and stores the byte at DADDR, and raises the channel interrupt at the end of the major loop.
+ * The I2C interrupt runs while IICIF and IICIE are set, checked every STEP_NS of simulated time.
+ * The slave ACKs address 0x1D, takes the first byte written as the register address and sends a byte worked
+ * out from the register address and the number of the transaction, so every read of a test gets other bytes.
+ * Reads of 1 to 192 bytes are done by interrupts and again by DMA. Then the queue is filled at once with the
+ * accelerometer configuration writes and reads, then reads are chained from the callback of the previous one,
+ * and transactions to an address nobody answers are put in between. Last, a write of LONG_WRITE bytes is changed
+ * after it was submitted, before its bytes go out, and a FIFO burst is looked at halfway through, to see that
+ * bytes are sent from the write span and stored in the read span with no copy in between. The bytes copied per
+ * sample are set against the ones the byte queue took before (old_copies(): the write span into to_be_written,
+ * every byte read into the queue, dummy included, and out of it into the read span).
+ * Fails (exit code 1) if a read does not end as I2C_TR_DONE, if the bytes read by DMA are not the ones the slave
+ * sent and the ones read by interrupts, if a TCD is not the one the transfer needs, or if the I2C interrupts of a
+ * DMA read grow with its length. Also if queued transactions are not done in order, if the bus is idle more than
+ * MAX_GAP_NS between a STOP and the START of the next one, if a full queue takes a transaction or changes its
+ * status, or if a NACKed one does not end as I2C_TR_NACK with nothing read and the bus free. Also if the slave
+ * does not get the write span as it was when its bytes went out, or if the read span is not filled as the bytes
+ * come.
+ * Reports the interrupts and bus time of each read, and the idle time between chained transactions.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "MK64F12.h"
+#include "I2C/i2c_dr_master.h"
+#include "I2C/i2c_master_int.h"
+#include "dma.h"
+
+#define STEP_NS         1000
+#define BIT_NS          15360       // 50 MHz / 768
+#define SLAVE_ADDRESS   0x1D
+#define I2C0_DMA_SOURCE 18
+#define TIMEOUT_NS      100000000ULL
+#define MAX_READ        192
+#define MAX_GAP_NS      (BIT_NS + 2 * STEP_NS)  // interrupt on the STOP, then the START of the next one
+#define NOBODY_ADDRESS  0x1E
+#define CHAINED_READS   20
+#define LONG_WRITE      40          // the old to_be_written took 8 bytes, both addresses included
+#define FIFO_SAMPLES    16
+#define SAMPLE_LEN      6
+
+#define C1_IICIE        0x40
+#define C1_MST          0x20
+#define C1_TX           0x10
+#define C1_TXAK         0x08
+#define C1_DMAEN        0x01
+
+#define NO_COMMAND      0xFF
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+// registers used by dma.c on host builds
+DMA_Type dma_host_regs;
+DMAMUX_Type dmamux_host_regs;
+SIM_Type sim_host_regs;
+
+void DMA0_IRQHandler(void);
+void DMA1_IRQHandler(void);
+void DMA2_IRQHandler(void);
+void DMA3_IRQHandler(void);
+
+static void (* const dma_handlers[DMA_N_CHANNELS])(void) = {DMA0_IRQHandler, DMA1_IRQHandler, DMA2_IRQHandler,
+                                                            DMA3_IRQHandler};
+
+typedef enum {OP_NONE, OP_START, OP_BYTE, OP_STOP} bus_op_t;
+
+static uint64_t now_ns;
+static unsigned int failures;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+/*******************************************************************************
+ * SLAVE
+ ******************************************************************************/
+
+static struct {
+    bool addressed;             // ACKed its address since the last START
+    bool reading;               // ADDR | R
+    bool first_write;           // the next byte written is the register address
+    bool nacked;                // the master NACKed: no more bytes are driven
+    uint8_t reg;
+    unsigned int transaction;   // STARTs with ADDR | W since the test began, not repeated ones
+    uint8_t sent[MAX_READ + 1];
+    unsigned int sent_len;
+    uint8_t written[LONG_WRITE];  // bytes written after the register address
+    unsigned int written_len;
+} slave;
+
+static uint8_t slave_byte(uint8_t reg, unsigned int transaction)
+{
+    return (uint8_t)(reg * 29 + transaction * 101 + 7);
+}
+
+static void slave_start(void)
+{
+    slave.addressed = false;
+}
+
+// true: ACK
+static bool slave_receive(uint8_t byte, bool address)
+{
+    if (address) {
+        slave.addressed = (byte >> 1) == SLAVE_ADDRESS;
+        slave.reading = byte & 1;
+        slave.nacked = false;
+        if (slave.addressed && !slave.reading) {
+            slave.first_write = true;
+            slave.written_len = 0;
+            slave.transaction++;
+        }
+        if (slave.addressed && slave.reading)
+            slave.sent_len = 0;
+        return slave.addressed;
+    }
+    if (!slave.addressed || slave.reading)
+        return false;
+    if (slave.first_write)
+        slave.reg = byte;
+    else if (slave.written_len < sizeof(slave.written))
+        slave.written[slave.written_len++] = byte;
+    slave.first_write = false;
+    return true;
+}
+
+static uint8_t slave_send(bool master_ack)
+{
+    if (!slave.addressed || !slave.reading || slave.nacked)
+        return 0xFF;        // nobody drives SDA
+    uint8_t byte = slave_byte(slave.reg++, slave.transaction);
+    if (slave.sent_len < sizeof(slave.sent))
+        slave.sent[slave.sent_len++] = byte;
+    slave.nacked = !master_ack;
+    return byte;
+}
+
+/*******************************************************************************
+ * I2C MODULE: i2c_dr_master.h
+ ******************************************************************************/
+
+static struct {
+    i2c_service_callback_t handler;
+    uint8_t c1;
+    bool tcf, iicif, rxak, busy, startf, stopf, ssie;
+    bus_op_t op;
+    uint64_t op_done_ns;
+    bool op_tx, op_address, op_ack;     // byte in progress: written by the master, an address, ACKed by the master
+    uint8_t op_byte;
+    bool address_next;                  // the next byte written follows a START
+} i2c;
+
+static volatile uint8_t data_reg;       // I2C0_D
+static uint64_t last_stop_ns, gap_max_ns, gap_total_ns;
+static unsigned long gaps;
+static bool stopped;                    // a STOP since the last START, for the gap
+static unsigned long i2c_irqs, dma_irqs, cpu_reads, dma_reads, bus_bytes;
+
+static void dma_request(void);
+
+static void start_op(bus_op_t op, uint64_t bits)
+{
+    i2c.op = op;
+    i2c.op_done_ns = now_ns + bits * BIT_NS;
+}
+
+// in master receive mode a read of D starts the next byte, unless one is already on the way
+static uint8_t data_read(bool by_dma)
+{
+    uint8_t value = data_reg;
+    i2c.tcf = false;
+    if ((i2c.c1 & C1_MST) && !(i2c.c1 & C1_TX) && i2c.op == OP_NONE) {
+        i2c.op_tx = false;
+        i2c.op_ack = !(i2c.c1 & C1_TXAK);
+        start_op(OP_BYTE, 9);
+    }
+    if (by_dma)
+        dma_reads++;
+    else
+        cpu_reads++;
+    return value;
+}
+
+void i2c_dr_master_init(i2c_modules_dr_t mod, i2c_service_callback_t callback)
+{
+    CHECK(mod == I2C0_DR_MOD);
+    i2c.handler = callback;
+    i2c.c1 = 0xC0;
+    i2c.ssie = true;
+}
+
+bool i2c_dr_get_tx_rx_mode(i2c_modules_dr_t mod) { (void)mod; return i2c.c1 & C1_TX; }
+bool i2c_dr_get_mst(i2c_modules_dr_t mod) { (void)mod; return i2c.c1 & C1_MST; }
+bool i2c_dr_get_transfer_complete(i2c_modules_dr_t mod) { (void)mod; return i2c.tcf; }
+bool i2c_dr_bus_is_busy(i2c_modules_dr_t mod) { (void)mod; return i2c.busy; }
+bool i2c_dr_bus_busy(i2c_modules_dr_t mod) { (void)mod; return i2c.busy; }
+bool i2c_dr_get_iicif(i2c_modules_dr_t mod) { (void)mod; return i2c.iicif; }
+void i2c_dr_clear_iicif(i2c_modules_dr_t mod) { (void)mod; i2c.iicif = false; }
+bool i2c_dr_get_rxak(i2c_modules_dr_t mod) { (void)mod; return i2c.rxak; }
+bool i2c_dr_get_arbitration_lost(i2c_modules_dr_t mod) { (void)mod; return false; }
+bool i2c_dr_get_startf(i2c_modules_dr_t mod) { (void)mod; return i2c.startf; }
+void i2c_dr_clear_startf(i2c_modules_dr_t mod) { (void)mod; i2c.startf = false; }
+bool i2c_dr_get_stopf(i2c_modules_dr_t mod) { (void)mod; return i2c.stopf; }
+void i2c_dr_clear_stopf(i2c_modules_dr_t mod) { (void)mod; i2c.stopf = false; }
+void i2c_dr_set_start_stop_interrupt(i2c_modules_dr_t mod, bool enabled) { (void)mod; i2c.ssie = enabled; }
+volatile uint8_t * i2c_dr_get_data_register(i2c_modules_dr_t mod) { (void)mod; return &data_reg; }
+uint8_t i2c_dr_get_dma_source(i2c_modules_dr_t mod) { (void)mod; return I2C0_DMA_SOURCE; }
+unsigned char i2c_dr_read_data(i2c_modules_dr_t mod) { (void)mod; return data_read(false); }
+
+static void set_c1(uint8_t mask, bool set)
+{
+    i2c.c1 = set ? i2c.c1 | mask : i2c.c1 & ~mask;
+}
+
+void i2c_dr_set_tx_rx_mode(i2c_modules_dr_t mod, bool tx_mode) { (void)mod; set_c1(C1_TX, tx_mode); }
+void i2c_dr_send_ack(i2c_modules_dr_t mod, bool ack_value) { (void)mod; set_c1(C1_TXAK, ack_value); }
+void i2c_dr_set_interrupt(i2c_modules_dr_t mod, bool enabled) { (void)mod; set_c1(C1_IICIE, enabled); }
+
+void i2c_dr_set_dma(i2c_modules_dr_t mod, bool enabled);
+
+// MST 0 to 1: START. 1 to 0: STOP
+void i2c_dr_send_start_stop(i2c_modules_dr_t mod, bool start_stop)
+{
+    (void)mod;
+    if (start_stop && !(i2c.c1 & C1_MST))
+        start_op(OP_START, 1);
+    else if (!start_stop && (i2c.c1 & C1_MST))
+        start_op(OP_STOP, 1);
+    set_c1(C1_MST, start_stop);
+}
+
+void i2c_dr_send_repeated_start(i2c_modules_dr_t mod)
+{
+    (void)mod;
+    if (i2c.c1 & C1_MST)
+        start_op(OP_START, 1);
+}
+
+void i2c_dr_write_data(i2c_modules_dr_t mod, unsigned char data)
+{
+    (void)mod;
+    data_reg = data;
+    i2c.tcf = false;
+    if ((i2c.c1 & C1_MST) && (i2c.c1 & C1_TX) && i2c.op == OP_NONE) {
+        i2c.op_tx = true;
+        i2c.op_byte = data;
+        i2c.op_address = i2c.address_next;
+        i2c.address_next = false;
+        start_op(OP_BYTE, 9);
+    }
+}
+
+// the end of the operation on the bus
+static void bus_step(void)
+{
+    if (i2c.op == OP_NONE || now_ns < i2c.op_done_ns)
+        return;
+    bus_op_t op = i2c.op;
+    i2c.op = OP_NONE;
+
+    if (op == OP_START) {
+        if (!i2c.busy && stopped) {
+            uint64_t gap = now_ns - last_stop_ns;
+            gap_total_ns += gap;
+            gaps++;
+            if (gap > gap_max_ns)
+                gap_max_ns = gap;
+        }
+        stopped = false;
+        i2c.busy = true;
+        i2c.startf = true;
+        i2c.address_next = true;
+        slave_start();
+        if (i2c.ssie)
+            i2c.iicif = true;
+    }
+    else if (op == OP_STOP) {
+        last_stop_ns = now_ns;
+        stopped = true;
+        i2c.busy = false;
+        i2c.stopf = true;
+        slave_start();
+        if (i2c.ssie)
+            i2c.iicif = true;
+    }
+    else {
+        bus_bytes++;
+        if (i2c.op_tx)
+            i2c.rxak = !slave_receive(i2c.op_byte, i2c.op_address);
+        else
+            data_reg = slave_send(i2c.op_ack);
+        i2c.tcf = true;
+        i2c.iicif = true;
+        if (!i2c.op_tx && (i2c.c1 & C1_DMAEN))
+            dma_request();
+    }
+}
+
+/*******************************************************************************
+ * DMA: the channel dma.c set up for the I2C request
+ ******************************************************************************/
+
+#define MAX_SPANS       (I2C_INT_QUEUE_LENGTH + 1)
+
+// the read spans of the transactions the test submitted: a TCD must be set up for one of them
+static struct {
+    uint8_t * data;
+    int len;
+} spans[MAX_SPANS];
+static unsigned int spans_count;
+static unsigned long tcd_errors, dma_lost_requests;
+static uint32_t dma_pending_irqs;
+
+// SERQ, CERQ and CINT are write only: the model takes each value written and clears it
+static void dma_take_commands(void)
+{
+    if (dma_host_regs.CERQ != NO_COMMAND) {
+        dma_host_regs.ERQ &= ~(1U << dma_host_regs.CERQ);
+        dma_host_regs.CERQ = NO_COMMAND;
+    }
+    if (dma_host_regs.SERQ != NO_COMMAND) {
+        dma_host_regs.ERQ |= 1U << dma_host_regs.SERQ;
+        dma_host_regs.SERQ = NO_COMMAND;
+    }
+    if (dma_host_regs.CINT != NO_COMMAND) {
+        dma_host_regs.INT &= ~(1U << dma_host_regs.CINT);
+        dma_host_regs.CINT = NO_COMMAND;
+    }
+}
+
+// TCD addresses are 32 bit: the buffers of this program are all within the same 4 GB
+static uint8_t * host_pointer(uint32_t address)
+{
+    return (uint8_t *)(((uintptr_t)&data_reg & ~(uintptr_t)0xFFFFFFFFU) | address);
+}
+
+static int dma_channel(void)
+{
+    for (int ch = 0; ch < DMA_N_CHANNELS; ch++)
+        if (dmamux_host_regs.CHCFG[ch] == (DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(I2C0_DMA_SOURCE))
+            && (dma_host_regs.ERQ & (1U << ch)))
+            return ch;
+    return -1;
+}
+
+static void tcd_check(bool ok, const char * what)
+{
+    if (!ok) {
+        printf("FAIL TCD: %s\n", what);
+        tcd_errors++;
+    }
+}
+
+// the TCD when the I2C module starts asking for bytes
+static void check_tcd(void)
+{
+    dma_take_commands();
+    int ch = dma_channel();
+    tcd_check(ch >= 0, "no channel enabled for DMAMUX source 18");
+    if (ch < 0)
+        return;
+    tcd_check(ch == 0, "I2C0 is on channel 0");
+    volatile typeof(dma_host_regs.TCD[0]) * tcd = &dma_host_regs.TCD[ch];
+    tcd_check(tcd->SADDR == (uint32_t)(uintptr_t)&data_reg, "SADDR is I2C0_D");
+    tcd_check(tcd->SOFF == 0 && tcd->SLAST == 0, "SOFF and SLAST are 0");
+    tcd_check(tcd->ATTR == (DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0)), "ATTR is 8 bit both sides");
+    tcd_check(tcd->NBYTES_MLNO == 1, "NBYTES is 1");
+    unsigned int span = 0;
+    while (span < spans_count && tcd->DADDR != (uint32_t)(uintptr_t)spans[span].data)
+        span++;
+    tcd_check(span < spans_count, "DADDR is the start of a read span");
+    tcd_check(tcd->DOFF == 1 && tcd->DLAST_SGA == 0, "DOFF is 1, DLAST_SGA 0");
+    if (span < spans_count)
+        tcd_check(tcd->CITER_ELINKNO == spans[span].len - 2 && tcd->BITER_ELINKNO == spans[span].len - 2,
+                  "CITER and BITER are the read length less 2");
+    tcd_check(tcd->CSR == (DMA_CSR_INTMAJOR_MASK | DMA_CSR_DREQ_MASK), "CSR is INTMAJOR | DREQ");
+}
+
+void i2c_dr_set_dma(i2c_modules_dr_t mod, bool enabled)
+{
+    (void)mod;
+    if (enabled && !(i2c.c1 & C1_DMAEN))
+        check_tcd();
+    set_c1(C1_DMAEN, enabled);
+}
+
+// one minor loop: a byte from SADDR to DADDR. The read of D starts the next byte on the bus
+static void dma_request(void)
+{
+    dma_take_commands();
+    int ch = dma_channel();
+    if (ch < 0) {
+        dma_lost_requests++;
+        return;
+    }
+    volatile typeof(dma_host_regs.TCD[0]) * tcd = &dma_host_regs.TCD[ch];
+    if (tcd->SADDR != (uint32_t)(uintptr_t)&data_reg) {
+        dma_lost_requests++;
+        return;
+    }
+    *host_pointer(tcd->DADDR) = data_read(true);
+    tcd->SADDR += tcd->SOFF;
+    tcd->DADDR += tcd->DOFF;
+    if (--tcd->CITER_ELINKNO == 0) {
+        tcd->CITER_ELINKNO = tcd->BITER_ELINKNO;
+        tcd->DADDR += tcd->DLAST_SGA;
+        tcd->CSR |= DMA_CSR_DONE_MASK;
+        if (tcd->CSR & DMA_CSR_DREQ_MASK)
+            dma_host_regs.ERQ &= ~(1U << ch);
+        if (tcd->CSR & DMA_CSR_INTMAJOR_MASK) {
+            dma_host_regs.INT |= 1U << ch;
+            dma_pending_irqs |= 1U << ch;
+        }
+    }
+}
+
+/*******************************************************************************
+ * RUN
+ ******************************************************************************/
+
+static void expect_reads(uint8_t * data, int len)
+{
+    CHECK(spans_count < MAX_SPANS && host_pointer((uint32_t)(uintptr_t)data) == data);
+    spans[spans_count++].data = data;
+    spans[spans_count - 1].len = len;
+}
+
+// one step of simulated time: the bus, then the interrupts, DMA first (same priority, lower vector)
+static void step(void)
+{
+    now_ns += STEP_NS;
+    dma_take_commands();
+    bus_step();
+    for (int ch = 0; ch < DMA_N_CHANNELS; ch++) {
+        if (dma_pending_irqs & (1U << ch)) {
+            dma_pending_irqs &= ~(1U << ch);
+            dma_irqs++;
+            dma_handlers[ch]();
+            dma_take_commands();
+        }
+    }
+    for (int n = 0; n < 4 && i2c.iicif && (i2c.c1 & C1_IICIE); n++) {
+        i2c_irqs++;
+        i2c.handler(I2C0_DR_MOD);
+    }
+}
+
+static bool run_until_done(i2c_transaction_t * t)
+{
+    uint64_t end = now_ns + TIMEOUT_NS;
+    while ((t->status == I2C_TR_QUEUED || i2c_master_int_bus_busy(I2C0_INT_MOD)) && now_ns < end)
+        step();
+    return t->status != I2C_TR_QUEUED;
+}
+
+typedef struct {
+    unsigned long i2c_irqs, dma_irqs, cpu_reads, dma_reads;
+    double bus_us;
+} read_cost_t;
+
+// register 0x01 and len bytes from there
+static read_cost_t read_once(uint8_t * buffer, int len, bool use_dma)
+{
+    static const uint8_t reg = 0x01;
+    i2c_transaction_t t = {.address = SLAVE_ADDRESS, .write_data = &reg, .write_len = 1, .read_data = buffer,
+                           .read_len = len, .use_dma = use_dma};
+    unsigned long irqs0 = i2c_irqs, dma_irqs0 = dma_irqs, cpu0 = cpu_reads, dma0 = dma_reads;
+    spans_count = 0;
+    expect_reads(buffer, len);
+    uint64_t t0 = now_ns;
+
+    CHECK(i2c_master_int_submit(I2C0_INT_MOD, &t));
+    CHECK(run_until_done(&t));
+    CHECK(t.status == I2C_TR_DONE);
+    CHECK(slave.sent_len == (unsigned int)len && memcmp(buffer, slave.sent, (size_t)len) == 0);
+    return (read_cost_t){i2c_irqs - irqs0, dma_irqs - dma_irqs0, cpu_reads - cpu0, dma_reads - dma0,
+                         (now_ns - t0) / 1e3};
+}
+
+static void dma_against_interrupts(void)
+{
+    static const int lengths[] = {1, 2, 3, 6, 13, 96, MAX_READ};
+    enum {N_LENGTHS = sizeof(lengths) / sizeof(lengths[0])};
+    static uint8_t by_irq[N_LENGTHS][MAX_READ], by_dma[N_LENGTHS][MAX_READ];
+    read_cost_t irq_cost[N_LENGTHS], dma_cost[N_LENGTHS];
+
+    unsigned int first = slave.transaction;
+    for (int i = 0; i < N_LENGTHS; i++)
+        irq_cost[i] = read_once(by_irq[i], lengths[i], false);
+    slave.transaction = first;      // the same bytes again
+    for (int i = 0; i < N_LENGTHS; i++)
+        dma_cost[i] = read_once(by_dma[i], lengths[i], true);
+
+    printf("read of   by interrupts                      by DMA\n");
+    for (int i = 0; i < N_LENGTHS; i++) {
+        printf("%3d bytes %4lu I2C irqs, %3lu D reads %7.0f us   %2lu I2C + %lu DMA irqs, %3lu D reads by DMA %7.0f us\n",
+               lengths[i], irq_cost[i].i2c_irqs, irq_cost[i].cpu_reads, irq_cost[i].bus_us, dma_cost[i].i2c_irqs,
+               dma_cost[i].dma_irqs, dma_cost[i].dma_reads, dma_cost[i].bus_us);
+        CHECK(memcmp(by_irq[i], by_dma[i], (size_t)lengths[i]) == 0);
+        CHECK(irq_cost[i].dma_reads == 0 && irq_cost[i].dma_irqs == 0);
+        if (lengths[i] >= 3) {
+            CHECK(dma_cost[i].dma_reads == (unsigned long)lengths[i] - 2 && dma_cost[i].dma_irqs == 1);
+            CHECK(dma_cost[i].i2c_irqs == dma_cost[2].i2c_irqs);   // as many as for 3 bytes
+        }
+    }
+    CHECK(tcd_errors == 0 && dma_lost_requests == 0);
+}
+
+// back to back: the STOP interrupt starts the next transaction
+static void reset_gaps(void)
+{
+    gap_max_ns = gap_total_ns = gaps = 0;
+    stopped = false;
+}
+
+static unsigned int done_order[2 * I2C_INT_QUEUE_LENGTH];
+static unsigned int done_count;
+
+static void record_done(i2c_transaction_t * t)
+{
+    done_order[done_count++ % (2 * I2C_INT_QUEUE_LENGTH)] = (unsigned int)(uintptr_t)t->context;
+}
+
+static void queued_at_once(void)
+{
+    static const uint8_t config[][2] = {{0x2A, 0x00}, {0x5B, 0x00}, {0x5B, 0x1F}, {0x5C, 0x00}, {0x09, 0x50},
+                                        {0x2D, 0x40}, {0x2E, 0x00}, {0x0E, 0x01}, {0x2A, 0x0D}};
+    enum {N_CONFIG = sizeof(config) / sizeof(config[0]), N_QUEUED = I2C_INT_QUEUE_LENGTH + 1};
+    static const uint8_t status_reg = 0x00;
+    static uint8_t reads[N_QUEUED][13];
+    i2c_transaction_t t[N_QUEUED + 1];
+
+    // the first one goes on the bus at once, I2C_INT_QUEUE_LENGTH wait
+    spans_count = 0;
+    for (unsigned int i = 0; i < N_QUEUED; i++) {
+        if (i < N_CONFIG)
+            t[i] = (i2c_transaction_t){.address = SLAVE_ADDRESS, .write_data = config[i], .write_len = 2};
+        else
+            t[i] = (i2c_transaction_t){.address = SLAVE_ADDRESS, .write_data = &status_reg, .write_len = 1,
+                                       .read_data = reads[i], .read_len = 13, .use_dma = i % 2};
+        if (t[i].read_len)
+            expect_reads(reads[i], 13);
+        t[i].callback = record_done;
+        t[i].context = (void *)(uintptr_t)i;
+        CHECK(i2c_master_int_submit(I2C0_INT_MOD, &t[i]));
+    }
+    t[N_QUEUED] = (i2c_transaction_t){.address = SLAVE_ADDRESS, .write_data = config[0], .write_len = 2,
+                                      .status = I2C_TR_DONE};
+    CHECK(!i2c_master_int_submit(I2C0_INT_MOD, &t[N_QUEUED]));
+    CHECK(t[N_QUEUED].status == I2C_TR_DONE);
+
+    reset_gaps();
+    done_count = 0;
+    uint64_t t0 = now_ns;
+    CHECK(run_until_done(&t[N_QUEUED - 1]));
+    double busy_us = (now_ns - t0) / 1e3;
+    bool in_order = done_count == N_QUEUED;
+    for (unsigned int i = 0; i < N_QUEUED; i++) {
+        CHECK(t[i].status == I2C_TR_DONE);
+        in_order = in_order && done_order[i] == i;
+    }
+    CHECK(in_order);
+    printf("%u transactions queued at once: done in order in %.0f us, bus idle between them %.1f us avg %.1f us max\n",
+           N_QUEUED, busy_us, gaps ? gap_total_ns / 1e3 / gaps : 0, gap_max_ns / 1e3);
+    CHECK(gaps == N_QUEUED - 1 && gap_max_ns <= MAX_GAP_NS);
+}
+
+// each read is submitted by the callback of the previous one, from the I2C interrupt, as the accelerometer does
+static i2c_transaction_t chained;
+static uint8_t chained_data[6];
+static unsigned int chained_left;
+
+static void chain_next(i2c_transaction_t * t)
+{
+    if (t->status == I2C_TR_DONE && --chained_left > 0)
+        CHECK(i2c_master_int_submit(I2C0_INT_MOD, t));
+}
+
+static void chained_from_callbacks(void)
+{
+    static const uint8_t mag_reg = 0x33;
+    chained = (i2c_transaction_t){.address = SLAVE_ADDRESS, .write_data = &mag_reg, .write_len = 1,
+                                  .read_data = chained_data, .read_len = 6, .use_dma = true, .callback = chain_next};
+    chained_left = CHAINED_READS;
+    spans_count = 0;
+    expect_reads(chained_data, sizeof(chained_data));
+    reset_gaps();
+    CHECK(i2c_master_int_submit(I2C0_INT_MOD, &chained));
+    uint64_t end = now_ns + TIMEOUT_NS;
+    while ((chained_left > 0 || i2c_master_int_bus_busy(I2C0_INT_MOD)) && now_ns < end)
+        step();
+    printf("%u reads chained from callbacks: bus idle between them %.1f us avg %.1f us max\n", CHAINED_READS,
+           gaps ? gap_total_ns / 1e3 / gaps : 0, gap_max_ns / 1e3);
+    CHECK(chained_left == 0 && chained.status == I2C_TR_DONE);
+    CHECK(gaps == CHAINED_READS - 1 && gap_max_ns <= MAX_GAP_NS);
+}
+
+// a read from an address nobody answers ends at the address NACK, the next one is done as usual
+static void nacked(void)
+{
+    static const uint8_t reg = 0x01;
+    static uint8_t lost[13], got[13];   // static: DMA addresses are worked out from the static data
+    memset(lost, 0x5A, sizeof(lost));
+    i2c_transaction_t nobody = {.address = NOBODY_ADDRESS, .write_data = &reg, .write_len = 1, .read_data = lost,
+                                .read_len = sizeof(lost), .use_dma = true};
+    i2c_transaction_t after = {.address = SLAVE_ADDRESS, .write_data = &reg, .write_len = 1, .read_data = got,
+                               .read_len = sizeof(got), .use_dma = true};
+    spans_count = 0;
+    expect_reads(got, sizeof(got));
+    CHECK(i2c_master_int_submit(I2C0_INT_MOD, &nobody));
+    CHECK(i2c_master_int_submit(I2C0_INT_MOD, &after));
+    CHECK(run_until_done(&after));
+    CHECK(nobody.status == I2C_TR_NACK);
+    bool untouched = true;
+    for (unsigned int i = 0; i < sizeof(lost); i++)
+        untouched = untouched && lost[i] == 0x5A;
+    CHECK(untouched);
+    CHECK(after.status == I2C_TR_DONE && memcmp(got, slave.sent, sizeof(got)) == 0);
+    CHECK(!i2c.busy && !i2c_master_int_bus_busy(I2C0_INT_MOD));
+}
+
+// bytes copied by the driver that had a byte queue, besides storing what comes from the bus
+static unsigned int old_copies(int write_len, int read_len)
+{
+    return (unsigned int)(write_len + (read_len + 1) + read_len);
+}
+
+// a write longer than the old to_be_written, changed after it was submitted: the bytes are taken as they go out
+static void long_write(void)
+{
+    static uint8_t data[1 + LONG_WRITE];
+    data[0] = 0x10;                 // register address
+    for (int i = 1; i <= LONG_WRITE; i++)
+        data[i] = (uint8_t)i;
+    i2c_transaction_t t = {.address = SLAVE_ADDRESS, .write_data = data, .write_len = sizeof(data)};
+    CHECK(i2c_master_int_submit(I2C0_INT_MOD, &t));
+    for (int i = LONG_WRITE / 2; i <= LONG_WRITE; i++)
+        data[i] = (uint8_t)~i;      // not on the bus yet
+    CHECK(run_until_done(&t));
+    CHECK(t.status == I2C_TR_DONE);
+    CHECK(slave.written_len == LONG_WRITE && memcmp(slave.written, data + 1, LONG_WRITE) == 0);
+}
+
+// a FIFO burst: the first half of the bytes are in the read span while the second half is still on the bus
+static bool span_filled;
+
+static void check_span(i2c_transaction_t * t)
+{
+    span_filled = memcmp(t->read_data, slave.sent, (size_t)t->read_len) == 0;
+}
+
+static void fifo_burst(bool use_dma)
+{
+    static const uint8_t reg = 0x01;
+    static uint8_t burst[FIFO_SAMPLES * SAMPLE_LEN];
+    memset(burst, 0, sizeof(burst));
+    spans_count = 0;
+    expect_reads(burst, sizeof(burst));
+    i2c_transaction_t t = {.address = SLAVE_ADDRESS, .write_data = &reg, .write_len = 1, .read_data = burst,
+                           .read_len = sizeof(burst), .use_dma = use_dma, .callback = check_span};
+    unsigned long reads0 = cpu_reads + dma_reads;
+    span_filled = false;
+    CHECK(i2c_master_int_submit(I2C0_INT_MOD, &t));
+    uint64_t half = now_ns + (uint64_t)(4 + sizeof(burst) / 2) * 9 * BIT_NS;
+    while (now_ns < half)
+        step();
+    CHECK(slave.sent_len >= sizeof(burst) / 2 - 1 && memcmp(burst, slave.sent, slave.sent_len - 1) == 0);
+    CHECK(run_until_done(&t));
+    CHECK(t.status == I2C_TR_DONE && span_filled);      // all in place when the callback runs
+
+    // every byte read from D but the dummy one is stored once, straight into the span
+    unsigned long stored = cpu_reads + dma_reads - reads0 - 1;
+    printf("FIFO burst of %u samples, %s: %.1f bytes stored per sample, 0 copied; the byte queue copied %.1f\n",
+           FIFO_SAMPLES, use_dma ? "DMA" : "interrupts", (double)stored / FIFO_SAMPLES,
+           (double)old_copies(1, sizeof(burst)) / FIFO_SAMPLES);
+    CHECK(stored == sizeof(burst));
+}
+
+int main(void)
+{
+    memset(&dma_host_regs, 0, sizeof(dma_host_regs));
+    dma_host_regs.SERQ = dma_host_regs.CERQ = dma_host_regs.CINT = NO_COMMAND;
+    i2c_master_int_init(I2C0_INT_MOD);
+
+    dma_against_interrupts();
+    queued_at_once();
+    chained_from_callbacks();
+    nacked();
+    long_write();
+    fifo_burst(false);
+    fifo_burst(true);
+    printf("one sample read alone (13 bytes): 13 bytes stored, 0 copied; the byte queue copied %u\n",
+           old_copies(1, 13));
+    CHECK(tcd_errors == 0 && dma_lost_requests == 0);
+
+    printf("i2c_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
@@ -0,0 +1,182 @@
+/***************************************************************************//**
+ * @file pit_check.c
+ * @brief Host test: runs the shipped PIT driver (pit.c) against a model of the PIT channels.
+ *
+ * Build and run from the repository root:
+ *     gcc -DROCHI_DEBUG -DCPU_MK64FN1M0VLL12 -I source -I source/PIT -I SDK/CMSIS -I SDK/startup \
+ *         tools/pit_check.c source/PIT/pit.c -o pit_check
+ *     ./pit_check
+ * The model counts bus clock cycles. Like the K64, a channel loads LDVAL only when TEN goes from 0 to 1
+ * and after each underflow, so a driver that skipped TCTRL = 0 before enabling would not restart the period.
+ * Checks LDVAL = us * 50 - 1, the TCTRL writes, call times of periodic and SINGLE_SHOT callbacks,
+ * restarting and changing the period, and running out of channels. Fails (exit code 1) if any check fails.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "MK64F12.h"
+#include "pit.h"
+
+#define MAX_CALLS       64
+#define TCTRL_RUN       (PIT_TCTRL_TIE_MASK | PIT_TCTRL_TEN_MASK)
+#define US(x)           ((uint64_t)(x) * (PIT_CLOCK_HZ / 1000000U))   // bus cycles
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+// registers and hook used by pit.c on host builds
+PIT_Type pit_host_regs;
+SIM_Type sim_host_regs;
+
+void PIT0_IRQHandler(void);
+void PIT1_IRQHandler(void);
+void PIT2_IRQHandler(void);
+void PIT3_IRQHandler(void);
+
+typedef struct {
+    bool running;
+    uint32_t cval;              // cycles left until the underflow
+    uint32_t last_tctrl[2];     // last two values written, most recent first
+    unsigned int writes;
+} channel_model_t;
+
+typedef struct {
+    unsigned int n;
+    uint64_t at[MAX_CALLS];     // cycle of each call
+} calls_t;
+
+static channel_model_t model[PIT_N_CHANNELS];
+static void (* const handlers[PIT_N_CHANNELS])(void) = {PIT0_IRQHandler, PIT1_IRQHandler, PIT2_IRQHandler, PIT3_IRQHandler};
+static uint64_t now;            // bus cycles since the start
+static calls_t calls_a, calls_b;
+static unsigned int failures;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+void pit_host_tctrl_written(pit_channel_t ch, uint32_t tctrl)
+{
+    channel_model_t * m = &model[ch];
+    bool enable = (tctrl & PIT_TCTRL_TEN_MASK) != 0;
+    if (enable && !m->running)
+        m->cval = pit_host_regs.CHANNEL[ch].LDVAL;
+    m->running = enable;
+    m->last_tctrl[1] = m->last_tctrl[0];
+    m->last_tctrl[0] = tctrl;
+    m->writes++;
+}
+
+// advances the model, calling the handler of every channel that underflows (TIE is always set here)
+static void run(uint64_t cycles)
+{
+    uint64_t end = now + cycles;
+    while (true) {
+        int next = -1;
+        for (int i = 0; i < PIT_N_CHANNELS; i++)
+            if (model[i].running && (next < 0 || model[i].cval < model[next].cval))
+                next = i;
+        if (next < 0 || now + model[next].cval + 1 > end)
+            break;
+
+        uint32_t step = model[next].cval + 1;   // counts down to 0, underflows on the next cycle
+        now += step;
+        for (int i = 0; i < PIT_N_CHANNELS; i++)
+            if (model[i].running && i != next)
+                model[i].cval -= step;
+        model[next].cval = pit_host_regs.CHANNEL[next].LDVAL;
+        pit_host_regs.CHANNEL[next].TFLG = PIT_TFLG_TIF_MASK;
+        handlers[next]();
+    }
+    for (int i = 0; i < PIT_N_CHANNELS; i++)
+        if (model[i].running)
+            model[i].cval -= end - now;
+    now = end;
+}
+
+static void record(calls_t * c)
+{
+    if (c->n < MAX_CALLS)
+        c->at[c->n] = now;
+    c->n++;
+}
+
+static void cb_a(void) { record(&calls_a); }
+static void cb_b(void) { record(&calls_b); }
+static void cb_c(void) { }
+static void cb_d(void) { }
+
+int main(void)
+{
+    pit_init();
+    CHECK(sim_host_regs.SCGC6 & SIM_SCGC6_PIT_MASK);
+    CHECK(pit_host_regs.MCR == PIT_MCR_FRZ_MASK);   // MDIS clear: module enabled
+    for (int i = 0; i < PIT_N_CHANNELS; i++)
+        CHECK(model[i].writes == 1 && model[i].last_tctrl[0] == 0);
+    pit_init();
+    CHECK(model[0].writes == 1);                    // safe init
+
+    // periodic: a whole period between calls, from the moment it is added
+    CHECK(pit_add_callback(cb_a, 0, PERIODIC) == PIT_N_CHANNELS);
+    pit_channel_t a = pit_add_callback(cb_a, 1000, PERIODIC);
+    CHECK(a == PIT_CH0);
+    CHECK(pit_host_regs.CHANNEL[a].LDVAL == 1000 * 50 - 1);
+    CHECK(model[a].last_tctrl[1] == 0 && model[a].last_tctrl[0] == TCTRL_RUN);
+    uint64_t start = now;
+    run(US(10000));
+    CHECK(calls_a.n == 10);
+    for (unsigned int i = 0; i < 10; i++)
+        CHECK(calls_a.at[i] == start + US(1000) * (i + 1));
+
+    // SINGLE_SHOT: called once, then the channel is stopped by the handler
+    pit_channel_t b = pit_add_callback(cb_b, 250, SINGLE_SHOT);
+    CHECK(b == PIT_CH1);
+    CHECK(pit_host_regs.CHANNEL[b].LDVAL == 250 * 50 - 1);
+    start = now;
+    run(US(5000));
+    CHECK(calls_b.n == 1 && calls_b.at[0] == start + US(250));
+    CHECK(!model[b].running && pit_host_regs.CHANNEL[b].TCTRL == 0);
+    CHECK(calls_a.n == 15);                         // other channels keep running
+
+    // enabling a running channel restarts the period
+    calls_a.n = 0;
+    run(US(400));
+    pit_enable_callback(a);
+    CHECK(model[a].last_tctrl[1] == 0 && model[a].last_tctrl[0] == TCTRL_RUN);
+    start = now;
+    run(US(1500));
+    CHECK(calls_a.n == 1 && calls_a.at[0] == start + US(1000));
+
+    // a new period starts after the current one ends
+    calls_a.n = 0;
+    pit_set_period(a, 2000);
+    CHECK(pit_host_regs.CHANNEL[a].LDVAL == 2000 * 50 - 1);
+    run(US(4600));
+    CHECK(calls_a.n == 3);
+    CHECK(calls_a.n >= 3 && calls_a.at[0] == start + US(2000)
+          && calls_a.at[1] == start + US(4000) && calls_a.at[2] == start + US(6000));
+
+    // disabled channels are not called, SINGLE_SHOT channels can be enabled again
+    pit_disable_callback(a);
+    calls_a.n = 0;
+    pit_enable_callback(b);
+    CHECK(model[b].running);
+    run(US(10000));
+    CHECK(calls_a.n == 0 && calls_b.n == 2);
+
+    // four channels only, deleting one frees it
+    CHECK(pit_add_callback(cb_c, 100, PERIODIC) == PIT_CH2);
+    CHECK(pit_add_callback(cb_d, 100, PERIODIC) == PIT_CH3);
+    CHECK(pit_add_callback(cb_d, 100, PERIODIC) == PIT_N_CHANNELS);
+    pit_delete_callback(PIT_CH2);
+    CHECK(!model[PIT_CH2].running);
+    CHECK(pit_add_callback(cb_d, 100, PERIODIC) == PIT_CH2);
+
+    printf("pit_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
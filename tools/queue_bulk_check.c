@@ -0,0 +1,168 @@
+/***************************************************************************//**
+ * @file queue_bulk_check.c
+ * @brief Host benchmark: bytes per second through the byte queue for whole frames, moved with q_push_n/q_pop_n,
+ *        one byte at a time, and one byte at a time through the queue before the ring buffer.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -DROCHI_DEBUG -I source/util tools/queue_bulk_check.c source/util/queue.c \
+ *         source/util/ring_buffer.c source/util/critical.c -o queue_bulk_check
+ *     ./queue_bulk_check
+ * Frames are 7 bytes (a PC message) and 13 bytes (a status byte and 6 accelerometer axes). Every frame is
+ * pushed and popped once, the queue is 1024 bytes long like the uart ones, so frames cross the wrap point often.
+ * Each frame read back is compared with the one written. Fails (exit code 1) if one differs or if the bulk
+ * functions move fewer bytes than asked with room in the queue.
+ * Rates are for this host: only good to compare the three ways of moving frames, not for the K64.
+ * The new queue updates its statistics once per call, the old one had none. It also masked interrupts twice
+ * per byte on target, which a host build does not do.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "queue.h"
+
+#define TOTAL_BYTES     (50UL * 1000 * 1000)    // per frame size and method
+#define FRAMES_QUEUED   8                       // frames pushed before popping them
+
+/*******************************************************************************
+ * THE QUEUE BEFORE THE RING BUFFER, AS IT WAS (host build, so without interrupt masking)
+ ******************************************************************************/
+
+#define Q_MAX_LENGTH	1000
+
+typedef struct {
+	volatile uint8_t buffer[Q_MAX_LENGTH];
+	volatile uint32_t len;
+	volatile uint32_t in;
+	volatile uint32_t out;
+} old_queue_t;
+
+static bool old_q_pushback(old_queue_t * q, uint8_t data)
+{
+    q->buffer[q->in++] = data;
+    if(q->in == Q_MAX_LENGTH)
+        q->in = 0;
+    q->len = q->len <= Q_MAX_LENGTH? q->len+1 : Q_MAX_LENGTH;
+    return true;
+}
+
+static uint8_t old_q_popfront(old_queue_t * q)
+{
+	uint8_t data = 0;
+
+    if (q->len) {
+        q->len--;
+
+        data = q->buffer[q->out++];
+        if(q->out == Q_MAX_LENGTH) {
+        	q->out = 0;
+        }
+    }
+
+    return data;
+}
+
+/*******************************************************************************
+ * BENCHMARK
+ ******************************************************************************/
+
+typedef enum { BULK, BYTES, OLD_BYTES } method_t;
+
+static const char * const method_names[] = {"q_push_n/q_pop_n", "q_pushback/q_popfront", "old, byte by byte"};
+
+QUEUE_DEFINE(q, 1024);
+static old_queue_t old_q;
+static unsigned int failures;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void push_frame(method_t m, const uint8_t * frame, uint32_t len)
+{
+    switch (m) {
+    case BULK:
+        if (q_push_n(&q, frame, len) != len)
+            failures++;
+        break;
+    case BYTES:
+        for (uint32_t i = 0; i < len; i++)
+            q_pushback(&q, frame[i]);
+        break;
+    case OLD_BYTES:
+        for (uint32_t i = 0; i < len; i++)
+            old_q_pushback(&old_q, frame[i]);
+        break;
+    }
+}
+
+static void pop_frame(method_t m, uint8_t * frame, uint32_t len)
+{
+    switch (m) {
+    case BULK:
+        if (q_pop_n(&q, frame, len) != len)
+            failures++;
+        break;
+    case BYTES:
+        for (uint32_t i = 0; i < len; i++)
+            frame[i] = q_popfront(&q);
+        break;
+    case OLD_BYTES:
+        for (uint32_t i = 0; i < len; i++)
+            frame[i] = old_q_popfront(&old_q);
+        break;
+    }
+}
+
+// returns bytes per second
+static double run(method_t m, uint32_t len)
+{
+    uint8_t frames[FRAMES_QUEUED][16];
+    uint8_t read[16];
+    unsigned long rounds = TOTAL_BYTES / (len * FRAMES_QUEUED);
+    uint8_t seq = 0;
+
+    q_init(&q);
+    memset(&old_q, 0, sizeof(old_q));
+
+    double t0 = now_ns();
+    for (unsigned long r = 0; r < rounds; r++) {
+        for (int f = 0; f < FRAMES_QUEUED; f++) {
+            for (uint32_t i = 0; i < len; i++)
+                frames[f][i] = seq++;
+            push_frame(m, frames[f], len);
+        }
+        for (int f = 0; f < FRAMES_QUEUED; f++) {
+            pop_frame(m, read, len);
+            if (memcmp(read, frames[f], len) != 0)
+                failures++;
+        }
+    }
+    double t1 = now_ns();
+
+    return rounds * FRAMES_QUEUED * len / ((t1 - t0) * 1e-9);
+}
+
+int main(void)
+{
+    static const uint32_t sizes[] = {7, 13};
+
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double base = 0;
+        for (int m = OLD_BYTES; m >= BULK; m--) {
+            double rate = run((method_t)m, sizes[s]);
+            if (m == OLD_BYTES)
+                base = rate;
+            printf("%2u byte frames, %-22s %8.1f MB/s  x%.2f\n", sizes[s], method_names[m], rate * 1e-6, rate / base);
+        }
+    }
+
+    printf("queue_bulk_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
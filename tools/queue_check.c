@@ -0,0 +1,238 @@
+/***************************************************************************//**
+ * @file queue_check.c
+ * @brief Host test: the shipped byte queue (queue.c over ring_buffer.c) used by two threads at once,
+ *        and its cost per byte against the queue it replaced.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -pthread -DROCHI_DEBUG -I source/util tools/queue_check.c source/util/queue.c \
+ *         source/util/ring_buffer.c source/util/critical.c -o queue_check
+ *     ./queue_check
+ * A producer thread pushes a running byte sequence with q_push_n in spans of varying length while a consumer
+ * thread takes it with q_pop_n, also in varying spans, and checks every byte. Nothing is locked: the threads
+ * stand in for an ISR and the main loop. The counters start right below 2^32, so both the storage wrap point and
+ * the counter wrap around are crossed many times. Fails (exit code 1) if a byte is lost, repeated or out of order.
+ * The old queue (1000 byte array, length counter, index compare) is kept below as it was, to time both.
+ * On target the old one also masked every interrupt twice per byte, which a host run does not show.
+ * Times are host ns and, on x86, TSC cycles per byte: only good to compare both queues, not for the K64.
+ * The new queue pays for its statistics on every push, the old one had none.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "queue.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()        __rdtsc()
+#else
+#define CYCLES()        0ULL
+#endif
+
+#define STRESS_BYTES    20000000UL      // through the queue between both threads
+#define STRESS_LENGTH   256             // queue capacity, small so it is often full and often empty
+#define MAX_SPAN        61              // spans pushed and popped are 1 to MAX_SPAN bytes long
+#define COUNTER_START   (UINT32_MAX - 100000U)
+
+#define TIME_BYTES      64              // pushed, then popped, per round
+#define TIME_ROUNDS     1000000
+
+/*******************************************************************************
+ * THE QUEUE BEFORE THE RING BUFFER, AS IT WAS (host build, so without interrupt masking)
+ ******************************************************************************/
+
+#define Q_MAX_LENGTH	1000
+
+typedef struct {
+	volatile uint8_t buffer[Q_MAX_LENGTH];
+	volatile uint32_t len;
+	volatile uint32_t in;
+	volatile uint32_t out;
+} old_queue_t;
+
+static bool old_q_pushback(old_queue_t * q, uint8_t data)
+{
+    q->buffer[q->in++] = data;
+    if(q->in == Q_MAX_LENGTH)
+        q->in = 0;
+    q->len = q->len <= Q_MAX_LENGTH? q->len+1 : Q_MAX_LENGTH;
+    return true;
+}
+
+static uint8_t old_q_popfront(old_queue_t * q)
+{
+	uint8_t data = 0;
+
+    if (q->len) {
+        q->len--;
+
+        data = q->buffer[q->out++];
+        if(q->out == Q_MAX_LENGTH) {
+        	q->out = 0;
+        }
+    }
+
+    return data;
+}
+
+/*******************************************************************************
+ * TWO THREAD STRESS TEST
+ ******************************************************************************/
+
+QUEUE_DEFINE(stress_q, STRESS_LENGTH);
+static old_queue_t old_q;
+QUEUE_DEFINE(time_q, 1024);
+static volatile uint8_t sink;
+
+static unsigned long errors;
+static unsigned long full_pushes;   // q_push_n calls that did not fit whole
+static unsigned long empty_pops;    // q_pop_n calls that found less than asked
+
+// xorshift, each thread has its own so span lengths do not depend on scheduling
+static uint32_t next_random(uint32_t * state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void * producer(void * arg)
+{
+    (void)arg;
+    uint32_t seed = 0x12345678;
+    uint8_t span[MAX_SPAN];
+    uint8_t next = 0;
+    unsigned long sent = 0;
+
+    while (sent < STRESS_BYTES) {
+        uint32_t n = next_random(&seed) % MAX_SPAN + 1;
+        if (n > STRESS_BYTES - sent)
+            n = STRESS_BYTES - sent;
+        for (uint32_t i = 0; i < n; i++)
+            span[i] = next++;
+        uint32_t done = 0;
+        while (done < n) {                  // the rest is pushed again, so the sequence has no holes
+            uint32_t moved = q_push_n(&stress_q, &span[done], n - done);
+            if (moved < n - done) {
+                full_pushes++;
+                sched_yield();              // one core hosts are common, let the consumer run
+            }
+            done += moved;
+        }
+        sent += n;
+    }
+    return NULL;
+}
+
+static void * consumer(void * arg)
+{
+    (void)arg;
+    uint32_t seed = 0x9ABCDEF0;
+    uint8_t span[MAX_SPAN];
+    uint8_t expected = 0;
+    unsigned long received = 0;
+
+    while (received < STRESS_BYTES) {
+        uint32_t n = next_random(&seed) % MAX_SPAN + 1;
+        if (n > STRESS_BYTES - received)
+            n = STRESS_BYTES - received;
+        uint32_t moved = q_pop_n(&stress_q, span, n);
+        if (moved < n) {
+            empty_pops++;
+            sched_yield();
+        }
+        for (uint32_t i = 0; i < moved; i++) {
+            if (span[i] != expected && errors++ < 10)
+                printf("FAIL byte %lu: got %u, expected %u\n", received + i, span[i], expected);
+            expected = span[i] + 1;         // resynchronize, so one error is reported once
+        }
+        received += moved;
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * TIMING
+ ******************************************************************************/
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char * name, double ns, unsigned long long cycles)
+{
+    double bytes = (double)TIME_BYTES * TIME_ROUNDS;
+    printf("%-24s %6.2f ns/byte %6.2f cycles/byte (push + pop)\n", name, ns / bytes, cycles / bytes);
+}
+
+static void time_old(void)
+{
+    uint8_t acc = 0;
+    double t0 = now_ns();
+    unsigned long long c0 = CYCLES();
+    for (int r = 0; r < TIME_ROUNDS; r++) {
+        for (int i = 0; i < TIME_BYTES; i++)
+            old_q_pushback(&old_q, (uint8_t)i);
+        for (int i = 0; i < TIME_BYTES; i++)
+            acc += old_q_popfront(&old_q);
+    }
+    unsigned long long c1 = CYCLES();
+    double t1 = now_ns();
+    sink = acc;
+    report("old q_pushback/popfront", t1 - t0, c1 - c0);
+}
+
+static void time_new(void)
+{
+    uint8_t acc = 0;
+    double t0 = now_ns();
+    unsigned long long c0 = CYCLES();
+    for (int r = 0; r < TIME_ROUNDS; r++) {
+        for (int i = 0; i < TIME_BYTES; i++)
+            q_pushback(&time_q, (uint8_t)i);
+        for (int i = 0; i < TIME_BYTES; i++)
+            acc += q_popfront(&time_q);
+    }
+    unsigned long long c1 = CYCLES();
+    double t1 = now_ns();
+    sink = acc;
+    report("q_pushback/popfront", t1 - t0, c1 - c0);
+}
+
+int main(void)
+{
+    stress_q.in = stress_q.out = COUNTER_START;
+
+    pthread_t prod, cons;
+    pthread_create(&cons, NULL, consumer, NULL);
+    pthread_create(&prod, NULL, producer, NULL);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+
+    uint32_t length = q_length(&stress_q);
+    bool wrapped = stress_q.in < COUNTER_START;
+    printf("stress: %lu bytes, %lu errors, %lu partial pushes, %lu partial pops, counters wrapped: %s, left %u\n",
+           STRESS_BYTES, errors, full_pushes, empty_pops, wrapped ? "yes" : "no", length);
+#if RB_STATS_ENABLED
+    printf("stress: stats pushes %u high water %u/%u\n", stress_q.stats.pushes, stress_q.stats.high_water,
+           rb_capacity(&stress_q));
+    bool stats_ok = stress_q.stats.pushes == (uint32_t)STRESS_BYTES && stress_q.stats.high_water <= STRESS_LENGTH;
+#else
+    bool stats_ok = true;
+#endif
+
+    q_init(&time_q);
+    time_old();
+    time_new();
+
+    return errors != 0 || length != 0 || !wrapped || !stats_ok;
+}
@@ -0,0 +1,123 @@
+/***************************************************************************//**
+ * @file raw_math_check.c
+ * @brief Host test: raw_math.c built with the SIMD intrinsics and with its C versions gives the same results,
+ *        and both are exact.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -fwrapv -DROCHI_DEBUG -DRAW_MATH_USE_SIMD=1 -DARM_MATH_ARMV8MBL -I source -I source/util -I SDK/CMSIS \
+ *         -Drm_norm2=simd_rm_norm2 -Drm_average=simd_rm_average -c source/util/raw_math.c -o raw_math_simd.o
+ *     gcc -O2 -DROCHI_DEBUG -I source -I source/util tools/raw_math_check.c source/util/raw_math.c \
+ *         raw_math_simd.o -o raw_math_check
+ *     ./raw_math_check
+ * The SIMD build takes __SMLAD from arm_math.h, which has the CMSIS C definition of each intrinsic for cores without
+ * the DSP extension. That one sums in a signed int like the instruction does, so it needs -fwrapv to wrap on host
+ * as the instruction does on the K64. On target __SMLAD is the instruction itself.
+ * rm_norm2 is swept over every x in the int16 range, each with 256 (y, z) pairs (all the corner values and random
+ * ones), and compared against an exact 64 bit sum. rm_average is compared against an exact rounding of random sets,
+ * including all -32768 and all 32767. Fails (exit code 1) on the first few differences.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "raw_math.h"
+
+#define PAIRS_PER_X     256
+#define AVERAGE_SETS    200000
+#define MAX_SET         32
+
+uint32_t simd_rm_norm2(accel_raw_data_t v);
+accel_raw_data_t simd_rm_average(const accel_raw_data_t * samples, uint32_t n);
+
+static const int16_t corners[] = {INT16_MIN, INT16_MIN + 1, -1, 0, 1, INT16_MAX - 1, INT16_MAX};
+#define N_CORNERS       (sizeof(corners) / sizeof(corners[0]))
+
+static unsigned long failures;
+
+static int16_t random_int16(void)
+{
+    return (int16_t)(rand() & 0xFFFF);
+}
+
+static void fail_norm2(accel_raw_data_t v, uint32_t c, uint32_t simd, uint64_t exact)
+{
+    if (failures++ < 10)
+        printf("FAIL rm_norm2(%d, %d, %d): C %u, SIMD %u, exact %llu\n", v.x, v.y, v.z, c, simd,
+               (unsigned long long)exact);
+}
+
+static void check_norm2(void)
+{
+    unsigned long checked = 0;
+    for (int32_t x = INT16_MIN; x <= INT16_MAX; x++) {
+        for (int i = 0; i < PAIRS_PER_X; i++) {
+            accel_raw_data_t v = {(int16_t)x, random_int16(), random_int16()};
+            if (i < (int)(N_CORNERS * N_CORNERS)) {
+                v.y = corners[i / N_CORNERS];
+                v.z = corners[i % N_CORNERS];
+            }
+            uint64_t exact = (int64_t)v.x * v.x + (int64_t)v.y * v.y + (int64_t)v.z * v.z;
+            uint32_t c = rm_norm2(v);
+            uint32_t simd = simd_rm_norm2(v);
+            if (c != exact || simd != exact)
+                fail_norm2(v, c, simd, exact);
+            checked++;
+        }
+    }
+    printf("rm_norm2: %lu samples\n", checked);
+}
+
+// rounded to nearest, ties away from zero
+static int16_t exact_average(int64_t sum, int64_t n)
+{
+    int64_t q = sum / n, r = sum % n;
+    if (2 * (r < 0 ? -r : r) >= n)
+        q += sum < 0 ? -1 : 1;
+    return (int16_t)q;
+}
+
+static void check_average(void)
+{
+    accel_raw_data_t set[MAX_SET];
+    for (int s = 0; s < AVERAGE_SETS; s++) {
+        uint32_t n = (uint32_t)(rand() % MAX_SET) + 1;
+        int64_t sx = 0, sy = 0, sz = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            int16_t x = random_int16(), y = random_int16(), z = random_int16();
+            if (s == 0)
+                x = y = z = INT16_MIN;
+            else if (s == 1)
+                x = y = z = INT16_MAX;
+            else if (s < 100) {         // small values, where ties are common
+                x = (int16_t)(x % 4); y = (int16_t)(y % 4); z = (int16_t)(z % 4);
+            }
+            set[i] = (accel_raw_data_t){x, y, z};
+            sx += x; sy += y; sz += z;
+        }
+        accel_raw_data_t c = rm_average(set, n);
+        accel_raw_data_t simd = simd_rm_average(set, n);
+        bool ok = c.x == exact_average(sx, n) && c.y == exact_average(sy, n) && c.z == exact_average(sz, n)
+                && simd.x == c.x && simd.y == c.y && simd.z == c.z;
+        if (!ok && failures++ < 10)
+            printf("FAIL rm_average set %d of %u: C (%d, %d, %d), SIMD (%d, %d, %d)\n", s, n, c.x, c.y, c.z,
+                   simd.x, simd.y, simd.z);
+    }
+    accel_raw_data_t zero = rm_average(set, 0);
+    if (zero.x || zero.y || zero.z) {
+        printf("FAIL rm_average of 0 samples\n");
+        failures++;
+    }
+    printf("rm_average: %d sets\n", AVERAGE_SETS);
+}
+
+int main(void)
+{
+    srand(1);
+    check_norm2();
+    check_average();
+
+    printf("raw_math_check: %s, %lu failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
@@ -0,0 +1,127 @@
+/***************************************************************************//**
+ * @file sched_check.c
+ * @brief Host test: the shipped scheduler (scheduler.c) running a main loop that sleeps in sched_idle(),
+ *        woken by threads that stand in for interrupts.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -pthread -DROCHI_DEBUG -I source -I source/util tools/sched_check.c source/util/scheduler.c \
+ *         source/util/clock.c source/util/critical.c -o sched_check
+ *     ./sched_check
+ * Two threads signal EV_UART_RX every 1 ms and EV_ACCEL_SAMPLE every 5 ms for RUN_MS, each counting what it
+ * signaled, and a periodic task runs every 10 ms. The main loop is the one in App.c: sched_run_once(), and
+ * sched_idle() when nothing is ready. Time is the real monotonic clock.
+ * Fails (exit code 1) if a task did not see the last signal of its event, if the event counts do not match,
+ * if the periodic task missed runs, or if the loop hardly slept (sched_idle() spinning instead of waiting).
+ * Reports the idle fraction and the worst latency per event. Host latencies, only good as a sanity check.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "scheduler.h"
+#include "clock.h"
+#include "events.h"
+
+#define RUN_MS          1000
+#define PERIOD_US       10000
+#define MIN_IDLE        0.5     // fraction of the time the loop must sleep
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+typedef struct {
+    sched_events_t event;
+    unsigned int every_us;
+    volatile unsigned int sent;     // written by the "interrupt" only
+    unsigned int seen;              // sent, as read by the task
+} source_t;
+
+static source_t uart = {EV_UART_RX, 1000, 0, 0};
+static source_t accel = {EV_ACCEL_SAMPLE, 5000, 0, 0};
+static unsigned int periodic_runs;
+static volatile bool done;
+static unsigned int failures;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+clock_us_t clock_host_get_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (clock_us_t)ts.tv_sec * 1000000U + ts.tv_nsec / 1000U;
+}
+
+static void * interrupt_source(void * arg)
+{
+    source_t * s = arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (unsigned int t = 0; t < RUN_MS * 1000U; t += s->every_us) {
+        next.tv_nsec += s->every_us * 1000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        s->sent++;
+        sched_signal(s->event);
+    }
+    return NULL;
+}
+
+static void uart_task(void) { uart.seen = uart.sent; }
+static void accel_task(void) { accel.seen = accel.sent; }
+static void periodic_task(void) { periodic_runs++; }
+
+int main(void)
+{
+    sched_add_task("uart", uart_task, 0, 0, EV_UART_RX);
+    sched_add_task("accel", accel_task, 0, 1, EV_ACCEL_SAMPLE);
+    sched_add_task("periodic", periodic_task, PERIOD_US, 2, 0);
+
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, interrupt_source, &uart);
+    pthread_create(&threads[1], NULL, interrupt_source, &accel);
+
+    clock_us_t start = clock_get_us();
+    clock_us_t end = start + RUN_MS * 1000U + PERIOD_US;   // the sources are done before this
+    while (clock_get_us() < end) {
+        if (!sched_run_once())
+            sched_idle();
+    }
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    while (sched_run_once())
+        ;
+    double idle = (double)sched_get_idle_us() / (clock_get_us() - start);
+
+    uint32_t uart_count, accel_count;
+    uint32_t uart_latency = sched_get_event_latency(__builtin_ctz(EV_UART_RX), &uart_count);
+    uint32_t accel_latency = sched_get_event_latency(__builtin_ctz(EV_ACCEL_SAMPLE), &accel_count);
+    sched_task_stats_t stats[3];
+    for (uint8_t i = 0; i < 3; i++)
+        sched_get_stats(i, &stats[i]);
+
+    printf("idle %.1f%%\n", idle * 100);
+    printf("uart:  %u signals, %u runs, worst latency %u us\n", uart.sent, stats[0].runs, uart_latency);
+    printf("accel: %u signals, %u runs, worst latency %u us\n", accel.sent, stats[1].runs, accel_latency);
+    printf("periodic: %u runs, worst latency %u us, %u overruns\n", periodic_runs, stats[2].max_latency_us,
+           stats[2].overruns);
+
+    CHECK(uart.seen == uart.sent && uart.sent == RUN_MS);
+    CHECK(accel.seen == accel.sent && accel.sent == RUN_MS / 5);
+    CHECK(uart_count == uart.sent && accel_count == accel.sent);
+    CHECK(periodic_runs >= RUN_MS * 1000U / PERIOD_US);
+    CHECK(idle > MIN_IDLE);
+
+    printf("sched_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
@@ -0,0 +1,288 @@
+/***************************************************************************//**
+ * @file systick_check.c
+ * @brief Host benchmark: sysTick interrupt work per second with the callback table it had at first, with the
+ *        min-heap that replaced it, and with the tick-only handler shipped now.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 tools/systick_check.c -o systick_check
+ *     ./systick_check
+ * The first two handlers are copies of the old SysTick.c ones, registered with the callbacks the firmware
+ * had then, with their reload values: clock (every tick, 8 kHz), timers (reload 6), uart flush (100 Hz),
+ * accelerometer read (40 Hz) and read request (15 Hz). The third one is the body of SysTick_Handler in
+ * util/SysTick.c. That work moved out of sysTick: the clock reads the sysTick counter, the timers run from
+ * the main loop, the uart flush from the PIT and the accelerometer reads from its INT2 pin.
+ * Runs SIM_SECONDS of 8 kHz ticks through each handler and reports, per simulated second, the slots looked at,
+ * the heap compares and the host time. Callbacks only count their calls.
+ * Fails (exit code 1) if the table and the heap do not call every callback the same amount of times.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define SYSTICK_ISR_FREQUENCY_HZ    8000U
+#define SYSTICK_HZ_TO_RELOAD(x)     (SYSTICK_ISR_FREQUENCY_HZ / (x) - 1)
+#define MAX_N_ST_CALLBACKS          20
+#define SIM_SECONDS                 100
+
+typedef void (*systick_callback_t)(void);
+typedef enum {SINGLE_SHOT, PERIODIC} callback_conf_t;
+
+static unsigned long ops;       // slots looked at, or heap compares
+static unsigned int failures;
+
+/*******************************************************************************
+ * THE MIX
+ ******************************************************************************/
+
+enum {CB_CLOCK, CB_TIMERS, CB_UART, CB_ACCEL_READ, CB_ACCEL_REQUEST, N_MIX};
+
+static unsigned long calls[N_MIX];
+static void clock_cb(void) { calls[CB_CLOCK]++; }
+static void timers_cb(void) { calls[CB_TIMERS]++; }
+static void uart_cb(void) { calls[CB_UART]++; }
+static void accel_read_cb(void) { calls[CB_ACCEL_READ]++; }
+static void accel_request_cb(void) { calls[CB_ACCEL_REQUEST]++; }
+
+static const struct {
+    const char * name;
+    systick_callback_t func;
+    unsigned int reload;
+} mix[N_MIX] = {
+    {"clock", clock_cb, 0},
+    {"timers", timers_cb, 6},
+    {"uart", uart_cb, SYSTICK_HZ_TO_RELOAD(100)},
+    {"accel read", accel_read_cb, SYSTICK_HZ_TO_RELOAD(40)},
+    {"accel request", accel_request_cb, SYSTICK_HZ_TO_RELOAD(15)},
+};
+
+/*******************************************************************************
+ * TABLE: every slot looked at on every tick
+ ******************************************************************************/
+
+#define COUNTER_INIT    -1
+
+typedef struct {
+    systick_callback_t func;
+    int counter;
+    unsigned int reload;
+    bool enabled;
+    callback_conf_t conf;
+} table_cb_t;
+
+static table_cb_t table[MAX_N_ST_CALLBACKS];
+
+static void table_add(systick_callback_t func, unsigned int reload)
+{
+    for (int i = 0; i < MAX_N_ST_CALLBACKS; i++) {
+        if (table[i].func == NULL) {
+            table[i] = (table_cb_t){func, COUNTER_INIT, reload, true, PERIODIC};
+            break;
+        }
+    }
+}
+
+static void table_isr(void)
+{
+    for (int i = 0; i < MAX_N_ST_CALLBACKS; i++) {
+        ops++;
+        if (table[i].func != NULL && table[i].enabled) {
+            table[i].counter++;
+            if (table[i].counter == (int)table[i].reload) {
+                table[i].func();
+                table[i].counter = COUNTER_INIT;
+                if (table[i].conf == SINGLE_SHOT)
+                    table[i].enabled = false;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * HEAP: only the callback due next looked at on every tick
+ ******************************************************************************/
+
+#define NOT_QUEUED  0xFF
+
+typedef struct {
+    systick_callback_t func;
+    uint32_t deadline;
+    uint32_t period;
+    uint8_t heap_pos;
+    bool enabled;
+    callback_conf_t conf;
+} heap_cb_t;
+
+static heap_cb_t heap_cbs[MAX_N_ST_CALLBACKS];
+static heap_cb_t * heap[MAX_N_ST_CALLBACKS];
+static uint8_t heap_size;
+static uint32_t ticks;
+
+static bool is_due(uint32_t deadline, uint32_t now)
+{
+    ops++;
+    return (int32_t)(now - deadline) >= 0;
+}
+
+static bool earlier(const heap_cb_t * a, const heap_cb_t * b)
+{
+    ops++;
+    return (int32_t)(a->deadline - b->deadline) < 0;
+}
+
+static void heap_place(heap_cb_t * data, uint8_t pos)
+{
+    heap[pos] = data;
+    data->heap_pos = pos;
+}
+
+static void heap_sift_up(uint8_t pos)
+{
+    heap_cb_t * data = heap[pos];
+    while (pos > 0) {
+        uint8_t parent = (pos - 1) / 2;
+        if (!earlier(data, heap[parent]))
+            break;
+        heap_place(heap[parent], pos);
+        pos = parent;
+    }
+    heap_place(data, pos);
+}
+
+static void heap_sift_down(uint8_t pos)
+{
+    heap_cb_t * data = heap[pos];
+    for (;;) {
+        uint8_t child = 2 * pos + 1;
+        if (child >= heap_size)
+            break;
+        if (child + 1 < heap_size && earlier(heap[child + 1], heap[child]))
+            child++;
+        if (!earlier(heap[child], data))
+            break;
+        heap_place(heap[child], pos);
+        pos = child;
+    }
+    heap_place(data, pos);
+}
+
+static void heap_push(heap_cb_t * data)
+{
+    heap_place(data, heap_size++);
+    heap_sift_up(data->heap_pos);
+}
+
+static void heap_remove(heap_cb_t * data)
+{
+    uint8_t pos = data->heap_pos;
+    if (pos == NOT_QUEUED)
+        return;
+    data->heap_pos = NOT_QUEUED;
+    heap_size--;
+    if (pos != heap_size) {
+        heap_cb_t * moved = heap[heap_size];
+        heap_place(moved, pos);
+        heap_sift_up(pos);
+        if (moved->heap_pos == pos)
+            heap_sift_down(pos);
+    }
+}
+
+static void heap_add(systick_callback_t func, unsigned int reload)
+{
+    for (int i = 0; i < MAX_N_ST_CALLBACKS; i++) {
+        if (heap_cbs[i].func == NULL) {
+            heap_cbs[i] = (heap_cb_t){func, ticks + reload + 1, reload + 1, NOT_QUEUED, true, PERIODIC};
+            heap_push(&heap_cbs[i]);
+            break;
+        }
+    }
+}
+
+static void heap_isr(void)
+{
+    uint32_t now = ++ticks;
+    while (heap_size && is_due(heap[0]->deadline, now)) {
+        heap_cb_t * data = heap[0];
+        heap_remove(data);
+        if (data->conf == SINGLE_SHOT)
+            data->enabled = false;
+        data->func();
+        if (data->enabled && data->func != NULL && data->heap_pos == NOT_QUEUED) {
+            data->deadline += data->period;
+            if (is_due(data->deadline, now))
+                data->deadline = now + data->period;
+            heap_push(data);
+        }
+    }
+}
+
+/*******************************************************************************
+ * TICK ONLY: util/SysTick.c now
+ ******************************************************************************/
+
+static volatile uint32_t st_ticks;
+static volatile uint32_t st_ticks_hi;
+
+static void tick_isr(void)
+{
+    if (++st_ticks == 0)
+        st_ticks_hi++;
+}
+
+/*******************************************************************************
+ * RUN
+ ******************************************************************************/
+
+static double real_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run(const char * name, void (*isr)(void), unsigned long * counts)
+{
+    for (int i = 0; i < N_MIX; i++)
+        calls[i] = 0;
+    ops = 0;
+    double t0 = real_ns();
+    for (uint32_t t = 0; t < SIM_SECONDS * SYSTICK_ISR_FREQUENCY_HZ; t++)
+        isr();
+    double elapsed = real_ns() - t0;
+    printf("%-10s %8lu ops/s %8.0f ns/s of host time\n", name, ops / SIM_SECONDS, elapsed / SIM_SECONDS);
+    for (int i = 0; i < N_MIX; i++)
+        counts[i] = calls[i];
+}
+
+int main(void)
+{
+    unsigned long table_calls[N_MIX], heap_calls[N_MIX], tick_calls[N_MIX];
+    for (int i = 0; i < N_MIX; i++) {
+        table_add(mix[i].func, mix[i].reload);
+        heap_add(mix[i].func, mix[i].reload);
+    }
+
+    printf("%u ticks per second, per simulated second:\n", SYSTICK_ISR_FREQUENCY_HZ);
+    run("table", table_isr, table_calls);
+    run("heap", heap_isr, heap_calls);
+    run("tick only", tick_isr, tick_calls);
+
+    printf("calls per second in the old mix:");
+    for (int i = 0; i < N_MIX; i++) {
+        printf(" %s %lu", mix[i].name, table_calls[i] / SIM_SECONDS);
+        if (table_calls[i] != heap_calls[i]) {
+            printf(" (FAIL: heap %lu)", heap_calls[i] / SIM_SECONDS);
+            failures++;
+        }
+    }
+    printf("\n");
+    if (st_ticks != SIM_SECONDS * SYSTICK_ISR_FREQUENCY_HZ)
+        failures++;
+
+    printf("systick_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
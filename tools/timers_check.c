@@ -0,0 +1,208 @@
+/***************************************************************************//**
+ * @file timers_check.c
+ * @brief Host test and benchmark: the shipped software timers (timers.c) run by the shipped scheduler
+ *        (scheduler.c) on a simulated clock, with a few timers and with 500 at once.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -pthread -DROCHI_DEBUG -DTIMER_TOTAL_TIMERS=512 -I source -I source/util -I source/util/Timer tools/timers_check.c \
+ *         source/util/Timer/timers.c source/util/scheduler.c source/util/clock.c source/util/critical.c -o timers_check
+ *     ./timers_check
+ * The simulated clock moves in 100 us steps, and the main loop runs every task that is ready on each step.
+ * Every callback checks that it is called on the exact ms its timer is due, counted from when it was started or
+ * from its previous expiry, also when it was started while the timers task was due and had not run yet.
+ * Some callbacks change their period or stop other timers, as users do.
+ * With 3 timers, the timers task must run only on ticks a timer expires on, not every ms.
+ * With 500 timers of 1 ms to 2 s, reports the host time spent per simulated ms and per expiry.
+ * Fails (exit code 1) if a callback comes early, late, twice or not at all, or if the task polls every ms.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include "timers.h"
+#include "scheduler.h"
+#include "clock.h"
+
+#define STEP_US         100
+#define MANY_TIMERS     500
+#define MANY_RUN_MS     20000
+#define MAX_PERIOD_MS   2000
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+typedef struct {
+    bool running;
+    unsigned int period_ms;
+    timer_mode_t mode;
+    clock_us_t due;             // when the next call must come
+    unsigned int calls;
+} expected_t;
+
+static clock_us_t now_us;
+static expected_t expected[TIMER_TOTAL_TIMERS];
+static unsigned long wrong_time, unexpected, calls;
+static bool churn;              // callbacks change periods and stop other timers
+static clock_us_t late_us;      // how late a call may come, when the main loop was kept busy
+static unsigned int failures;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+clock_us_t clock_host_get_us(void)
+{
+    return now_us;
+}
+
+static double real_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void start_timer(unsigned int id, unsigned int period_ms, timer_mode_t mode)
+{
+    timers_set_timer_mode(id, mode);
+    timers_set_timer_period(id, period_ms);
+    timers_set_timer_enabled(id, true);
+    expected[id] = (expected_t){true, period_ms, mode, now_us / 1000 * 1000 + period_ms * 1000U, 0};
+}
+
+static void callback(unsigned int id)
+{
+    expected_t * e = &expected[id];
+    calls++;
+    if (!e->running) {
+        if (unexpected++ < 10)
+            printf("FAIL timer %u called while stopped, at %llu us\n", id, (unsigned long long)now_us);
+        return;
+    }
+    if ((now_us < e->due || now_us > e->due + late_us) && wrong_time++ < 10)
+        printf("FAIL timer %u called at %llu us, due at %llu us\n", id, (unsigned long long)now_us,
+               (unsigned long long)e->due);
+    e->calls++;
+    e->due = now_us + e->period_ms * 1000U;
+    if (e->mode == TIMER_SINGLE)
+        e->running = false;
+
+    if (churn && e->calls % 7 == 0) {
+        // a new period counts from now
+        e->period_ms = (unsigned int)(rand() % MAX_PERIOD_MS) + 1;
+        e->running = true;
+        timers_set_timer_period(id, (int)e->period_ms);
+        e->due = now_us + e->period_ms * 1000U;
+        if (e->mode == TIMER_SINGLE)
+            timers_set_timer_enabled(id, true);
+    }
+    if (churn && e->calls % 11 == 0) {
+        unsigned int other = (unsigned int)rand() % MANY_TIMERS;
+        if (other != id) {
+            timers_set_timer_enabled(other, false);
+            expected[other].running = false;
+        }
+    }
+}
+
+// runs the main loop until the simulated clock gets to end
+static void run_until(clock_us_t end)
+{
+    while (now_us < end) {
+        now_us += STEP_US;
+        while (sched_run_once())
+            ;
+    }
+}
+
+static uint32_t timer_task_runs(void)
+{
+    sched_task_stats_t stats;
+    sched_get_stats(0, &stats);
+    return stats.runs;
+}
+
+static unsigned int missing_calls(void)
+{
+    unsigned int missing = 0;
+    for (unsigned int i = 0; i < TIMER_TOTAL_TIMERS; i++)
+        if (expected[i].running && expected[i].due < now_us)
+            missing++;
+    return missing;
+}
+
+int main(void)
+{
+    srand(1);
+    timers_init();
+    for (unsigned int i = 0; i < TIMER_TOTAL_TIMERS; i++)
+        timers_set_timer_callback(i, callback);
+
+    // no timers: the task never runs
+    run_until(1000000);
+    CHECK(timer_task_runs() == 0);
+
+    // a few timers: 100 ms and 250 ms periodic, 1 s single shot, started between ticks
+    now_us += 400;
+    start_timer(0, 100, TIMER_REPEAT);
+    start_timer(1, 250, TIMER_REPEAT);
+    start_timer(2, 1000, TIMER_SINGLE);
+    uint32_t runs = timer_task_runs();
+    run_until(now_us + 10000000);
+    runs = timer_task_runs() - runs;
+    printf("3 timers, 10 s: %lu calls, timers task ran %u times (a 1 ms period ran it 10000 times)\n", calls, runs);
+    CHECK(expected[0].calls == 100 && expected[1].calls == 40 && expected[2].calls == 1);
+    CHECK(runs <= calls);
+    CHECK(wrong_time == 0 && unexpected == 0 && missing_calls() == 0);
+
+    // restarting with the same period counts from now, stopping means no more calls
+    run_until(now_us + 30000);
+    start_timer(0, 100, TIMER_REPEAT);
+    timers_set_timer_enabled(1, false);
+    expected[1].running = false;
+    run_until(now_us + 1000000);
+    CHECK(wrong_time == 0 && unexpected == 0 && missing_calls() == 0);
+    timers_set_timer_enabled(0, false);
+    expected[0].running = false;
+
+    // a timer started while the task is due but has not run yet also counts from now
+    start_timer(3, 20, TIMER_SINGLE);
+    now_us += 20500;            // the main loop was busy
+    start_timer(4, 10, TIMER_SINGLE);
+    late_us = 1000;
+    run_until(now_us + STEP_US);
+    late_us = 0;
+    run_until(now_us + 20000);
+    CHECK(expected[3].calls == 1 && expected[4].calls == 1);
+    CHECK(wrong_time == 0 && unexpected == 0 && missing_calls() == 0);
+
+    // many timers, started at different times, some changing or stopping others
+    churn = true;
+    calls = 0;
+    for (unsigned int i = 0; i < MANY_TIMERS; i++) {
+        run_until(now_us + (rand() % 4) * STEP_US);
+        start_timer(i, (unsigned int)(rand() % MAX_PERIOD_MS) + 1, i % 5 ? TIMER_REPEAT : TIMER_SINGLE);
+    }
+    runs = timer_task_runs();
+    double t0 = real_ns();
+    run_until(now_us + MANY_RUN_MS * 1000U);
+    double elapsed = real_ns() - t0;
+    runs = timer_task_runs() - runs;
+    unsigned int running = 0;
+    for (unsigned int i = 0; i < MANY_TIMERS; i++)
+        running += expected[i].running;
+    printf("%u timers, %u s: %lu calls, %u still running at the end, timers task ran %u times\n", MANY_TIMERS,
+           MANY_RUN_MS / 1000, calls, running, runs);
+    printf("host time: %.0f ns per simulated ms, %.0f ns per expiry (main loop steps included)\n",
+           elapsed / MANY_RUN_MS, elapsed / calls);
+    CHECK(wrong_time == 0 && unexpected == 0 && missing_calls() == 0);
+
+    printf("timers_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}
@@ -0,0 +1,372 @@
+/***************************************************************************//**
+ * @file vector_3d_check.c
+ * @brief Host test and benchmark: batch vector functions (vb_*) against the scalar ones, in both their plain C
+ *        and CMSIS-DSP versions, and the batch orientation filter against the per sample one it replaced.
+ *
+ * Build and run from the repository root:
+ *     gcc -O2 -DROCHI_DEBUG -DVECTOR_3D_USE_CMSIS_DSP=1 -DARM_MATH_ARMV8MBL -I SDK/CMSIS \
+ *         -c source/util/vector_3d.c -o vector_3d_cmsis.o
+ *     objcopy -w -L 'v_*' -L 'iv_*' vector_3d_cmsis.o
+ *     for f in add scale dot norm normalize cross; do objcopy --redefine-sym vb_$f=cmsis_vb_$f vector_3d_cmsis.o; done
+ *     gcc -O2 -DROCHI_DEBUG -I source -I source/util tools/vector_3d_check.c source/util/vector_3d.c \
+ *         source/util/fusion.c vector_3d_cmsis.o -lm -o vector_3d_check
+ *     ./vector_3d_check
+ * The CMSIS-DSP library is not in the repo, only arm_math.h, so the arm_*_f32 kernels the CMSIS version calls are
+ * given below as the plain loops of the library's generic C code. That builds and runs the CMSIS version of vector_3d.c,
+ * with its 32 vector blocks and scratch buffers, on random vectors against the C version.
+ * Checks, over random vectors: every vb_* function against its v_* counterpart, bit for bit; the CMSIS version
+ * against the C one, bit for bit; and fusion_update_n() over bursts against the old per sample filter (kept below),
+ * within 1e-5, including samples it must discard. Fails (exit code 1) if any check fails.
+ * Then times, per vector, the scalar and batch functions and both filters. Host times, only good to compare.
+ * @author Grupo 1 Laboratorio de Microprocesadores
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "vector_3d.h"
+#include "fusion.h"
+
+#define N_VECTORS       1000        // not a multiple of the 32 vector blocks
+#define BURST           16          // samples per fusion_update_n() call, like a FIFO burst
+#define TIME_ROUNDS     2000
+#define TOLERANCE       1e-5f
+
+#define CHECK(cond)     check((cond), #cond, __LINE__)
+
+void cmsis_vb_add(vector_soa_t a, vector_soa_t b, vector_soa_t out, uint32_t n);
+void cmsis_vb_scale(float alpha, vector_soa_t a, vector_soa_t out, uint32_t n);
+void cmsis_vb_dot(vector_soa_t a, vector_soa_t b, float * out, uint32_t n);
+void cmsis_vb_norm(vector_soa_t a, float * out, uint32_t n);
+void cmsis_vb_normalize(vector_soa_t a, vector_soa_t out, uint32_t n);
+void cmsis_vb_cross(vector_soa_t a, vector_soa_t b, vector_soa_t out, uint32_t n);
+
+/*******************************************************************************
+ * CMSIS-DSP KERNELS USED BY vector_3d.c, AS THE LIBRARY'S GENERIC C CODE
+ ******************************************************************************/
+
+void arm_add_f32(float * a, float * b, float * out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = a[i] + b[i];
+}
+
+void arm_sub_f32(float * a, float * b, float * out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = a[i] - b[i];
+}
+
+void arm_mult_f32(float * a, float * b, float * out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = a[i] * b[i];
+}
+
+void arm_scale_f32(float * a, float scale, float * out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = a[i] * scale;
+}
+
+/*******************************************************************************
+ * THE FILTER BEFORE fusion_update_n(), ONE SAMPLE AT A TIME WITH THE SCALAR FUNCTIONS
+ ******************************************************************************/
+
+static quaternion_t ref_estimate;
+static bool ref_has_estimate;
+
+// same as q_from_rows() in fusion.c
+static quaternion_t ref_from_rows(vector_t r0, vector_t r1, vector_t r2)
+{
+    quaternion_t q;
+    float trace = r0.x + r1.y + r2.z;
+    float s;
+
+    if (trace > 0) {
+        s = 2 * sqrtf(trace + 1);
+        q.w = 0.25f * s; q.x = (r2.y - r1.z) / s; q.y = (r0.z - r2.x) / s; q.z = (r1.x - r0.y) / s;
+    }
+    else if (r0.x > r1.y && r0.x > r2.z) {
+        s = 2 * sqrtf(1 + r0.x - r1.y - r2.z);
+        q.w = (r2.y - r1.z) / s; q.x = 0.25f * s; q.y = (r0.y + r1.x) / s; q.z = (r0.z + r2.x) / s;
+    }
+    else if (r1.y > r2.z) {
+        s = 2 * sqrtf(1 + r1.y - r0.x - r2.z);
+        q.w = (r0.z - r2.x) / s; q.x = (r0.y + r1.x) / s; q.y = 0.25f * s; q.z = (r1.z + r2.y) / s;
+    }
+    else {
+        s = 2 * sqrtf(1 + r2.z - r0.x - r1.y);
+        q.w = (r1.x - r0.y) / s; q.x = (r0.z + r2.x) / s; q.y = (r1.z + r2.y) / s; q.z = 0.25f * s;
+    }
+    return q;
+}
+
+static bool ref_update(vector_t gravity, vector_t magnetic)
+{
+    float g_norm = v_norm(gravity);
+    if (g_norm == 0)
+        return false;
+    vector_t u = v_scalar_product(-1.0f / g_norm, gravity);
+
+    vector_t n = v_substract(magnetic, v_scalar_product(v_dot_product(magnetic, u), u));
+    float n_norm = v_norm(n);
+    if (n_norm == 0)
+        return false;
+    n = v_scalar_product(1.0f / n_norm, n);
+
+    quaternion_t m = ref_from_rows(n, v_cross_product(u, n), u);
+
+    if (!ref_has_estimate) {
+        ref_estimate = m;
+        ref_has_estimate = true;
+        return true;
+    }
+
+    float dot = ref_estimate.w * m.w + ref_estimate.x * m.x + ref_estimate.y * m.y + ref_estimate.z * m.z;
+    float k = dot < 0 ? -FUSION_GAIN : FUSION_GAIN;
+
+    ref_estimate.w += k * m.w - FUSION_GAIN * ref_estimate.w;
+    ref_estimate.x += k * m.x - FUSION_GAIN * ref_estimate.x;
+    ref_estimate.y += k * m.y - FUSION_GAIN * ref_estimate.y;
+    ref_estimate.z += k * m.z - FUSION_GAIN * ref_estimate.z;
+    float inv = 1.0f / sqrtf(ref_estimate.w * ref_estimate.w + ref_estimate.x * ref_estimate.x
+                             + ref_estimate.y * ref_estimate.y + ref_estimate.z * ref_estimate.z);
+    ref_estimate.w *= inv; ref_estimate.x *= inv; ref_estimate.y *= inv; ref_estimate.z *= inv;
+    return true;
+}
+
+/*******************************************************************************
+ * TEST DATA
+ ******************************************************************************/
+
+static float ax[N_VECTORS], ay[N_VECTORS], az[N_VECTORS];
+static float bx[N_VECTORS], by[N_VECTORS], bz[N_VECTORS];
+static float cx[N_VECTORS], cy[N_VECTORS], cz[N_VECTORS];
+static float dx[N_VECTORS], dy[N_VECTORS], dz[N_VECTORS];
+static float s1[N_VECTORS], s2[N_VECTORS];
+static const vector_soa_t a = {ax, ay, az}, b = {bx, by, bz}, c = {cx, cy, cz}, d = {dx, dy, dz};
+static volatile float sink;
+static unsigned int failures;
+
+static void check(bool ok, const char * what, int line)
+{
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+static float random_float(float range)
+{
+    return (rand() / (float)RAND_MAX * 2 - 1) * range;
+}
+
+static vector_t at(vector_soa_t v, int i)
+{
+    vector_t r = {v.x[i], v.y[i], v.z[i]};
+    return r;
+}
+
+static bool same(vector_t v, vector_t w)
+{
+    return memcmp(&v, &w, sizeof(v)) == 0;
+}
+
+static bool same_soa(vector_soa_t v, vector_soa_t w)
+{
+    return memcmp(v.x, w.x, sizeof(ax)) == 0 && memcmp(v.y, w.y, sizeof(ax)) == 0 && memcmp(v.z, w.z, sizeof(ax)) == 0;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * CHECKS
+ ******************************************************************************/
+
+// every vb_* function against the scalar one, vector by vector
+static void check_batch_against_scalar(void)
+{
+    unsigned int bad[6] = {0};
+
+    vb_add(a, b, c, N_VECTORS);
+    for (int i = 0; i < N_VECTORS; i++)
+        bad[0] += !same(at(c, i), v_add(at(a, i), at(b, i)));
+    vb_scale(0.3f, a, c, N_VECTORS);
+    for (int i = 0; i < N_VECTORS; i++)
+        bad[1] += !same(at(c, i), v_scalar_product(0.3f, at(a, i)));
+    vb_dot(a, b, s1, N_VECTORS);
+    for (int i = 0; i < N_VECTORS; i++)
+        bad[2] += s1[i] != v_dot_product(at(a, i), at(b, i));
+    vb_norm(a, s1, N_VECTORS);
+    for (int i = 0; i < N_VECTORS; i++)
+        bad[3] += s1[i] != v_norm(at(a, i));
+    vb_normalize(a, c, N_VECTORS);
+    for (int i = 0; i < N_VECTORS; i++)
+        bad[4] += !same(at(c, i), v_normalize(at(a, i)));
+    vb_cross(a, b, c, N_VECTORS);
+    for (int i = 0; i < N_VECTORS; i++)
+        bad[5] += !same(at(c, i), v_cross_product(at(a, i), at(b, i)));
+
+    CHECK(bad[0] == 0);
+    CHECK(bad[1] == 0);
+    CHECK(bad[2] == 0);
+    CHECK(bad[3] == 0);
+    CHECK(bad[4] == 0);
+    CHECK(bad[5] == 0);
+}
+
+// the CMSIS-DSP version against the C one
+static void check_cmsis_against_c(void)
+{
+    vb_add(a, b, c, N_VECTORS);
+    cmsis_vb_add(a, b, d, N_VECTORS);
+    CHECK(same_soa(c, d));
+    vb_scale(-1.5f, a, c, N_VECTORS);
+    cmsis_vb_scale(-1.5f, a, d, N_VECTORS);
+    CHECK(same_soa(c, d));
+    vb_dot(a, b, s1, N_VECTORS);
+    cmsis_vb_dot(a, b, s2, N_VECTORS);
+    CHECK(memcmp(s1, s2, sizeof(s1)) == 0);
+    vb_norm(b, s1, N_VECTORS);
+    cmsis_vb_norm(b, s2, N_VECTORS);
+    CHECK(memcmp(s1, s2, sizeof(s1)) == 0);
+    vb_normalize(a, c, N_VECTORS);
+    cmsis_vb_normalize(a, d, N_VECTORS);
+    CHECK(same_soa(c, d));
+    vb_cross(a, b, c, N_VECTORS);
+    cmsis_vb_cross(a, b, d, N_VECTORS);
+    CHECK(same_soa(c, d));
+
+    // in place, as allowed by vector_3d.h
+    memcpy(cx, ax, sizeof(ax)); memcpy(cy, ay, sizeof(ay)); memcpy(cz, az, sizeof(az));
+    memcpy(dx, ax, sizeof(ax)); memcpy(dy, ay, sizeof(ay)); memcpy(dz, az, sizeof(az));
+    vb_normalize(c, c, N_VECTORS);
+    cmsis_vb_normalize(d, d, N_VECTORS);
+    CHECK(same_soa(c, d));
+}
+
+static bool close_to_reference(void)
+{
+    quaternion_t q = fusion_get_quaternion();
+    return fabsf(q.w - ref_estimate.w) < TOLERANCE && fabsf(q.x - ref_estimate.x) < TOLERANCE
+            && fabsf(q.y - ref_estimate.y) < TOLERANCE && fabsf(q.z - ref_estimate.z) < TOLERANCE;
+}
+
+// gravity is a, magnetic field is b: the filter fed in bursts against the old one fed sample by sample
+static void check_fusion(void)
+{
+    // samples the filter must discard: no gravity, and magnetic field parallel to gravity
+    ax[5] = ay[5] = az[5] = 0;
+    ax[21] = ay[21] = bx[21] = by[21] = 0;
+
+    fusion_reset();
+    ref_has_estimate = false;
+    unsigned int accepted = 0, ref_accepted = 0, far = 0;
+    for (int i = 0; i < N_VECTORS; i += BURST) {
+        uint32_t n = N_VECTORS - i < BURST ? N_VECTORS - i : BURST;
+        vector_soa_t g = {&ax[i], &ay[i], &az[i]};
+        vector_soa_t m = {&bx[i], &by[i], &bz[i]};
+        accepted += fusion_update_n(g, m, n);
+        for (uint32_t j = 0; j < n; j++)
+            ref_accepted += ref_update(at(a, i + j), at(b, i + j));
+        far += !close_to_reference();
+    }
+    CHECK(accepted == N_VECTORS - 2);
+    CHECK(accepted == ref_accepted);
+    CHECK(far == 0);
+
+    // one sample at a time is the same filter
+    CHECK(!fusion_update(at(a, 5), at(b, 5)));
+    CHECK(!fusion_update(at(a, 21), at(b, 21)));
+    CHECK(fusion_update(at(a, 0), at(b, 0)) && ref_update(at(a, 0), at(b, 0)) && close_to_reference());
+}
+
+/*******************************************************************************
+ * TIMING
+ ******************************************************************************/
+
+static void report(const char * name, double ns)
+{
+    printf("%-30s %7.2f ns/vector\n", name, ns / ((double)N_VECTORS * TIME_ROUNDS));
+}
+
+static void time_functions(void)
+{
+    float acc = 0;
+    double t0 = now_ns();
+    for (int r = 0; r < TIME_ROUNDS; r++)
+        for (int i = 0; i < N_VECTORS; i++) {
+            vector_t v = v_normalize(at(a, i));
+            cx[i] = v.x; cy[i] = v.y; cz[i] = v.z;
+        }
+    report("v_normalize, one at a time", now_ns() - t0);
+    acc += cx[1];
+
+    t0 = now_ns();
+    for (int r = 0; r < TIME_ROUNDS; r++)
+        vb_normalize(a, c, N_VECTORS);
+    report("vb_normalize", now_ns() - t0);
+    acc += cx[1];
+
+    t0 = now_ns();
+    for (int r = 0; r < TIME_ROUNDS; r++)
+        for (int i = 0; i < N_VECTORS; i++) {
+            vector_t v = v_cross_product(at(a, i), at(b, i));
+            cx[i] = v.x; cy[i] = v.y; cz[i] = v.z;
+        }
+    report("v_cross_product, one at a time", now_ns() - t0);
+    acc += cx[1];
+
+    t0 = now_ns();
+    for (int r = 0; r < TIME_ROUNDS; r++)
+        vb_cross(a, b, c, N_VECTORS);
+    report("vb_cross", now_ns() - t0);
+    acc += cx[1];
+
+    t0 = now_ns();
+    for (int r = 0; r < TIME_ROUNDS; r++)
+        for (int i = 0; i < N_VECTORS; i++)
+            ref_update(at(a, i), at(b, i));
+    report("old filter, one at a time", now_ns() - t0);
+    acc += ref_estimate.w;
+
+    t0 = now_ns();
+    for (int r = 0; r < TIME_ROUNDS; r++)
+        for (int i = 0; i < N_VECTORS; i += BURST) {
+            uint32_t n = N_VECTORS - i < BURST ? N_VECTORS - i : BURST;
+            vector_soa_t g = {&ax[i], &ay[i], &az[i]};
+            vector_soa_t m = {&bx[i], &by[i], &bz[i]};
+            fusion_update_n(g, m, n);
+        }
+    report("fusion_update_n, bursts of 16", now_ns() - t0);
+    acc += fusion_get_quaternion().w;
+
+    sink = acc;
+}
+
+int main(void)
+{
+    srand(1);
+    for (int i = 0; i < N_VECTORS; i++) {
+        ax[i] = random_float(4096); ay[i] = random_float(4096); az[i] = random_float(4096);
+        bx[i] = random_float(1000); by[i] = random_float(1000); bz[i] = random_float(1000);
+    }
+
+    check_batch_against_scalar();
+    check_cmsis_against_c();
+    check_fusion();
+    time_functions();
+
+    printf("vector_3d_check: %s, %u failed\n", failures ? "FAIL" : "OK", failures);
+    return failures != 0;
+}